@@ -24,6 +24,7 @@
 
 #include "fileio.h"
 #include "interprt.h"
+#include "decode.h"
 
 
 
@@ -56,21 +57,10 @@ extern int read_history ();
 static int debug_eval(char *cmd_line);
 static unsigned int debug_search_line_begin(unsigned int address);
 
-unsigned char breakpoint = 0xCF;
-#define debug_set_breakpoint(pos) \
-    do { \
-        if(wsdata[pos] == 0xCF) \
-            printf("There already is a breakpoint at 0x%04x.\n", pos); \
-        else { \
-            printf("Breakpoint set at 0x%04x.\n", pos); \
-            wsdata_merge_into(pos,&breakpoint,1); \
-            label_cache_update(pos,2); \
-        } \
-    } while(0)
-
 
 static int debug_exec_break(const char *arg);
 static int debug_exec_continue(const char *arg);
+static int debug_exec_delete(const char *arg);
 static int debug_exec_exit(const char *arg);
 static int debug_exec_file(const char *arg);
 static int debug_exec_help(const char *arg);
@@ -93,6 +83,7 @@ struct {
     { "break", "set breakpoint at (or shortly before) address", debug_exec_break, 1, 0 },
     { "continue", "continue execution", debug_exec_continue, 0, 1 },
     { "cont", NULL, debug_exec_continue, 0, 1 },
+    { "delete", "delete breakpoint at (or shortly before) address", debug_exec_delete, 1, 0 },
     { "exit", "leave debugger", debug_exec_exit, 0, 0 },
     { "file", "use FILE as whitespace program to be debugged", debug_exec_file, 1, 0 },
     { "help", "display this screen", debug_exec_help, 0, 0 },
@@ -117,6 +108,9 @@ void debug_launch(void)
         char *buf;
         static char *last = NULL;
 
+        /* stdout is buffered, while the program's run (see interprt_init) */
+        fflush(stdout);
+
         buf = readline("\n(wsdebug) ");
         if(! buf) break; /* we're at eof, get outta here */
 
@@ -135,8 +129,9 @@ void debug_launch(void)
          */
         char buf[256];
 
-        /* write out wsdebug prompt */
+        /* write out wsdebug prompt, stdout is buffered (see interprt_init) */
         printf("\n(wsdebug) ");
+        fflush(stdout);
         if(! fgets(buf, sizeof(buf), stdin)) break;
 #endif
 
@@ -251,8 +246,15 @@ static int debug_exec_break(const char *arg)
 {
     unsigned int value = debug_search_line_begin(strtoul(arg, NULL, 0));
 
-    if(value < wsdata_len)
-        debug_set_breakpoint(value);
+    if(value < wsdata_len) {
+        unsigned int index = decode_lookup(value);
+
+        if(interprt_break(index, 1))
+            printf("Breakpoint set at 0x%04x.\n", insn[index].ws_ptr);
+        else
+            printf("There already is a breakpoint at 0x%04x.\n",
+                   insn[index].ws_ptr);
+    }
     else
         printf("cannot set breakpoint behind end of file.\n");
     
@@ -261,6 +263,26 @@ static int debug_exec_break(const char *arg)
 
 
 
+static int debug_exec_delete(const char *arg)
+{
+    unsigned int value = debug_search_line_begin(strtoul(arg, NULL, 0));
+
+    if(value < wsdata_len) {
+        unsigned int index = decode_lookup(value);
+
+        if(interprt_break(index, 0))
+            printf("Breakpoint at 0x%04x deleted.\n", insn[index].ws_ptr);
+        else
+            printf("There is no breakpoint at 0x%04x.\n", insn[index].ws_ptr);
+    }
+    else
+        printf("cannot delete breakpoint behind end of file.\n");
+
+    return 0; /* continue executing wsdebug */
+}
+
+
+
 static int debug_exec_continue(const char *arg)
 {
     interprt_err_handler(stdout, interprt_cont());
@@ -280,8 +302,11 @@ static int debug_exec_file(const char *argument)
 {
     if(load_file(argument))
         printf("%s: unable to open file\n", argument);
-    else
+    else {
         printf("%s: file successfully loaded.\n", argument);
+        decode_program(stdout);
+        interprt_break_reset();
+    }
 
     return 0; /* request not to leave */
 }
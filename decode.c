@@ -0,0 +1,801 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * decode.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * pre-decoded instruction stream, built from wsdata
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decode.h"
+
+/* the decoded program and its literal pool */
+STACK_DEF(insn_t, insn, insn_len, insn_alloc)
+STACK_DEF(WSVAR_TYPE, insn_lit, insn_lit_len, insn_lit_alloc)
+
+/* the program's decoded block by block, see decode_program_lazy */
+int decode_lazy = 0;
+
+static insn_op decode_insn(const unsigned char *ip, insn_t *in);
+static unsigned int decode_number(const unsigned char *ptr);
+static void decode_value(WSVAR_TYPE *result, const unsigned char *ptr);
+static int decode_resolve_labels(FILE *target, unsigned int labels);
+static unsigned int decode_ref(unsigned int ws_ptr);
+static unsigned int decode_target(unsigned int jump);
+
+
+
+/* int decode_program(FILE *target)
+ *
+ * translate the whole wsdata stack into the insn array, resolving push
+ * literals and jump targets once, so that the engine doesn't have to
+ * look at the whitespace bits ever again.
+ *
+ * labels, that are defined twice, and jumps to labels, that aren't defined
+ * at all, are reported to target (unless it's NULL).
+ *
+ * RETURN: number of problems found
+ */
+int decode_program(FILE *target)
+{
+    unsigned int pos = 0, labels = 0;
+
+    insn_reset();
+    insn_lit_reset();
+
+    while(pos < wsdata_len) {
+        const unsigned char *end =
+            memchr(&wsdata[pos], '\0', wsdata_len - pos);
+        insn_t *in;
+
+        assert(end); /* every command is terminated by a null byte */
+
+        insn_require(1);
+        in = &insn[insn_len];
+        in->ws_ptr = pos;
+        in->arg = in->arg2 = 0;
+        in->next = insn_len + 1;
+        in->op = decode_insn(&wsdata[pos], in);
+
+        if(in->op == OP_LABEL) labels ++;
+
+        insn_len ++;
+        pos = (end - wsdata) + 1;
+    }
+
+    /* terminate the program, so we needn't check the boundaries while
+     * executing it
+     */
+    insn_require(1);
+    insn[insn_len].op = OP_END;
+    insn[insn_len].arg = insn[insn_len].arg2 = 0;
+    insn[insn_len].next = insn_len;
+    insn[insn_len].ws_ptr = wsdata_len;
+    insn_len ++;
+
+    return decode_resolve_labels(target, labels);
+}
+
+
+
+/* insn_op decode_insn(const unsigned char *ip, insn_t *in)
+ *
+ * decode the whitespace command ip points to, store the argument (if any)
+ * to in->arg. For flow control commands the offset of the label's bits is
+ * stored there, for decode_resolve_labels to pick it up.
+ *
+ * RETURN: opcode of the command
+ */
+static insn_op decode_insn(const unsigned char *ip, insn_t *in)
+{
+    switch(ip[0]) {
+        case ' ': /* stack manipulation */
+            switch(ip[1]) {
+                case ' ':
+                    /* sign must be either \t or ' '! */
+                    if(ip[2] == '\n') return OP_SYNTAX_ERROR;
+
+                    insn_lit_require(1);
+                    decode_value(&insn_lit[insn_lit_len], &ip[2]);
+                    in->arg = insn_lit_len ++;
+                    return OP_PUSH;
+
+                case '\n':
+                    switch(ip[2]) {
+                        case ' ': return OP_DUP;
+                        case '\t': return OP_SWAP;
+                        case '\n': return OP_DISCARD;
+                    }
+                    return OP_SYNTAX_ERROR;
+
+                case '\t':
+                    /* enforce positive numbers, which begin with a space */
+                    if(ip[2] == '\t' || ip[3] != ' ') return OP_SYNTAX_ERROR;
+                    in->arg = decode_number(&ip[4]);
+
+                    switch(ip[2]) {
+                        case ' ': return OP_COPY;
+                        case '\n': return OP_SLIDE;
+                    }
+                    return OP_SYNTAX_ERROR;
+            }
+            return OP_SYNTAX_ERROR;
+
+        case '\t':
+            switch(ip[1]) {
+                case ' ': /* arithmetic */
+                    switch(ip[2]) {
+                        case ' ':
+                            switch(ip[3]) {
+                                case ' ': return OP_ADD;
+                                case '\t': return OP_SUB;
+                                case '\n': return OP_MUL;
+                            }
+                            break;
+
+                        case '\t':
+                            switch(ip[3]) {
+                                case ' ': return OP_DIV;
+                                case '\t': return OP_MOD;
+                            }
+                            break;
+                    }
+                    return OP_SYNTAX_ERROR;
+
+                case '\t': /* heap access */
+                    switch(ip[2]) {
+                        case ' ': return OP_STORE;
+                        case '\t': return OP_RETRIEVE;
+                    }
+                    return OP_SYNTAX_ERROR;
+
+                case '\n': /* i/o */
+                    switch(ip[2]) {
+                        case ' ':
+                            switch(ip[3]) {
+                                case ' ': return OP_PRINTC;
+                                case '\t': return OP_PRINTN;
+                            }
+                            break;
+
+                        case '\t':
+                            switch(ip[3]) {
+                                case ' ': return OP_READC;
+                                case '\t': return OP_READN;
+                            }
+                            break;
+                    }
+                    return OP_SYNTAX_ERROR;
+            }
+            return OP_SYNTAX_ERROR;
+
+        case '\n': /* flow control */
+            in->arg = (ip - wsdata) + 3; /* first bit of the label */
+
+            switch(ip[1]) {
+                case ' ':
+                    switch(ip[2]) {
+                        case ' ': return OP_LABEL;
+                        case '\t': return OP_CALL;
+                        case '\n': return OP_JUMP;
+                    }
+                    break;
+
+                case '\t':
+                    switch(ip[2]) {
+                        case ' ': return OP_JZ;
+                        case '\t': return OP_JN;
+                        case '\n': in->arg = 0; return OP_RET;
+                    }
+                    break;
+
+                case '\n':
+                    in->arg = 0;
+                    return ip[2] == '\n' ? OP_EXIT : OP_SYNTAX_ERROR;
+            }
+            return OP_SYNTAX_ERROR;
+    }
+
+    return OP_SYNTAX_ERROR;
+}
+
+
+
+/* unsigned int decode_number(const unsigned char *ptr)
+ *
+ * reinterpret ws-style-number to common unsigned int value, make
+ * sure ptr points to the char behind the sign bit of the ws-string!
+ */
+static unsigned int decode_number(const unsigned char *ptr)
+{
+    unsigned int value = 0;
+
+    for(; *ptr != '\n'; ptr ++)
+        value = (value << 1) | (*ptr == '\t');
+
+    return value;
+}
+
+
+
+/* void decode_value(WSVAR_TYPE *result, const unsigned char *ptr)
+ *
+ * reinterpret ws-style-number to WSVAR_TYPE, ptr points to the sign bit
+ */
+static void decode_value(WSVAR_TYPE *result, const unsigned char *ptr)
+{
+    int negative = (*ptr == '\t');
+
+    WSVAR_SET_SI(*result, 0);
+
+    for(ptr ++; *ptr != '\n'; ptr ++) {
+        WSVAR_MUL_UI(*result, *result, 2);
+        if(*ptr == '\t') WSVAR_ADD_UI(*result, *result, 1);
+    }
+
+    if(negative) WSVAR_NEG(*result, *result);
+}
+
+
+
+
+/* label lookup table, only needed while resolving the jump targets. It's
+ * an open addressing hash table, mapping the label's bits (which are
+ * terminated by \n) to the index of its OP_LABEL instruction.
+ */
+typedef struct {
+    const unsigned char *label;
+    unsigned int index;
+} decode_label_t;
+
+
+
+/* unsigned int decode_label_hash(const unsigned char *label)
+ *
+ * calculate FNV-1a hash of the label bits
+ */
+static unsigned int decode_label_hash(const unsigned char *label)
+{
+    unsigned int hash = 2166136261U;
+
+    for(; *label != '\n'; label ++)
+        hash = (hash ^ *label) * 16777619U;
+
+    return hash;
+}
+
+
+
+/* int decode_label_equal(const unsigned char *a, const unsigned char *b)
+ *
+ * check whether both labels are the same
+ */
+static int decode_label_equal(const unsigned char *a, const unsigned char *b)
+{
+    for(; *a == *b; a ++, b ++)
+        if(*a == '\n') return 1;
+
+    return 0;
+}
+
+
+
+/* decode_label_t *decode_label_lookup(decode_label_t *tab, unsigned int mask,
+ *                                     const unsigned char *label)
+ *
+ * find the slot of the label in the table, or the free slot where it
+ * would have to be put.
+ */
+static decode_label_t *decode_label_lookup(decode_label_t *tab,
+                                           unsigned int mask,
+                                           const unsigned char *label)
+{
+    unsigned int slot = decode_label_hash(label) & mask;
+
+    while(tab[slot].label && !decode_label_equal(tab[slot].label, label))
+        slot = (slot + 1) & mask;
+
+    return &tab[slot];
+}
+
+
+
+/* int decode_resolve_labels(FILE *target, unsigned int labels)
+ *
+ * replace the label offsets of all calls and jumps by the index of the
+ * instruction right behind the label. Jumps to labels that aren't
+ * defined get a trap instruction of their own as their target.
+ *
+ * RETURN: number of problems found (and reported to target)
+ */
+static int decode_resolve_labels(FILE *target, unsigned int labels)
+{
+    unsigned int i, size = 16, prog_len = insn_len;
+    int problems = 0;
+    decode_label_t *tab;
+
+    while(size < labels * 2) size <<= 1;
+    tab = calloc(size, sizeof(*tab));
+    assert(tab);
+
+    for(i = 0; i < prog_len; i ++)
+        if(insn[i].op == OP_LABEL) {
+            decode_label_t *slot =
+                decode_label_lookup(tab, size - 1, &wsdata[insn[i].arg]);
+
+            /* if the label is defined twice, the last one counts (like
+             * it always did)
+             */
+            if(slot->label) {
+                problems ++;
+                if(target)
+                    fprintf(target, "Label at 0x%04x is defined again at "
+                            "0x%04x, using the latter.\n",
+                            insn[slot->index].ws_ptr, insn[i].ws_ptr);
+            }
+
+            slot->label = &wsdata[insn[i].arg];
+            slot->index = i;
+        }
+
+    for(i = 0; i < prog_len; i ++)
+        switch(insn[i].op) {
+            case OP_CALL:
+            case OP_JUMP:
+            case OP_JZ:
+            case OP_JN:
+                {
+                    decode_label_t *slot =
+                        decode_label_lookup(tab, size - 1, &wsdata[insn[i].arg]);
+
+                    if(slot->label) {
+                        insn[i].arg = insn[slot->index].next;
+                        break;
+                    }
+
+                    problems ++;
+                    if(target)
+                        fprintf(target, "Label of jump at 0x%04x "
+                                "isn't defined.\n", insn[i].ws_ptr);
+
+                    /* label not found, jump into a trap */
+                    insn_require(1);
+                    insn[insn_len].op = OP_NO_LABEL;
+                    insn[insn_len].arg = insn[insn_len].arg2 = 0;
+                    insn[insn_len].next = insn_len;
+                    insn[insn_len].ws_ptr = insn[i].ws_ptr;
+                    insn[i].arg = insn_len ++;
+                }
+                break;
+
+            case OP_LABEL:
+                insn[i].arg = 0;
+                break;
+        }
+
+    free(tab);
+    return problems;
+}
+
+
+
+/* unsigned char *decode_entries(void)
+ *
+ * find the instructions, that may be entered other than from the
+ * instruction right before them, i.e. jump targets and the instructions
+ * calls return to. Passes rewriting the program mustn't merge
+ * instructions across those.
+ *
+ * RETURN: malloc'd array with one flag per instruction
+ */
+unsigned char *decode_entries(void)
+{
+    unsigned int pos;
+    unsigned char *entry = calloc(insn_len + 1, 1);
+    assert(entry);
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        if(insn_is_call(insn[pos].op))
+            entry[insn[pos].next] = 1;
+
+        if(insn_has_target(insn[pos].op))
+            entry[insn[pos].arg] = 1;
+    }
+
+    return entry;
+}
+
+
+
+/* void decode_compact(void)
+ *
+ * remove all OP_NOP instructions from the program, adjusting jump
+ * targets and next indices of the remaining ones.
+ */
+void decode_compact(void)
+{
+    unsigned int pos, len = 0;
+    unsigned int *map = malloc((insn_len + 1) * sizeof(*map));
+    assert(map);
+
+    /* map every instruction to the first remaining one at or behind it.
+     * OP_END is never removed, so there always is one.
+     */
+    map[insn_len] = insn_len;
+    for(pos = insn_len; pos --; )
+        map[pos] = insn[pos].op == OP_NOP ? map[pos + 1] : pos;
+
+    for(pos = 0; pos < insn_len; pos ++)
+        if(insn[pos].op != OP_NOP)
+            map[pos] = len ++;
+
+    for(pos = 0; pos < insn_len; pos ++)
+        if(insn[pos].op == OP_NOP)
+            map[pos] = map[map[pos]];
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        insn_t in = insn[pos];
+
+        if(in.op == OP_NOP) continue;
+
+        in.next = map[in.next];
+        if(insn_has_target(in.op))
+            in.arg = map[in.arg];
+
+        insn[map[pos]] = in;
+    }
+
+    insn_len = len;
+    free(map);
+}
+
+
+
+/* unsigned int decode_lookup(unsigned int ws_ptr)
+ *
+ * find the instruction, whose command starts at wsdata offset ws_ptr.
+ * If there's none, the first instruction behind it (or OP_END).
+ *
+ * RETURN: index into insn
+ */
+unsigned int decode_lookup(unsigned int ws_ptr)
+{
+    unsigned int low = 0, high = insn_len;
+
+    /* the instructions of the program (and the OP_END behind it) are
+     * sorted by their ws_ptr, the trap (and OP_MEMO_RET) instructions
+     * aren't.
+     */
+    while(high > 1 && (insn[high - 1].op == OP_NO_LABEL
+                       || insn[high - 1].op == OP_MEMO_RET))
+        high --;
+
+    high --; /* OP_END, if nothing else matches */
+
+    while(low < high) {
+        unsigned int mid = (low + high) / 2;
+
+        if(insn[mid].ws_ptr < ws_ptr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+
+
+/* lazy decoding **************************************************************/
+
+/* hash tables of the lazy decoder, open addressing again. decode_blocks
+ * maps the wsdata offset of a block's first command to the index of its
+ * first instruction (or its stub), decode_labels the offset of a label's
+ * bits to the offset of the command behind the label. Keys are offset
+ * plus one, zero marks a free slot.
+ */
+typedef struct {
+    unsigned int key;
+    unsigned int value;
+} decode_map_t;
+
+/* value of a slot, that's just been taken */
+#define DECODE_NONE (~0U)
+
+typedef struct {
+    decode_map_t *slots;
+    unsigned int size, used;
+    int labels;         /* compare the label bits, not the offsets */
+} decode_table_t;
+
+static decode_table_t decode_blocks = { NULL, 0, 0, 0 };
+static decode_table_t decode_labels = { NULL, 0, 0, 1 };
+
+/* the labels in front of this wsdata offset are in decode_labels */
+static unsigned int decode_scan = 0;
+
+/* appends the next piece of the program to wsdata, see decode_program_lazy */
+static int (*decode_more)(void) = NULL;
+
+
+
+/* decode_map_t *decode_map_slot(decode_table_t *tab, unsigned int key)
+ *
+ * find the slot of key in the table, or the free slot where it would
+ * have to be put.
+ */
+static decode_map_t *decode_map_slot(decode_table_t *tab, unsigned int key)
+{
+    unsigned int mask = tab->size - 1, slot;
+
+    if(tab->labels) {
+        slot = decode_label_hash(&wsdata[key - 1]) & mask;
+
+        while(tab->slots[slot].key
+              && ! decode_label_equal(&wsdata[tab->slots[slot].key - 1],
+                                      &wsdata[key - 1]))
+            slot = (slot + 1) & mask;
+    }
+    else {
+        slot = (key * 2654435761U) & mask;
+
+        while(tab->slots[slot].key && tab->slots[slot].key != key)
+            slot = (slot + 1) & mask;
+    }
+
+    return &tab->slots[slot];
+}
+
+
+
+/* decode_map_t *decode_map_put(decode_table_t *tab, unsigned int key)
+ *
+ * find the slot of key in the table, taking a free one (with key set,
+ * and value set to DECODE_NONE) if it isn't there yet.
+ */
+static decode_map_t *decode_map_put(decode_table_t *tab, unsigned int key)
+{
+    decode_map_t *slot;
+
+    /* keep the table at most half full */
+    if((tab->used + 1) * 2 > tab->size) {
+        decode_map_t *old = tab->slots;
+        unsigned int i, old_size = tab->size;
+
+        tab->size = old_size ? old_size * 2 : 1024;
+        tab->slots = calloc(tab->size, sizeof(*tab->slots));
+        assert(tab->slots);
+
+        for(i = 0; i < old_size; i ++)
+            if(old[i].key)
+                *decode_map_slot(tab, old[i].key) = old[i];
+
+        free(old);
+    }
+
+    slot = decode_map_slot(tab, key);
+    if(! slot->key) {
+        slot->key = key;
+        slot->value = DECODE_NONE;
+        tab->used ++;
+    }
+
+    return slot;
+}
+
+
+
+/* void decode_program_lazy(int (*more)(void))
+ *
+ * start decoding the program lazily, see decode.h
+ */
+void decode_program_lazy(int (*more)(void))
+{
+    insn_reset();
+    insn_lit_reset();
+
+    free(decode_blocks.slots);
+    free(decode_labels.slots);
+    decode_blocks.slots = decode_labels.slots = NULL;
+    decode_blocks.size = decode_blocks.used = 0;
+    decode_labels.size = decode_labels.used = 0;
+
+    decode_scan = 0;
+    decode_more = more;
+    decode_lazy = 1;
+
+    decode_ref(0);
+}
+
+
+
+/* unsigned int decode_block(unsigned int stub)
+ *
+ * decode the block, the OP_DECODE instruction stub stands for. If the
+ * stub is the last instruction (as it is, if we've just run through the
+ * block before it), it's replaced by the block. Otherwise the block's
+ * appended and the stub becomes a jump to it.
+ *
+ * RETURN: index of the block's first instruction
+ */
+unsigned int decode_block(unsigned int stub)
+{
+    unsigned int pos = insn[stub].ws_ptr, first, last, ref;
+
+    assert(insn[stub].op == OP_DECODE);
+
+    if(stub == insn_len - 1) insn_len --;
+    first = insn_len;
+
+    for(;;) {
+        const unsigned char *end;
+        insn_t *in;
+
+        while(pos >= wsdata_len)
+            if(! decode_more()) break;
+
+        insn_require(1);
+        in = &insn[insn_len];
+        memset(in, 0, sizeof(*in));
+        in->ws_ptr = pos;
+        in->next = insn_len ++;
+
+        /* just like decode_program, running past the last command */
+        if(pos >= wsdata_len) {
+            in->op = OP_END;
+            break;
+        }
+
+        end = memchr(&wsdata[pos], '\0', wsdata_len - pos);
+        assert(end);
+
+        in->next ++;
+        in->op = decode_insn(&wsdata[pos], in);
+        pos = (end - wsdata) + 1;
+
+        /* every flow control command ends the block, even a label (so
+         * the instructions behind one are the start of a block)
+         */
+        if(in->op >= OP_LABEL && in->op <= OP_EXIT) break;
+        if(in->op == OP_SYNTAX_ERROR) break;
+    }
+
+    last = insn_len - 1;
+
+    switch(insn[last].op) {
+        case OP_RET:
+        case OP_EXIT:
+        case OP_SYNTAX_ERROR:
+            insn[last].next = last;
+            break;
+
+        /* decode_target and decode_ref may move insn, so don't assign
+         * their results right away (insn might be read before the call)
+         */
+        case OP_JUMP:
+            insn[last].next = last;
+            ref = decode_target(last);
+            insn[last].arg = ref;
+            break;
+
+        case OP_CALL:
+        case OP_JZ:
+        case OP_JN:
+            /* first the stub of the instructions behind, so it's likely
+             * to be the last one, when we get there
+             */
+            ref = decode_ref(pos);
+            insn[last].next = ref;
+            ref = decode_target(last);
+            insn[last].arg = ref;
+            break;
+
+        case OP_LABEL:
+            insn[last].arg = 0;
+            ref = decode_ref(pos);
+            insn[last].next = ref;
+            break;
+    }
+
+    if(first != stub) {
+        insn[stub].op = OP_JUMP;
+        insn[stub].arg = first;
+        decode_map_put(&decode_blocks, insn[first].ws_ptr + 1)->value = first;
+    }
+
+    return first;
+}
+
+
+
+/* unsigned int decode_ref(unsigned int ws_ptr)
+ *
+ * RETURN: index of the instruction of the command at wsdata offset ws_ptr,
+ *         the first one of a block. If it isn't decoded yet, that of a
+ *         new OP_DECODE stub.
+ */
+static unsigned int decode_ref(unsigned int ws_ptr)
+{
+    decode_map_t *slot = decode_map_put(&decode_blocks, ws_ptr + 1);
+
+    if(slot->value != DECODE_NONE) return slot->value;
+    slot->value = insn_len;
+
+    insn_require(1);
+    memset(&insn[insn_len], 0, sizeof(*insn));
+    insn[insn_len].op = OP_DECODE;
+    insn[insn_len].next = insn_len;
+    insn[insn_len].ws_ptr = ws_ptr;
+    return insn_len ++;
+}
+
+
+
+/* unsigned int decode_target(unsigned int jump)
+ *
+ * find the label, the instruction at index jump refers to (its arg is
+ * the label bits' offset still). Labels are looked up in decode_labels,
+ * which the first call fills, scanning the rest of the program.
+ *
+ * RETURN: index of the jump target. If the label isn't defined, that of
+ *         a new OP_NO_LABEL trap.
+ */
+static unsigned int decode_target(unsigned int jump)
+{
+    unsigned int label = insn[jump].arg;
+
+    /* if the label is defined twice, the last one counts, i.e. all of
+     * them have to be known before the first jump is resolved
+     */
+    for(;;) {
+        const unsigned char *cmd, *end;
+
+        while(decode_scan >= wsdata_len)
+            if(! decode_more()) break;
+
+        if(decode_scan >= wsdata_len) break;
+
+        cmd = &wsdata[decode_scan];
+        end = memchr(cmd, '\0', wsdata_len - decode_scan);
+        assert(end);
+        decode_scan = (end - wsdata) + 1;
+
+        if(cmd[0] != '\n' || cmd[1] != ' ' || cmd[2] != ' ') continue;
+
+        decode_map_put(&decode_labels, (cmd - wsdata) + 3 + 1)->value =
+            decode_scan;
+    }
+
+    if(decode_labels.size) {
+        decode_map_t *slot = decode_map_slot(&decode_labels, label + 1);
+        if(slot->key) return decode_ref(slot->value);
+    }
+
+    /* label not found, jump into a trap */
+    insn_require(1);
+    memset(&insn[insn_len], 0, sizeof(*insn));
+    insn[insn_len].op = OP_NO_LABEL;
+    insn[insn_len].next = insn_len;
+    insn[insn_len].ws_ptr = insn[jump].ws_ptr;
+    return insn_len ++;
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
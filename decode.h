@@ -0,0 +1,187 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * decode.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * pre-decoded instruction stream, built from wsdata
+ */
+
+#ifndef _DECODE_H
+#define _DECODE_H
+
+#include "interprt.h"
+
+
+
+/* opcodes of the decoded instruction stream **********************************/
+typedef enum {
+    /* stack manipulation */
+    OP_PUSH,            /* arg: index into insn_lit */
+    OP_DUP,
+    OP_COPY,            /* arg: stack position to copy */
+    OP_SWAP,
+    OP_DISCARD,
+    OP_SLIDE,           /* arg: number of items to discard below top */
+
+    /* arithmetic */
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+
+    /* heap access */
+    OP_STORE,
+    OP_RETRIEVE,
+
+    /* flow control, arg is the index of the jump target (if any) */
+    OP_LABEL,
+    OP_CALL,
+    OP_JUMP,
+    OP_JZ,
+    OP_JN,
+    OP_RET,
+    OP_EXIT,
+
+    /* i/o */
+    OP_PRINTC,
+    OP_PRINTN,
+    OP_READC,
+    OP_READN,
+
+    /* superinstructions, see fuse.c */
+    OP_PUSH_ADD,        /* push arg; add */
+    OP_PUSH_SUB,        /* push arg; sub */
+    OP_PUSH_RETRIEVE,   /* push arg; retrieve -- arg2: heap address (int) */
+    OP_PUSH_SWAP_STORE, /* push arg; swap; store -- arg2: heap address (int) */
+    OP_DUP_JZ,          /* dup; jz arg */
+    OP_DUP_JN,          /* dup; jn arg */
+    OP_COPY_PUSH_SUB,   /* copy arg; push arg2; sub */
+    OP_PUSH_SUB_JZ,     /* push arg2; sub; jz arg */
+    OP_TAIL_CALL,       /* call arg; ret -- calls only if there's no caller */
+    OP_JUMP_RET,        /* jump arg, arg being a ret -- returns right away */
+
+    /* strength reduced instructions, see optimize.c */
+    OP_SHL,             /* push arg; mul -- arg is 2^arg2 */
+    OP_DIV_POW2,        /* push arg; div -- arg is 2^arg2 */
+    OP_MOD_POW2,        /* push arg; mod -- arg is 2^arg2 */
+
+    /* pseudo instructions, not part of the whitespace language */
+    OP_NOP,             /* removed by the optimizer, see decode_compact */
+    OP_SYNTAX_ERROR,    /* unparsable command */
+    OP_NO_LABEL,        /* jump target of jumps to a missing label */
+    OP_END,             /* behind the last instruction, no \n\n\n found */
+    OP_MEMO_RET,        /* return from a memoized subroutine, see memo.c */
+    OP_DECODE,          /* block not decoded yet, see decode_block */
+
+    OP_LAST
+} insn_op;
+
+
+
+/* a single decoded instruction ***********************************************/
+typedef struct {
+    unsigned int op;     /* one of insn_op */
+    unsigned int arg;    /* literal index, stack position or jump target */
+    unsigned int arg2;   /* second argument of superinstructions */
+    unsigned int next;   /* index of the instruction to execute next */
+    unsigned int ws_ptr; /* offset of the instruction's command in wsdata */
+    unsigned char block; /* one of BLOCK_*, see the values below */
+    unsigned char need;  /* stack items a BLOCK_LEADER's block needs */
+    unsigned short grow; /* stack items the block pushes at most */
+    const void *dispatch; /* handler address, for the threaded engine */
+    const void *fast;    /* handler address, within a verified block */
+} insn_t;
+
+/* values of insn_t.block */
+#define BLOCK_CHECKED 0     /* run with stack checks only */
+#define BLOCK_LEADER  1     /* first instruction of a verified block */
+#define BLOCK_BODY    2     /* further instruction of a verified block */
+#define BLOCK_NATIVE  3     /* BLOCK_LEADER, run on native integers */
+#define BLOCK_REGVM   4     /* BLOCK_LEADER, run on the register machine */
+#define BLOCK_IDIOM   5     /* first instruction of a loop, run in bulk */
+#define BLOCK_MEMO    6     /* entry of a subroutine, that's memoized */
+
+
+
+/* instruction properties *****************************************************/
+/* does the instruction's arg hold a jump target? */
+#define insn_has_target(op) \
+    ((op) == OP_CALL || (op) == OP_JUMP || (op) == OP_JZ || (op) == OP_JN \
+     || (op) == OP_DUP_JZ || (op) == OP_DUP_JN || (op) == OP_PUSH_SUB_JZ \
+     || (op) == OP_TAIL_CALL || (op) == OP_JUMP_RET)
+
+/* may the instruction return to its next instruction? */
+#define insn_is_call(op) ((op) == OP_CALL || (op) == OP_TAIL_CALL)
+
+
+
+/* insn stack *****************************************************************/
+STACK_DEF_EXT(insn_t, insn, insn_len, insn_alloc)
+#define insn_require(n)     STACK_REQUIRE(insn, insn_len, insn_alloc, n)
+#define insn_reset()        (insn_len = 0)
+
+/* the decoded program. insn[0] is the first instruction of wsdata, the
+ * program is followed by an OP_END instruction and (possibly) a bunch of
+ * OP_NO_LABEL trap instructions, one for each jump to a label that
+ * doesn't exist. The traps carry the ws_ptr of the failing jump, so
+ * errors are reported where they belong. memo_program may append an
+ * OP_MEMO_RET instruction at last.
+ */
+
+
+
+/* insn_lit stack *************************************************************/
+STACK_DEF_EXT(WSVAR_TYPE, insn_lit, insn_lit_len, insn_lit_alloc)
+#define insn_lit_reset()    WSVAR_STACK_RESET(insn_lit,insn_lit_len,insn_lit_alloc)
+#define insn_lit_require(r) WSVAR_STACK_REQUIRE(insn_lit,insn_lit_len,insn_lit_alloc,(r))
+
+/* literal pool, the values of all push instructions are stored here (in
+ * order to keep insn_t small and of fixed size, even with GNU MP).
+ */
+
+
+
+/* prototypes *****************************************************************/
+int decode_program(FILE *target);
+void decode_program_lazy(int (*more)(void));
+unsigned int decode_block(unsigned int stub);
+unsigned int decode_lookup(unsigned int ws_ptr);
+unsigned char *decode_entries(void);
+void decode_compact(void);
+
+extern int decode_lazy;
+
+/* decode_program_lazy decodes nothing but sets up an OP_DECODE stub at
+ * index 0, standing for the program's first block. Running into a stub,
+ * the engine calls decode_block, which decodes the block (up to the next
+ * flow control command) and returns its index. Jump targets and the
+ * instructions behind a block get stubs of their own, the labels are
+ * looked up once the first jump's run into (the whole program is scanned
+ * for them then, the last definition of a label wins). more is called to
+ * append the next piece of the program to wsdata (see load_file_more),
+ * it returns 0 at the end. decode_program_lazy sets decode_lazy.
+ *
+ * a lazily decoded program isn't sorted by ws_ptr, and OP_END and the
+ * traps are put anywhere. Neither decode_lookup nor any of the passes
+ * working on the whole program (fuse, optimize, verify, ...) can be
+ * used with it.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
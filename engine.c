@@ -0,0 +1,95 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * execution engine, running the pre-decoded instruction stream
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "engine.h"
+#include "verify.h"
+#include "native.h"
+#include "regvm.h"
+#include "idiom.h"
+#include "memo.h"
+
+/* access n-th item from the top of exec_stack, TOP(0) is the top */
+#define TOP(n) exec_stack[exec_stack_len - 1 - (n)]
+
+
+
+/* per instruction execution counters (wsi --stats), NULL if disabled */
+unsigned long *engine_counts = NULL;
+
+/* run blocks on the register machine (wsi --regvm) */
+int engine_registers = 0;
+
+/* run loops, that idiom.c recognizes, in bulk (wsi --no-idioms) */
+int engine_idioms = 0;
+
+/* remember the results of pure subroutines (wsi --memoize) */
+int engine_memoize = 0;
+
+/* the run function, see engine_run.h */
+#define ENGINE_RUN engine_run
+#define ENGINE_TYPE WSVAR_TYPE
+#define ENGINE_LITERALS()
+#include "engine_run.h"
+
+
+
+/* interprt_do_stat engine_step(void)
+ *
+ * execute exactly one instruction
+ */
+interprt_do_stat engine_step(void)
+{
+    const insn_t *ip = &insn[exec_bt_pop()];
+    interprt_do_stat stat = DO_OKAY;
+    long address;
+
+#define CASE(op)            case op
+#define DEFAULT             default
+#define NEXT()              { ip = &insn[ip->next]; goto stop; }
+#define JUMP(t)             { ip = &insn[t]; goto stop; }
+#define CHECK(c)            (c)
+#define RESERVE(n)          exec_stack_require(n)
+#define DECODED(stub,from)
+
+    switch(ip->op) {
+#include "engine_ops.h"
+    }
+
+stop:
+    if(stat != DO_OKAY)
+        interprt_running = 0;
+
+    exec_bt_push(ip - insn);
+    return stat;
+
+#undef CASE
+#undef DEFAULT
+#undef NEXT
+#undef JUMP
+#undef DECODED
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
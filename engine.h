@@ -0,0 +1,70 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * execution engine, running the pre-decoded instruction stream
+ */
+
+#ifndef _ENGINE_H
+#define _ENGINE_H
+
+#include "decode.h"
+
+
+
+/* prototypes *****************************************************************/
+interprt_do_stat engine_run(void);
+interprt_do_stat engine_step(void);
+
+interprt_do_stat engine_int32_run(void);
+interprt_do_stat engine_int64_run(void);
+#ifdef __SIZEOF_INT128__
+interprt_do_stat engine_int128_run(void);
+#endif
+
+extern unsigned long *engine_counts;
+extern int engine_registers;
+extern int engine_idioms;
+extern int engine_memoize;
+
+/* both execute the decoded program (see decode_program), starting at the
+ * instruction whose index is on top of exec_bt. engine_run goes on till
+ * the program exits, runs into an error or reaches a breakpoint,
+ * engine_step executes a single instruction only.
+ *
+ * exec_bt holds the indices of the instructions to return to, topped by
+ * the index of the current instruction. When the engine stops, the top
+ * of exec_bt is the instruction to continue at (or the failing one).
+ *
+ * if engine_counts points to an array of insn_len counters, engine_run
+ * counts how often each instruction is executed. If engine_registers is
+ * set, it translates the blocks to register code first and runs them on
+ * the register machine of regvm.c (that's the threaded engine only, and
+ * only if it doesn't count). If engine_idioms is set, loops that fill,
+ * copy, print or sum up heap cells are run in bulk (see idiom.c). If
+ * engine_memoize is set, the results of pure subroutines are remembered,
+ * and looked up on further calls (see memo.c).
+ *
+ * engine_int32_run, engine_int64_run and engine_int128_run are just like
+ * engine_run, but calculate with native integers of that size, wrapping
+ * around on overflow (see engine_num.h and numeric.c).
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
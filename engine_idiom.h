@@ -0,0 +1,167 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_idiom.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * running the loops, that idiom.c recognizes, in bulk
+ */
+
+/* this file is no ordinary header either, it's included by engine_run.h
+ * to get engine_idiom for every numeric type.
+ */
+
+/* variable v of loop id, the stack item or the heap cell */
+#define IDIOM_VAR(id,v) \
+    (*((id)->var[v].slot ? &TOP((id)->var[v].at) \
+                         : exec_heap_cell((id)->var[v].at)))
+
+/* cells from address a to the end of its page, going by step */
+#define IDIOM_PAGE_LEFT(a,step) \
+    ((step) > 0 ? (long) (PAGE_CELLS - ((unsigned long) (a) & (PAGE_CELLS - 1))) \
+                : (long) ((unsigned long) (a) & (PAGE_CELLS - 1)) + 1)
+
+
+
+/* int engine_idiom_exits(const idiom_t *id, ENGINE_TYPE *v)
+ *
+ * RETURN: 1 if loop id leaves, given v is the value it loads, 0 if not
+ */
+static int engine_idiom_exits(const idiom_t *id, ENGINE_TYPE *v)
+{
+    int cmp = id->cond_lit == IDIOM_NO_LIT
+        ? WSVAR_CMP_ZERO(*v) : WSVAR_CMP(*v, insn_lit[id->cond_lit]);
+
+    switch(id->exit) {
+        case IDIOM_EXIT_ZERO:
+            return ! cmp;
+        case IDIOM_EXIT_NONZERO:
+            return cmp != 0;
+        case IDIOM_EXIT_NEG:
+            return cmp < 0;
+        default:
+            return cmp >= 0;
+    }
+}
+
+
+
+/* void engine_idiom(const insn_t *ip)
+ *
+ * run the loop starting at ip for as many iterations as idiom_iterations
+ * allows (and as the values loaded don't leave it), just as if they had
+ * been run one by one. Nothing's done, if the loop's variables aren't
+ * small enough or there are too few stack items.
+ */
+static void engine_idiom(const insn_t *ip)
+{
+    const idiom_t *id = &idiom_table[ip - insn];
+    long value[IDIOM_MAX_VARS], n, done, load = 0, store = 0;
+    long load_step = 0, store_step = 0;
+    ENGINE_TYPE *fill = NULL, *sum = NULL;
+    unsigned int i;
+
+    if(exec_stack_len < id->need) return;
+
+    for(i = 0; i < id->vars; i ++)
+        if(id->var[i].exact) {
+            ENGINE_TYPE *v = &IDIOM_VAR(id, i);
+
+            if(! WSVAR_FITS_SI(*v)) return;
+            value[i] = WSVAR_GET_SI(*v);
+            if(value[i] <= -IDIOM_MAX_VALUE || value[i] >= IDIOM_MAX_VALUE)
+                return;
+        }
+
+    n = idiom_iterations(id, value);
+    if(n <= 0) return;
+
+    if(id->kind != IDIOM_FILL) {
+        load = value[id->load_var] + id->load_offset;
+        load_step = id->var[id->load_var].step;
+    }
+
+    if(id->kind == IDIOM_FILL || id->kind == IDIOM_COPY) {
+        store = value[id->store_var] + id->store_offset;
+        store_step = id->var[id->store_var].step;
+    }
+
+    if(id->kind == IDIOM_FILL)
+        fill = id->fill_lit != IDIOM_NO_LIT
+            ? &insn_lit[id->fill_lit] : &IDIOM_VAR(id, id->fill_var);
+
+    if(id->kind == IDIOM_SUM)
+        sum = &IDIOM_VAR(id, id->sum_var);
+
+    /* page by page, the cells within a page are adjacent */
+    for(done = 0; done < n; ) {
+        ENGINE_TYPE *src = NULL, *dest = NULL;
+        long run = n - done, k;
+
+        if(load_step) {
+            src = exec_heap_cell(load + done * load_step);
+            k = IDIOM_PAGE_LEFT(load + done * load_step, load_step);
+            if(k < run) run = k;
+        }
+
+        if(store_step) {
+            dest = exec_heap_cell(store + done * store_step);
+            k = IDIOM_PAGE_LEFT(store + done * store_step, store_step);
+            if(k < run) run = k;
+        }
+
+        for(k = 0; k < run; k ++) {
+            if(id->cond_load && engine_idiom_exits(id, src)) break;
+
+            switch(id->kind) {
+                case IDIOM_FILL:
+                    WSVAR_ASSIGN(*dest, *fill);
+                    break;
+
+                case IDIOM_COPY:
+                    if(src != dest) WSVAR_ASSIGN(*dest, *src);
+                    break;
+
+                case IDIOM_PRINT:
+                    if(id->print_op == OP_PRINTC)
+                        putchar((int)WSVAR_GET_UI(*src) & 0xff);
+                    else
+                        WSVAR_PRINTF(*src);
+                    break;
+
+                default: /* IDIOM_SUM */
+                    WSVAR_ADD(*sum, *sum, *src);
+                    break;
+            }
+
+            src += load_step;
+            dest += store_step;
+        }
+
+        done += k;
+        if(k < run) break;
+    }
+
+    /* the variables, that went on with the iterations */
+    for(i = 0; i < id->vars; i ++)
+        if(id->var[i].step)
+            WSVAR_SET_SI(IDIOM_VAR(id, i), value[i] + done * id->var[i].step);
+}
+
+#undef IDIOM_VAR
+#undef IDIOM_PAGE_LEFT
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,37 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_int128.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * execution engine, on numbers of 128 bits (wsi --num=int128)
+ */
+
+#include <stdint.h>
+
+/* gcc (and compatible compilers) only, on 64 bit hosts */
+#ifdef __SIZEOF_INT128__
+
+#define NUM_TYPE    __int128
+#define NUM_UTYPE   unsigned __int128
+#define NUM_BITS    128
+#define NUM_RUN     engine_int128_run
+
+#include "engine_num.h"
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,32 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_int32.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * execution engine, on numbers of 32 bits (wsi --num=int32)
+ */
+
+#include <stdint.h>
+
+#define NUM_TYPE    int32_t
+#define NUM_UTYPE   uint32_t
+#define NUM_BITS    32
+#define NUM_RUN     engine_int32_run
+
+#include "engine_num.h"
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
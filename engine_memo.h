@@ -0,0 +1,102 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_memo.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * calling memoized subroutines
+ */
+
+/* this file is no ordinary header either, it's included by engine_run.h
+ * to get engine_memo and engine_memo_return for every numeric type.
+ */
+
+/* int engine_memo(const insn_t *ip)
+ *
+ * we're entering the pure subroutine at ip (the return address being on
+ * top of exec_bt). If we know the result already, replace the items it
+ * takes by those it leaves. Otherwise let the subroutine return to
+ * OP_MEMO_RET, to remember the result.
+ *
+ * RETURN: 1 if the result's on the stack, 0 if the subroutine has to run
+ */
+static int engine_memo(const insn_t *ip)
+{
+    const memo_t *m = &memo_table[ip - insn];
+    long key[MEMO_MAX_NEED];
+    const long *result;
+    memo_frame_t *f;
+    unsigned int i;
+
+    if(! exec_bt_len || exec_stack_len < m->need) return 0;
+
+    for(i = 0; i < m->need; i ++) {
+        if(! WSVAR_FITS_SI(TOP(i))) return 0;
+        key[i] = WSVAR_GET_SI(TOP(i));
+    }
+
+    if((result = memo_lookup(ip - insn, key))) {
+        exec_stack_len -= m->need;
+        exec_stack_require(m->out);
+        exec_stack_len += m->out;
+
+        for(i = 0; i < m->out; i ++)
+            WSVAR_SET_SI(TOP(i), result[i]);
+
+        return 1;
+    }
+
+    STACK_REQUIRE(memo_frames, memo_frames_len, memo_frames_alloc, 1);
+    assert(memo_frames);
+
+    f = &memo_frames[memo_frames_len ++];
+    f->entry = ip - insn;
+    f->ret = exec_bt_pop();
+    f->depth = exec_stack_len;
+    memcpy(f->key, key, sizeof(key));
+
+    exec_bt_push(memo_return);
+    return 0;
+}
+
+
+
+/* unsigned int engine_memo_return(void)
+ *
+ * the pure subroutine called last returned, remember what it left on
+ * the stack
+ *
+ * RETURN: the instruction to return to
+ */
+static unsigned int engine_memo_return(void)
+{
+    const memo_frame_t *f = &memo_frames[-- memo_frames_len];
+    const memo_t *m = &memo_table[f->entry];
+    long result[MEMO_MAX_OUT];
+    unsigned int i;
+
+    assert(exec_stack_len == f->depth - m->need + m->out);
+
+    for(i = 0; i < m->out; i ++) {
+        if(! WSVAR_FITS_SI(TOP(i))) return f->ret;
+        result[i] = WSVAR_GET_SI(TOP(i));
+    }
+
+    memo_store(f->entry, f->key, result);
+    return f->ret;
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,351 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_num.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * execution engine, on fixed size native integers
+ */
+
+/* this file is no ordinary header, it's included by engine_int32.c,
+ * engine_int64.c and engine_int128.c, each of them getting an engine of
+ * its own, that runs on its numeric type. The includer has to define:
+ *
+ *   NUM_TYPE   the signed integer type to calculate with
+ *   NUM_UTYPE  the unsigned integer type of the same size
+ *   NUM_BITS   the number of bits of both
+ *   NUM_RUN    the name of the run function
+ *
+ * The engine keeps a stack, a heap and a literal pool of NUM_TYPE, which
+ * are converted from (and back to) exec_stack, exec_heap and insn_lit on
+ * entry (and exit) of NUM_RUN. Numbers wrap around on overflow, like the
+ * numbers of builds without GNU MP do.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "interprt.h"
+#include "engine.h"
+#include "verify.h"
+#include "idiom.h"
+#include "memo.h"
+
+/* the native copies of exec_stack, exec_heap and insn_lit */
+static NUM_TYPE *num_stack = NULL;
+static unsigned int num_stack_len = 0;
+static unsigned int num_stack_alloc = 0;
+
+static PAGEDIR_DEF(NUM_TYPE, num_heap, NULL, NULL)
+
+static NUM_TYPE *num_lit = NULL;
+static unsigned int num_lit_len = 0;
+
+/* scratch register of num_input */
+static WSVAR_TYPE num_scratch;
+static int num_scratch_ready = 0;
+
+static interprt_do_stat num_run(void);
+static void num_lit_load(void);
+
+
+
+/* NUM_TYPE num_import(WSVAR_TYPE *src)
+ *
+ * convert src to NUM_TYPE, keeping the least significant NUM_BITS bits
+ */
+static NUM_TYPE num_import(WSVAR_TYPE *src)
+{
+    NUM_UTYPE result = 0;
+    unsigned int shift;
+    int negative = WSVAR_CMP_ZERO(*src) < 0;
+    WSVAR_TYPE rest, chunk;
+
+    WSVAR_INIT(rest);
+    WSVAR_INIT(chunk);
+
+    if(negative)
+        WSVAR_NEG(rest, *src);
+    else
+        WSVAR_ASSIGN(rest, *src);
+
+    /* 30 bit chunks, that's what WSVAR_MOD_2EXP supports */
+    for(shift = 0; shift < NUM_BITS && WSVAR_CMP_ZERO(rest); shift += 30) {
+        WSVAR_MOD_2EXP(chunk, rest, 30);
+        result |= (NUM_UTYPE) WSVAR_GET_UI(chunk) << shift;
+        WSVAR_DIV_2EXP(rest, rest, 30);
+    }
+
+    WSVAR_CLEAR(rest);
+    WSVAR_CLEAR(chunk);
+
+    return (NUM_TYPE) (negative ? 0 - result : result);
+}
+
+
+
+/* void num_export(WSVAR_TYPE *dest, NUM_TYPE v)
+ *
+ * convert v back to WSVAR_TYPE
+ */
+static void num_export(WSVAR_TYPE *dest, NUM_TYPE v)
+{
+    NUM_UTYPE magnitude = v < 0 ? 0 - (NUM_UTYPE) v : (NUM_UTYPE) v;
+    int shift;
+
+    WSVAR_SET_SI(*dest, 0);
+
+    for(shift = (NUM_BITS - 1) / 30 * 30; shift >= 0; shift -= 30) {
+        WSVAR_MUL_2EXP(*dest, *dest, 30);
+        WSVAR_ADD_UI(*dest, *dest,
+                     (unsigned long) (magnitude >> shift) & 0x3FFFFFFFUL);
+    }
+
+    if(v < 0) WSVAR_NEG(*dest, *dest);
+}
+
+
+
+/* void num_load(void)
+ *
+ * copy exec_stack, exec_heap and insn_lit to their native counterparts
+ */
+static void num_load(void)
+{
+    unsigned int i;
+
+    num_stack_len = 0;
+    STACK_REQUIRE(num_stack, num_stack_len, num_stack_alloc, exec_stack_len);
+    for(; num_stack_len < exec_stack_len; num_stack_len ++)
+        num_stack[num_stack_len] = num_import(&exec_stack[num_stack_len]);
+
+    /* page by page, the native pages are zeroed already */
+    pagedir_reset(&num_heap);
+    for(i = 0; i < exec_heap.size; i ++)
+        if(exec_heap.pages[i]) {
+            WSVAR_TYPE *src = exec_heap.pages[i];
+            NUM_TYPE *dest = pagedir_fault(&num_heap, exec_heap.numbers[i]);
+            unsigned long j;
+
+            for(j = 0; j < PAGE_CELLS; j ++)
+                if(WSVAR_CMP_ZERO(src[j]))
+                    dest[j] = num_import(&src[j]);
+        }
+
+    num_lit_len = 0;
+    num_lit_load();
+}
+
+
+
+/* void num_lit_load(void)
+ *
+ * copy the literals, that have been added to insn_lit since, to num_lit
+ * (all of them after num_load, the new ones after decode_block)
+ */
+static void num_lit_load(void)
+{
+    if(num_lit_len == insn_lit_len && num_lit) return;
+
+    num_lit = realloc(num_lit, (insn_lit_len + 1) * sizeof(*num_lit));
+    assert(num_lit);
+    for(; num_lit_len < insn_lit_len; num_lit_len ++)
+        num_lit[num_lit_len] = num_import(&insn_lit[num_lit_len]);
+}
+
+
+
+/* void num_save(void)
+ *
+ * copy the native stack and heap back to exec_stack and exec_heap
+ */
+static void num_save(void)
+{
+    unsigned int i;
+
+    exec_stack_len = 0;
+    exec_stack_require(num_stack_len);
+    for(; exec_stack_len < num_stack_len; exec_stack_len ++)
+        num_export(&exec_stack[exec_stack_len], num_stack[exec_stack_len]);
+
+    for(i = 0; i < num_heap.size; i ++)
+        if(num_heap.pages[i]) {
+            NUM_TYPE *src = num_heap.pages[i];
+            WSVAR_TYPE *dest = pagedir_fault(&exec_heap, num_heap.numbers[i]);
+            unsigned long j;
+
+            for(j = 0; j < PAGE_CELLS; j ++)
+                num_export(&dest[j], src[j]);
+        }
+}
+
+
+
+/* void num_input(NUM_TYPE *dest, int read_number)
+ *
+ * like interprt_input, but for a native number
+ */
+static void num_input(NUM_TYPE *dest, int read_number)
+{
+    if(! num_scratch_ready) {
+        WSVAR_INIT(num_scratch);
+        num_scratch_ready = 1;
+    }
+
+    num_export(&num_scratch, *dest); /* keep dest, if there is no number */
+
+    interprt_input(&num_scratch, read_number);
+    *dest = num_import(&num_scratch);
+}
+
+
+
+/* void num_print(NUM_TYPE v)
+ *
+ * write v to stdout, in decimal
+ */
+static void num_print(NUM_TYPE v)
+{
+    char buffer[NUM_BITS / 3 + 3];
+    char *ptr = buffer + sizeof(buffer);
+    NUM_UTYPE magnitude = v < 0 ? 0 - (NUM_UTYPE) v : (NUM_UTYPE) v;
+
+    *(-- ptr) = 0;
+
+    do
+        *(-- ptr) = '0' + (char) (magnitude % 10);
+    while(magnitude /= 10);
+
+    if(v < 0) *(-- ptr) = '-';
+
+    fputs(ptr, stdout);
+}
+
+
+
+/* interprt_do_stat NUM_RUN(void)
+ *
+ * run the decoded program till it stops, on native numbers
+ */
+interprt_do_stat NUM_RUN(void)
+{
+    interprt_do_stat stat;
+
+    num_load();
+    stat = num_run();
+    num_save();
+
+    /* the heap's pages may come from a file, that can't grow */
+    if(exec_heap_failed()) stat = DO_HEAP_FULL;
+
+    return stat;
+}
+
+
+
+/* the engine, with the numbers replaced by native ones ***********************/
+#undef exec_stack_require
+#undef exec_heap_cell
+#undef exec_heap_write
+#undef exec_heap_move
+#undef exec_heap_read
+#undef exec_heap_failed
+
+#define exec_stack              num_stack
+#define exec_stack_len          num_stack_len
+#define exec_stack_require(r)   STACK_REQUIRE(num_stack, num_stack_len, num_stack_alloc, (r))
+#define exec_heap_cell(a)       PAGEDIR_CELL(NUM_TYPE, num_heap, a)
+#define exec_heap_write(a,v)    (*exec_heap_cell(a) = (v))
+#define exec_heap_move(a,v)     (*exec_heap_cell(a) = (v))
+#define exec_heap_read(a,d)     ((d) = *exec_heap_cell(a))
+#define exec_heap_failed()      (num_heap.failed)
+#define insn_lit                num_lit
+#define interprt_input          num_input
+
+#undef WSVAR_GET_UI
+#undef WSVAR_GET_SI
+#undef WSVAR_FITS_SI
+#undef WSVAR_SET_SI
+#undef WSVAR_PRINTF
+#undef WSVAR_CMP_ZERO
+#undef WSVAR_CMP
+#undef WSVAR_ASSIGN
+#undef WSVAR_SWAP
+#undef WSVAR_ADD
+#undef WSVAR_SUB
+#undef WSVAR_MUL
+#undef WSVAR_DIV
+#undef WSVAR_MOD
+#undef WSVAR_MUL_2EXP
+#undef WSVAR_DIV_2EXP
+#undef WSVAR_MOD_2EXP
+
+/* the least significant bits of the absolute value, like GNU MP does */
+#define WSVAR_GET_UI(v) \
+    ((v) < 0 ? 0U - (unsigned int) (v) : (unsigned int) (v))
+#define WSVAR_GET_SI(v) ((long) (v))
+#define WSVAR_FITS_SI(v) ((v) >= LONG_MIN && (v) <= LONG_MAX)
+#define WSVAR_SET_SI(dest,v) (dest) = (NUM_TYPE) (v)
+#define WSVAR_PRINTF(v) num_print(v)
+#define WSVAR_CMP_ZERO(v) (((v) > 0) - ((v) < 0))
+#define WSVAR_CMP(a,b) (((a) > (b)) - ((a) < (b)))
+
+/* add, sub and mul are done unsigned, to wrap around well-defined. So
+ * are the divisions by -1, which would trap on the smallest number.
+ */
+#define WSVAR_ASSIGN(dest,src) (dest) = (src)
+#define WSVAR_SWAP(a,b) \
+    do { \
+        NUM_TYPE swap_tmp = (a); \
+        (a) = (b); \
+        (b) = swap_tmp; \
+    } while(0)
+#define WSVAR_ADD(dest,s1,s2) \
+    (dest) = (NUM_TYPE) ((NUM_UTYPE) (s1) + (NUM_UTYPE) (s2))
+#define WSVAR_SUB(dest,s1,s2) \
+    (dest) = (NUM_TYPE) ((NUM_UTYPE) (s1) - (NUM_UTYPE) (s2))
+#define WSVAR_MUL(dest,s1,s2) \
+    (dest) = (NUM_TYPE) ((NUM_UTYPE) (s1) * (NUM_UTYPE) (s2))
+#define WSVAR_DIV(dest,s1,s2) \
+    (dest) = (s2) == -1 ? (NUM_TYPE) (0 - (NUM_UTYPE) (s1)) : (s1) / (s2)
+#define WSVAR_MOD(dest,s1,s2) \
+    (dest) = (s2) == -1 ? 0 : (s1) % (s2)
+#define WSVAR_MUL_2EXP(dest,src,k) \
+    (dest) = (NUM_TYPE) ((NUM_UTYPE) (src) << (k))
+#define WSVAR_DIV_2EXP(dest,src,k) \
+    (dest) = (src) < 0 \
+        ? -(NUM_TYPE) ((0 - (NUM_UTYPE) (src)) >> (k)) \
+        : (NUM_TYPE) ((NUM_UTYPE) (src) >> (k))
+#define WSVAR_MOD_2EXP(dest,src,k) \
+    (dest) = (src) < 0 \
+        ? -(NUM_TYPE) ((0 - (NUM_UTYPE) (src)) & (((NUM_UTYPE) 1 << (k)) - 1)) \
+        : (NUM_TYPE) ((NUM_UTYPE) (src) & (((NUM_UTYPE) 1 << (k)) - 1))
+
+/* access n-th item from the top of the native stack, TOP(0) is the top */
+#define TOP(n) exec_stack[exec_stack_len - 1 - (n)]
+
+#define ENGINE_RUN num_run
+#define ENGINE_TYPE NUM_TYPE
+#define ENGINE_LITERALS() num_lit_load()
+#include "engine_run.h"
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
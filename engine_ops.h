@@ -0,0 +1,315 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_ops.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * instruction handlers of the execution engine
+ */
+
+/* this file is no ordinary header, it's included by engine.c into the
+ * body of engine_run and engine_step, since both need exactly the same
+ * handlers, but dispatch differently. The includer has to define:
+ *
+ *   CASE(op)   label (or case) of the handler for op
+ *   DEFAULT    label (or case) of the syntax error handler
+ *   NEXT()     continue with the instruction at ip->next
+ *   JUMP(t)    continue with the instruction at index t
+ *   STOP(s)    stop executing with interprt_do_stat s
+ *   CHECK(c)   c, if the handlers have to check for stack underflows,
+ *              0 otherwise (see verify.c)
+ *   RESERVE(n) make room for n more items on exec_stack (if necessary)
+ *   DECODED(s,f) get the instructions ready, decode_block has turned
+ *              stub s into or has appended from index f on
+ *
+ * and UNCHECKED, if it includes the handlers a second time without the
+ * checks.
+ *
+ * the handlers work on `ip' (pointer to the current instruction) and
+ * may use `address' as a scratch variable.
+ */
+
+CASE(OP_PUSH):
+    RESERVE(1);
+    WSVAR_ASSIGN(exec_stack[exec_stack_len], insn_lit[ip->arg]);
+    exec_stack_len ++;
+    NEXT();
+
+CASE(OP_DUP):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    RESERVE(1);
+    WSVAR_ASSIGN(exec_stack[exec_stack_len], TOP(0));
+    exec_stack_len ++;
+    NEXT();
+
+CASE(OP_COPY):
+    if(CHECK(ip->arg >= exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    RESERVE(1);
+    WSVAR_ASSIGN(exec_stack[exec_stack_len], TOP(ip->arg));
+    exec_stack_len ++;
+    NEXT();
+
+CASE(OP_SWAP):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_SWAP(TOP(0), TOP(1));
+    NEXT();
+
+CASE(OP_DISCARD):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_SLIDE):
+    /* move the top item down, the discarded ones are above */
+    if(CHECK(ip->arg >= exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_SWAP(TOP(0), TOP(ip->arg));
+    exec_stack_len -= ip->arg;
+    NEXT();
+
+CASE(OP_ADD):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_ADD(TOP(1), TOP(1), TOP(0));
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_SUB):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_SUB(TOP(1), TOP(1), TOP(0));
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_MUL):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_MUL(TOP(1), TOP(1), TOP(0));
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_DIV):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_DIV(TOP(1), TOP(1), TOP(0));
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_MOD):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+    WSVAR_MOD(TOP(1), TOP(1), TOP(0));
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_STORE):
+    if(CHECK(exec_stack_len < 2)) STOP(DO_STACK_UNDERFLOW);
+
+    address = WSVAR_GET_SI(TOP(1));
+
+    /* the item is popped anyway, so move it instead of copying */
+    exec_heap_move(address, TOP(0));
+    if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+    exec_stack_len -= 2;
+    NEXT();
+
+CASE(OP_RETRIEVE):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    address = WSVAR_GET_SI(TOP(0));
+    exec_heap_read(address, TOP(0));
+    if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+    NEXT();
+
+CASE(OP_LABEL):
+    NEXT();
+
+CASE(OP_CALL):
+    exec_bt_push(ip->next);
+    JUMP(ip->arg);
+
+CASE(OP_JUMP):
+    JUMP(ip->arg);
+
+CASE(OP_JZ):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    /* don't decrement within WSVAR_CMP_ZERO, it's a macro */
+    exec_stack_len --;
+    if(! WSVAR_CMP_ZERO(exec_stack[exec_stack_len]))
+        JUMP(ip->arg);
+    NEXT();
+
+CASE(OP_JN):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    exec_stack_len --;
+    if(WSVAR_CMP_ZERO(exec_stack[exec_stack_len]) < 0)
+        JUMP(ip->arg);
+    NEXT();
+
+CASE(OP_RET):
+    if(! exec_bt_len) STOP(DO_STACK_UNDERFLOW);
+    JUMP(exec_bt_pop());
+
+CASE(OP_EXIT):
+    STOP(DO_EXIT);
+
+CASE(OP_PRINTC):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+    exec_stack_len --;
+    putchar((int)WSVAR_GET_UI(exec_stack[exec_stack_len]) & 0xff);
+    NEXT();
+
+CASE(OP_PRINTN):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+    exec_stack_len --;
+    WSVAR_PRINTF(exec_stack[exec_stack_len]);
+    NEXT();
+
+CASE(OP_READC):
+CASE(OP_READN):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    address = WSVAR_GET_SI(TOP(0));
+    interprt_input(exec_heap_cell(address), ip->op == OP_READN);
+    if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+    exec_stack_len --;
+    NEXT();
+
+/* superinstructions. If they run into a stack underflow, they have to
+ * leave the stack just like the plain instruction sequence would have
+ * done, and stop at the instruction that actually failed. The plain
+ * instructions are still there, right behind the superinstruction.
+ */
+CASE(OP_PUSH_ADD):
+    if(CHECK(! exec_stack_len)) goto push_and_underflow;
+    WSVAR_ADD(TOP(0), TOP(0), insn_lit[ip->arg]);
+    NEXT();
+
+CASE(OP_PUSH_SUB):
+    if(CHECK(! exec_stack_len)) goto push_and_underflow;
+    WSVAR_SUB(TOP(0), TOP(0), insn_lit[ip->arg]);
+    NEXT();
+
+CASE(OP_PUSH_RETRIEVE):
+    RESERVE(1);
+    exec_heap_read((int) ip->arg2, exec_stack[exec_stack_len]);
+    if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+    exec_stack_len ++;
+    NEXT();
+
+CASE(OP_PUSH_SWAP_STORE):
+    if(CHECK(! exec_stack_len)) goto push_and_underflow;
+
+    exec_heap_move((int) ip->arg2, TOP(0));
+    if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+    exec_stack_len --;
+    NEXT();
+
+CASE(OP_DUP_JZ):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+    if(! WSVAR_CMP_ZERO(TOP(0))) JUMP(ip->arg);
+    NEXT();
+
+CASE(OP_DUP_JN):
+    if(CHECK(! exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+    if(WSVAR_CMP_ZERO(TOP(0)) < 0) JUMP(ip->arg);
+    NEXT();
+
+CASE(OP_COPY_PUSH_SUB):
+    if(CHECK(ip->arg >= exec_stack_len)) STOP(DO_STACK_UNDERFLOW);
+
+    RESERVE(1);
+    WSVAR_SUB(exec_stack[exec_stack_len], TOP(ip->arg), insn_lit[ip->arg2]);
+    exec_stack_len ++;
+    NEXT();
+
+CASE(OP_PUSH_SUB_JZ):
+    if(CHECK(! exec_stack_len)) {
+        /* as above, but the literal is in arg2 */
+        exec_stack_require(1);
+        WSVAR_ASSIGN(exec_stack[exec_stack_len], insn_lit[ip->arg2]);
+        exec_stack_len ++;
+        ip ++;
+        STOP(DO_STACK_UNDERFLOW);
+    }
+
+    exec_stack_len --;
+    if(! WSVAR_CMP(exec_stack[exec_stack_len], insn_lit[ip->arg2]))
+        JUMP(ip->arg);
+    NEXT();
+
+CASE(OP_TAIL_CALL):
+    /* the ret behind us would return to our caller, so can the callee.
+     * Without a caller, the ret has to fail, i.e. we really call.
+     */
+    if(! exec_bt_len) exec_bt_push(ip->next);
+    JUMP(ip->arg);
+
+CASE(OP_JUMP_RET):
+    /* without a caller, leave the failure to the ret */
+    if(! exec_bt_len) JUMP(ip->arg);
+    JUMP(exec_bt_pop());
+
+CASE(OP_SHL):
+    if(CHECK(! exec_stack_len)) goto push_and_underflow;
+    WSVAR_MUL_2EXP(TOP(0), TOP(0), ip->arg2);
+    NEXT();
+
+CASE(OP_DIV_POW2):
+    if(CHECK(! exec_stack_len)) goto push_and_underflow;
+    WSVAR_DIV_2EXP(TOP(0), TOP(0), ip->arg2);
+    NEXT();
+
+CASE(OP_MOD_POW2):
+    if(CHECK(! exec_stack_len)) goto push_and_underflow;
+    WSVAR_MOD_2EXP(TOP(0), TOP(0), ip->arg2);
+    NEXT();
+
+#ifndef UNCHECKED
+push_and_underflow:
+    /* the push of a push; ... superinstruction works, but the following
+     * instruction fails
+     */
+    exec_stack_require(1);
+    WSVAR_ASSIGN(exec_stack[exec_stack_len], insn_lit[ip->arg]);
+    exec_stack_len ++;
+    ip ++;
+    STOP(DO_STACK_UNDERFLOW);
+#endif
+
+CASE(OP_NO_LABEL):
+    STOP(DO_LABEL_NOT_FOUND);
+
+CASE(OP_END):
+    STOP(DO_END_NOT_EXPECTED);
+
+CASE(OP_MEMO_RET):
+    JUMP(engine_memo_return());
+
+CASE(OP_DECODE):
+    /* we've got to a block of a lazily decoded program, that isn't yet.
+     * Mind decode_block may move insn.
+     */
+    address = insn_len;
+    {
+        unsigned int stub = ip - insn, first = decode_block(stub);
+
+        DECODED(stub, (unsigned int) address);
+        JUMP(first);
+    }
+
+DEFAULT: /* OP_SYNTAX_ERROR */
+    STOP(DO_SYNTAX_ERROR);
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
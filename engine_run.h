@@ -0,0 +1,313 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * engine_run.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * run function of the execution engine
+ */
+
+/* this file is no ordinary header either, it's included by engine.c and
+ * engine_num.h to define the run function of the engine, once for every
+ * numeric type. The includer has to define:
+ *
+ *   ENGINE_RUN  the name of the function
+ *   TOP(n)      the n-th item from the top of exec_stack
+ *   ENGINE_TYPE the type of the items and heap cells
+ *   ENGINE_LITERALS()  catch up with the literals, decode_block has added
+ *               to insn_lit (if the engine keeps a copy of its own)
+ *
+ * as well as the WSVAR_ macros, exec_stack, exec_heap and insn_lit, that
+ * engine_ops.h works on.
+ */
+
+/* dispatching the instructions. If we've got gcc (or a compiler, that
+ * understands it's labels-as-values extension), every instruction carries
+ * the address of its handler, and each handler jumps directly to the
+ * handler of the next instruction (direct threading). Otherwise fall back
+ * to a plain switch within a loop.
+ *
+ * Define ENGINE_NO_THREADING (configure --disable-threading) to get the
+ * switch variant on gcc as well.
+ */
+#if defined(__GNUC__) && !defined(ENGINE_NO_THREADING)
+#  define ENGINE_THREADED 1
+#endif
+
+/* table of the handler addresses, labels are prefixed by p */
+#define ENGINE_TABLE(p) { \
+        [OP_PUSH] = &&p##OP_PUSH, \
+        [OP_DUP] = &&p##OP_DUP, \
+        [OP_COPY] = &&p##OP_COPY, \
+        [OP_SWAP] = &&p##OP_SWAP, \
+        [OP_DISCARD] = &&p##OP_DISCARD, \
+        [OP_SLIDE] = &&p##OP_SLIDE, \
+        [OP_ADD] = &&p##OP_ADD, \
+        [OP_SUB] = &&p##OP_SUB, \
+        [OP_MUL] = &&p##OP_MUL, \
+        [OP_DIV] = &&p##OP_DIV, \
+        [OP_MOD] = &&p##OP_MOD, \
+        [OP_STORE] = &&p##OP_STORE, \
+        [OP_RETRIEVE] = &&p##OP_RETRIEVE, \
+        [OP_LABEL] = &&p##OP_LABEL, \
+        [OP_CALL] = &&p##OP_CALL, \
+        [OP_JUMP] = &&p##OP_JUMP, \
+        [OP_JZ] = &&p##OP_JZ, \
+        [OP_JN] = &&p##OP_JN, \
+        [OP_RET] = &&p##OP_RET, \
+        [OP_EXIT] = &&p##OP_EXIT, \
+        [OP_PRINTC] = &&p##OP_PRINTC, \
+        [OP_PRINTN] = &&p##OP_PRINTN, \
+        [OP_READC] = &&p##OP_READC, \
+        [OP_READN] = &&p##OP_READN, \
+        [OP_PUSH_ADD] = &&p##OP_PUSH_ADD, \
+        [OP_PUSH_SUB] = &&p##OP_PUSH_SUB, \
+        [OP_PUSH_RETRIEVE] = &&p##OP_PUSH_RETRIEVE, \
+        [OP_PUSH_SWAP_STORE] = &&p##OP_PUSH_SWAP_STORE, \
+        [OP_DUP_JZ] = &&p##OP_DUP_JZ, \
+        [OP_DUP_JN] = &&p##OP_DUP_JN, \
+        [OP_COPY_PUSH_SUB] = &&p##OP_COPY_PUSH_SUB, \
+        [OP_PUSH_SUB_JZ] = &&p##OP_PUSH_SUB_JZ, \
+        [OP_TAIL_CALL] = &&p##OP_TAIL_CALL, \
+        [OP_JUMP_RET] = &&p##OP_JUMP_RET, \
+        [OP_SHL] = &&p##OP_SHL, \
+        [OP_DIV_POW2] = &&p##OP_DIV_POW2, \
+        [OP_MOD_POW2] = &&p##OP_MOD_POW2, \
+        [OP_NOP] = &&p##DEFAULT, \
+        [OP_SYNTAX_ERROR] = &&p##DEFAULT, \
+        [OP_NO_LABEL] = &&p##OP_NO_LABEL, \
+        [OP_END] = &&p##OP_END, \
+        [OP_MEMO_RET] = &&p##OP_MEMO_RET, \
+        [OP_DECODE] = &&p##OP_DECODE \
+    }
+
+#include "engine_idiom.h"
+#include "engine_memo.h"
+
+/* leave the handler, stat is returned to the caller */
+#define STOP(s)             { stat = (s); goto stop; }
+
+
+
+/* interprt_do_stat ENGINE_RUN(void)
+ *
+ * run the decoded program till it stops
+ */
+interprt_do_stat ENGINE_RUN(void)
+{
+    const insn_t *ip;
+    interprt_do_stat stat;
+    long address;
+
+#ifdef ENGINE_THREADED
+#  define CASE(op)          L_##op
+#  define DEFAULT           L_DEFAULT
+#  define DISPATCH()        goto *ip->dispatch
+
+    static const void *const handlers[OP_LAST] = ENGINE_TABLE(L_);
+    static const void *const guarded[OP_LAST] = ENGINE_TABLE(G_);
+    static const void *const unchecked[OP_LAST] = ENGINE_TABLE(U_);
+    unsigned int i;
+#endif
+
+    /* verify the blocks (where they're run without counting every single
+     * instruction) and look for the subroutines and loops to shortcut
+     */
+    if(! decode_lazy) {
+#ifdef ENGINE_THREADED
+        if(! engine_counts) verify_program();
+#endif
+        if(engine_memoize) memo_program();
+        if(engine_idioms) idiom_program();
+#ifdef ENGINE_THREADED
+        if(! engine_counts) {
+#  ifdef NATIVE_REGIONS
+            native_program();
+#  endif
+#  ifdef REGVM_BLOCKS
+            if(engine_registers) regvm_program();
+#  endif
+        }
+#endif
+    }
+
+#ifdef ENGINE_THREADED
+    /* thread the code, i.e. tell every instruction where its handler is.
+     * Verified blocks are entered through the guarded handler of their
+     * first instruction, which continues with the unchecked handlers.
+     * If we need to count, direct all of them to the counter first.
+     */
+    for(i = 0; i < insn_len; i ++) {
+        insn_t *in = &insn[i];
+        assert(handlers[in->op]);
+
+        if(in->block == BLOCK_LEADER)
+            in->dispatch = in->fast = guarded[in->op];
+
+        else if(in->block == BLOCK_NATIVE)
+            in->dispatch = in->fast = &&L_NATIVE;
+
+        else if(in->block == BLOCK_REGVM)
+            in->dispatch = in->fast = &&L_REGVM;
+
+        else if(in->block == BLOCK_IDIOM)
+            in->dispatch = in->fast = &&L_IDIOM;
+
+        else if(in->block == BLOCK_MEMO)
+            in->dispatch = in->fast = &&L_MEMO;
+
+        else {
+            in->dispatch = in->fast = handlers[in->op];
+
+            if(in->block == BLOCK_BODY)
+                in->fast = unchecked[in->op];
+        }
+
+        /* there are no verified blocks then, fast is where to go on */
+        if(engine_counts)
+            in->dispatch = &&L_COUNT;
+    }
+
+    /* thread the instructions decode_block has turned the stub into, or
+     * has appended
+     */
+#  define DECODED(stub,from) \
+    do { \
+        insn[stub].dispatch = insn[stub].fast = handlers[insn[stub].op]; \
+        for(i = (from); i < insn_len; i ++) \
+            insn[i].dispatch = insn[i].fast = handlers[insn[i].op]; \
+        ENGINE_LITERALS(); \
+    } while(0)
+#else
+#  define CASE(op)          case op
+#  define DEFAULT           default
+#  define DISPATCH()        continue
+#  define DECODED(stub,from) ENGINE_LITERALS()
+#endif
+
+#define NEXT()              { ip = &insn[ip->next]; DISPATCH(); }
+#define JUMP(t)             { ip = &insn[t]; DISPATCH(); }
+#define CHECK(c)            (c)
+#define RESERVE(n)          exec_stack_require(n)
+
+    ip = &insn[exec_bt_pop()];
+
+#ifdef ENGINE_THREADED
+    DISPATCH();
+    {
+L_COUNT:
+        engine_counts[ip - insn] ++;
+        goto *ip->fast;
+
+L_NATIVE:
+#ifdef NATIVE_REGIONS
+        {
+            int deopt;
+
+            ip = native_run(ip, &deopt);
+            if(deopt) goto *handlers[ip->op];
+        }
+        DISPATCH();
+#endif
+
+L_REGVM:
+#ifdef REGVM_BLOCKS
+        {
+            int deopt;
+
+            ip = regvm_run(ip, &deopt);
+            if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+            if(deopt) goto *handlers[ip->op];
+        }
+        DISPATCH();
+#endif
+
+L_IDIOM:
+        /* run as many iterations as we can in bulk, the rest of the loop
+         * goes on as usual (on the guarded handler, if it's been a block)
+         */
+        engine_idiom(ip);
+        if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+        if(idiom_table[ip - insn].leader) goto *guarded[ip->op];
+        goto *handlers[ip->op];
+
+L_MEMO:
+        /* return right away, if we know the result */
+        if(engine_memo(ip)) JUMP(exec_bt_pop());
+        if(memo_table[ip - insn].leader) goto *guarded[ip->op];
+        goto *handlers[ip->op];
+
+#else
+    for(;;) {
+        if(engine_counts) engine_counts[ip - insn] ++;
+
+        /* like L_IDIOM and L_MEMO do */
+        if(ip->block == BLOCK_IDIOM) {
+            engine_idiom(ip);
+            if(exec_heap_failed()) STOP(DO_HEAP_FULL);
+        }
+        else if(ip->block == BLOCK_MEMO && engine_memo(ip))
+            JUMP(exec_bt_pop());
+
+        switch(ip->op) {
+#endif
+#include "engine_ops.h"
+
+#ifdef ENGINE_THREADED
+        /* the same handlers once more, for verified blocks. Entering one
+         * through G_<op> checks, whether there are enough items on the
+         * stack for the whole block, the instructions themselves don't.
+         */
+#  undef CASE
+#  undef DEFAULT
+#  undef NEXT
+#  undef CHECK
+#  undef RESERVE
+#  define CASE(op)          G_##op: \
+                            if(exec_stack_len < ip->need) goto L_##op; \
+                            exec_stack_require(ip->grow); \
+                            U_##op
+#  define DEFAULT           G_DEFAULT: U_DEFAULT
+#  define NEXT()            { ip = &insn[ip->next]; goto *ip->fast; }
+#  define CHECK(c)          0
+#  define RESERVE(n)
+#  define UNCHECKED
+
+#include "engine_ops.h"
+
+#  undef UNCHECKED
+#endif
+    }
+#ifndef ENGINE_THREADED
+    }
+#endif
+
+stop:
+    interprt_running = 0;
+    exec_bt_push(ip - insn);
+    return stat;
+
+#undef CASE
+#undef DEFAULT
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef CHECK
+#undef RESERVE
+#undef DECODED
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -16,6 +16,7 @@
 
 #include "fileio.h"
 #include "storage.h"
+#include "interprt.h"
 
 #ifdef __USE_POSIX
 #  include <fcntl.h>
@@ -23,12 +24,32 @@
 
    /* permissions to assign to new files */
 #  define PERM (S_IRUSR | S_IRGRP | S_IROTH | S_IWUSR)
+
+#  ifdef HAVE_SYS_MMAN_H
+#    include <sys/mman.h>
+#  endif
 #endif
 
 /* check whether char (a) is a whitespace command character */
 #define iswschar(a) (((a) == '\t') || ((a) == '\n') || ((a) == ' '))
 
+/* bytes read at once, when loading a file lazily */
+#define LOAD_CHUNK 65536
+
+/* bytes converted at once, when loading or writing the heap */
+#define HEAP_CHUNK 65536
+
 static int compose_cmd_is_complete(void);
+static void parse_chunk(const unsigned char *buf, int len);
+static long heap_cells_load(const unsigned char *buf, size_t len,
+                            long address, int width);
+
+/* the file, load_file_lazy has opened, NULL (or -1) once it's loaded */
+#ifdef __USE_POSIX
+static int load_fd = -1;
+#else
+static FILE *load_hdl = NULL;
+#endif
 
 #ifdef __USE_POSIX
 /* int parse_file(const int fd)
@@ -40,24 +61,15 @@ static int compose_cmd_is_complete(void);
 int parse_file(const int fd) 
 {
     unsigned char buf[512];
-    int len, pos;
+    int len;
     
     if(fd < 0) return -1; /* file descriptor not valid */
 
     wsdata_reset();
     compose_reset(); 
 
-    while((len = read(fd, buf, sizeof(buf))) > 0) {
-        for(pos = 0; pos < len; pos ++) {
-            if(! iswschar(buf[pos])) continue; /* ignore non-ws characters */
-
-            compose_require(1);
-            compose_push(buf[pos]);
-        
-            if(compose_cmd_is_complete())
-                compose_append_to_wsdata();
-        }
-    }
+    while((len = read(fd, buf, sizeof(buf))) > 0)
+        parse_chunk(buf, len);
 
     return -(len<0); /* return -1 if read() failed, 0 otherwise */
 }
@@ -86,7 +98,7 @@ int load_file(const char *fname)
 #else 
 
     unsigned char buf[512];
-    int len, pos;
+    int len;
     
     FILE *hdl = fopen(fname, "rb");
     if(! hdl) return -1;
@@ -94,17 +106,8 @@ int load_file(const char *fname)
     wsdata_reset();
     compose_reset(); 
 
-    while((len = fread(buf, 1, sizeof(buf), hdl)) > 0) {
-        for(pos = 0; pos < len; pos ++) {
-            if(! iswschar(buf[pos])) continue; /* ignore non-ws characters */
-
-            compose_require(1);
-            compose_push(buf[pos]);
-        
-            if(compose_cmd_is_complete())
-                compose_append_to_wsdata();
-        }
-    }
+    while((len = fread(buf, 1, sizeof(buf), hdl)) > 0)
+        parse_chunk(buf, len);
 
     fclose(hdl);
     return -(len<0); /* return -1 if fread() failed, 0 otherwise */
@@ -112,6 +115,69 @@ int load_file(const char *fname)
 }
 
 
+/* int load_file_lazy(const char *fname)
+ *
+ * open the file, but don't read it yet. wsdata is empty, until
+ * load_file_more is called.
+ *
+ * RETURN: -1 on failure.
+ */
+int load_file_lazy(const char *fname)
+{
+    wsdata_reset();
+    compose_reset(); 
+
+#ifdef __USE_POSIX
+    if(load_fd >= 0) close(load_fd);
+    load_fd = open(fname, O_RDONLY);
+    return load_fd < 0 ? -1 : 0;
+#else
+    if(load_hdl) fclose(load_hdl);
+    load_hdl = fopen(fname, "rb");
+    return load_hdl ? 0 : -1;
+#endif
+}
+
+
+
+/* int load_file_more(void)
+ *
+ * append the commands of the next chunk of the file, load_file_lazy has
+ * opened, to the wsdata stack. The chunk may end within a command, i.e.
+ * there may be no new ones.
+ *
+ * RETURN: 1 if there was another chunk, 0 at the end of the file (or if
+ *         reading failed), the file's closed then.
+ */
+int load_file_more(void)
+{
+    unsigned char buf[LOAD_CHUNK];
+    int len;
+
+#ifdef __USE_POSIX
+    if(load_fd < 0) return 0;
+
+    if((len = read(load_fd, buf, sizeof(buf))) <= 0) {
+        close(load_fd);
+        load_fd = -1;
+        return 0;
+    }
+#else
+    if(! load_hdl) return 0;
+
+    if((len = fread(buf, 1, sizeof(buf), load_hdl)) <= 0) {
+        fclose(load_hdl);
+        load_hdl = NULL;
+        return 0;
+    }
+#endif
+
+    parse_chunk(buf, len);
+    return 1;
+}
+
+
+
 /* int write_file(const char *fname)
  *
  * write whole wsdata stack to file (with provided name)
@@ -182,6 +248,199 @@ int write_file_fd(const int fd)
 
 
 
+/* int load_heap(const char *fname, long address, int width)
+ *
+ * store the file's content to the heap cells from address on, width
+ * bytes per cell: an unsigned byte each, if width is 1, a signed little
+ * endian integer otherwise. A partial cell at the end of the file is
+ * padded with zero bytes.
+ *
+ * RETURN: -1 on failure (as well as if the heap cannot grow).
+ */
+int load_heap(const char *fname, long address, int width)
+{
+#ifdef __USE_POSIX
+    int fd = open(fname, O_RDONLY);
+    unsigned char buf[HEAP_CHUNK];
+    size_t len, want = sizeof(buf) / width * width;
+    ssize_t got = 1;
+
+    if(fd < 0) return -1;
+
+#  ifdef HAVE_SYS_MMAN_H
+    {
+        struct stat st;
+        void *data;
+
+        /* map it as a whole, if we can, and convert it right from there */
+        if(! fstat(fd, &st) && st.st_size > 0
+           && (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+              != MAP_FAILED) {
+            heap_cells_load(data, st.st_size, address, width);
+            munmap(data, st.st_size);
+            return close(fd) < 0 || exec_heap_failed() ? -1 : 0;
+        }
+    }
+#  endif
+
+    /* the chunks are multiples of width, but for the last one, so
+     * read on till a chunk's full (pipes may return less)
+     */
+    while(got > 0) {
+        for(len = 0; len < want; len += got)
+            if((got = read(fd, buf + len, want - len)) <= 0) break;
+
+        if(len) address = heap_cells_load(buf, len, address, width);
+    }
+
+    return close(fd) < 0 || got < 0 || exec_heap_failed() ? -1 : 0;
+
+#else
+
+    unsigned char buf[HEAP_CHUNK];
+    size_t len;
+
+    FILE *hdl = fopen(fname, "rb");
+    if(! hdl) return -1;
+
+    while((len = fread(buf, 1, sizeof(buf) / width * width, hdl)) > 0)
+        address = heap_cells_load(buf, len, address, width);
+
+    len = ferror(hdl);
+    fclose(hdl);
+    return len || exec_heap_failed() ? -1 : 0;
+#endif
+}
+
+
+
+/* int write_heap(const char *fname, long address, unsigned long count,
+ *                int width)
+ *
+ * write count heap cells, starting at address, to the file, width bytes
+ * per cell, like load_heap reads them (i.e. cut down to width bytes)
+ *
+ * RETURN: -1 on failure.
+ */
+int write_heap(const char *fname, long address, unsigned long count,
+               int width)
+{
+    unsigned char buf[HEAP_CHUNK];
+    unsigned long value;
+    size_t len;
+    int i;
+
+#ifdef __USE_POSIX
+    int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, PERM);
+    if(fd < 0) return -1;
+#else
+    FILE *hdl = fopen(fname, "wb");
+    if(! hdl) return -1;
+#endif
+
+    while(count) {
+        for(len = 0; count && len + width <= sizeof(buf); count --) {
+            value = (unsigned long) WSVAR_GET_SI(*exec_heap_cell(address));
+            address ++;
+
+            for(i = 0; i < width; i ++, value >>= 8)
+                buf[len ++] = value & 0xff;
+        }
+
+#ifdef __USE_POSIX
+        if(write(fd, buf, len) != (ssize_t) len) {
+            close(fd);
+            return -1;
+        }
+#else
+        if(fwrite(buf, 1, len, hdl) != len) {
+            fclose(hdl);
+            return -1;
+        }
+#endif
+    }
+
+#ifdef __USE_POSIX
+    return close(fd) < 0 ? -1 : 0;
+#else
+    return fclose(hdl) ? -1 : 0;
+#endif
+}
+
+
+
+/* long heap_cells_load(const unsigned char *buf, size_t len, long address,
+ *                      int width)
+ *
+ * store the cells in buf to the heap, from address on (see load_heap).
+ * The heap's page is looked up once per page, not per cell.
+ *
+ * RETURN: the address behind the last cell stored
+ */
+static long heap_cells_load(const unsigned char *buf, size_t len,
+                            long address, int width)
+{
+    const unsigned char *end = buf + len;
+    unsigned long value;
+    WSVAR_TYPE *cell;
+    size_t run;
+    int i;
+
+    while(buf < end) {
+        cell = exec_heap_cell(address);
+        run = PAGE_CELLS - ((unsigned long) address & (PAGE_CELLS - 1));
+
+        if(width == 1) {
+            if(run > (size_t) (end - buf)) run = end - buf;
+
+            for(i = 0; i < (int) run; i ++)
+                WSVAR_SET_SI(cell[i], buf[i]);
+
+            buf += run;
+            address += run;
+            continue;
+        }
+
+        for(; run && buf < end; run --, cell ++, address ++) {
+            /* little endian, zero padded at the end, sign extended */
+            for(value = 0, i = width - 1; i >= 0; i --)
+                value = (value << 8) | (buf + i < end ? buf[i] : 0);
+
+            if(width < (int) sizeof(long) && (value >> (8 * width - 1)) & 1)
+                value |= ~0UL << (8 * width);
+
+            WSVAR_SET_SI(*cell, (long) value);
+            buf += width;
+        }
+    }
+
+    return address;
+}
+
+
+
+/* void parse_chunk(const unsigned char *buf, int len)
+ *
+ * append the commands in buf to the wsdata stack, the bytes of a command,
+ * that isn't complete yet, are kept on the compose stack.
+ */
+static void parse_chunk(const unsigned char *buf, int len)
+{
+    int pos;
+
+    for(pos = 0; pos < len; pos ++) {
+        if(! iswschar(buf[pos])) continue; /* ignore non-ws characters */
+
+        compose_require(1);
+        compose_push(buf[pos]);
+    
+        if(compose_cmd_is_complete())
+            compose_append_to_wsdata();
+    }
+}
+
+
+
 /* int compose_cmd_is_complete(void)
  *
  * check whether we've got a complete command in compose buffer, or whether
@@ -28,6 +28,17 @@ int write_file_fd(const int fd);
 int load_file(const char *fname);
 int write_file(const char *fname);
 
+/* load the file piece by piece, on demand (see decode_program_lazy) */
+int load_file_lazy(const char *fname);
+int load_file_more(void);
+
+/* functions to fill exec_heap's cells from files (and write them out),
+ * width bytes per cell
+ */
+int load_heap(const char *fname, long address, int width);
+int write_heap(const char *fname, long address, unsigned long count,
+               int width);
+
 #endif
 
 
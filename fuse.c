@@ -0,0 +1,284 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * fuse.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * fusion of common instruction sequences into superinstructions
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fuse.h"
+#include "engine.h"
+
+/* the sequences we know to fuse. If more than one matches, the first
+ * one wins, so keep the longer ones first.
+ */
+static const struct {
+    insn_op fused;
+    const char *name;
+    unsigned int len;
+    insn_op seq[3];
+} fuse_patterns[] = {
+    { OP_PUSH_SUB_JZ, "push; sub; jz", 3, { OP_PUSH, OP_SUB, OP_JZ } },
+    { OP_PUSH_SWAP_STORE, "push; swap; store", 3, { OP_PUSH, OP_SWAP, OP_STORE } },
+    { OP_COPY_PUSH_SUB, "copy; push; sub", 3, { OP_COPY, OP_PUSH, OP_SUB } },
+    { OP_PUSH_ADD, "push; add", 2, { OP_PUSH, OP_ADD } },
+    { OP_PUSH_SUB, "push; sub", 2, { OP_PUSH, OP_SUB } },
+    { OP_PUSH_RETRIEVE, "push; retrieve", 2, { OP_PUSH, OP_RETRIEVE } },
+    { OP_DUP_JZ, "dup; jz", 2, { OP_DUP, OP_JZ } },
+    { OP_DUP_JN, "dup; jn", 2, { OP_DUP, OP_JN } },
+
+    /* the ret needn't follow right away, see fuse_tails */
+    { OP_TAIL_CALL, "call; ret", 2, { OP_CALL, OP_RET } },
+    { OP_JUMP_RET, "jump; ret", 2, { OP_JUMP, OP_RET } }
+};
+
+#define FUSE_PATTERNS (sizeof(fuse_patterns) / sizeof(fuse_patterns[0]))
+
+/* whether the pattern is one of fuse_tails' */
+#define FUSE_TAIL(pattern) (fuse_patterns[pattern].seq[1] == OP_RET)
+
+/* number of places, each of the patterns was fused at */
+static unsigned int fuse_sites[FUSE_PATTERNS];
+
+static int fuse_match(unsigned int pos, unsigned int pattern,
+                      const unsigned char *entry);
+static unsigned int fuse_ret(unsigned int pos);
+
+
+
+/* unsigned int fuse_program(void)
+ *
+ * scan the decoded program for fusable sequences
+ *
+ * RETURN: number of superinstructions created
+ */
+unsigned int fuse_program(void)
+{
+    unsigned int pos = 0, pattern, fused = 0;
+    unsigned char *entry = decode_entries();
+    long address;
+
+    for(pattern = 0; pattern < FUSE_PATTERNS; pattern ++)
+        if(! FUSE_TAIL(pattern))
+            fuse_sites[pattern] = 0;
+
+    while(pos < insn_len) {
+        insn_t *in = &insn[pos];
+
+        for(pattern = 0; pattern < FUSE_PATTERNS; pattern ++)
+            if(fuse_match(pos, pattern, entry))
+                break;
+
+        if(pattern == FUSE_PATTERNS) {
+            pos ++;
+            continue;
+        }
+
+        switch(fuse_patterns[pattern].fused) {
+            case OP_PUSH_RETRIEVE:
+            case OP_PUSH_SWAP_STORE:
+                /* arg2 keeps the address as an int, leave the others be */
+                address = WSVAR_GET_SI(insn_lit[in->arg]);
+                if(address < INT_MIN || address > INT_MAX) {
+                    pos ++;
+                    continue;
+                }
+
+                in->arg2 = (unsigned int) address;
+                break;
+
+            case OP_DUP_JZ:
+            case OP_DUP_JN:
+                in->arg = in[1].arg;
+                break;
+
+            case OP_COPY_PUSH_SUB:
+                in->arg2 = in[1].arg;
+                break;
+
+            case OP_PUSH_SUB_JZ:
+                in->arg2 = in->arg;
+                in->arg = in[2].arg;
+                break;
+
+            default: /* push; add and push; sub keep their literal */
+                break;
+        }
+
+        in->op = fuse_patterns[pattern].fused;
+        in->next = in[fuse_patterns[pattern].len - 1].next;
+
+        fuse_sites[pattern] ++;
+        fused ++;
+        pos += fuse_patterns[pattern].len;
+    }
+
+    free(entry);
+    return fused;
+}
+
+
+
+/* unsigned int fuse_tails(void)
+ *
+ * turn calls and jumps, that end up at a ret, into OP_TAIL_CALL and
+ * OP_JUMP_RET
+ *
+ * RETURN: number of instructions replaced
+ */
+unsigned int fuse_tails(void)
+{
+    unsigned int pos, pattern, replaced = 0;
+
+    for(pattern = 0; pattern < FUSE_PATTERNS; pattern ++)
+        if(FUSE_TAIL(pattern))
+            fuse_sites[pattern] = 0;
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        insn_t *in = &insn[pos];
+        unsigned int ret;
+
+        for(pattern = 0; pattern < FUSE_PATTERNS; pattern ++)
+            if(FUSE_TAIL(pattern) && in->op == fuse_patterns[pattern].seq[0])
+                break;
+
+        if(pattern == FUSE_PATTERNS) continue;
+
+        /* the ret needn't follow right away, labels and jumps between
+         * are fine, the ret stays where it is
+         */
+        ret = fuse_ret(in->op == OP_JUMP ? in->arg : in->next);
+        if(ret == insn_len) continue;
+
+        if(in->op == OP_JUMP)
+            in->arg = ret;
+
+        in->op = fuse_patterns[pattern].fused;
+        fuse_sites[pattern] ++;
+        replaced ++;
+    }
+
+    return replaced;
+}
+
+
+
+/* int fuse_match(unsigned int pos, unsigned int pattern,
+ *                const unsigned char *entry)
+ *
+ * check whether the instructions at pos form the given pattern
+ *
+ * RETURN: 1 if so, 0 otherwise
+ */
+static int fuse_match(unsigned int pos, unsigned int pattern,
+                      const unsigned char *entry)
+{
+    unsigned int i, len = fuse_patterns[pattern].len;
+
+    /* those are up to fuse_tails */
+    if(FUSE_TAIL(pattern)) return 0;
+
+    if(pos + len > insn_len) return 0;
+
+    for(i = 0; i < len; i ++) {
+        if(insn[pos + i].op != fuse_patterns[pattern].seq[i])
+            return 0;
+
+        /* only the first instruction may be entered from elsewhere */
+        if(i && entry[pos + i])
+            return 0;
+    }
+
+    return 1;
+}
+
+
+
+/* unsigned int fuse_ret(unsigned int pos)
+ *
+ * follow labels and jumps starting at instruction pos
+ *
+ * RETURN: index of the ret we end up at, insn_len if there's none
+ */
+static unsigned int fuse_ret(unsigned int pos)
+{
+    unsigned int steps;
+
+    /* don't get caught by jumps, that loop */
+    for(steps = 0; pos < insn_len && steps < insn_len; steps ++)
+        switch(insn[pos].op) {
+            case OP_RET:
+                return pos;
+
+            case OP_LABEL:
+                pos = insn[pos].next;
+                break;
+
+            case OP_JUMP:
+            case OP_JUMP_RET:
+                pos = insn[pos].arg;
+                break;
+
+            default:
+                return insn_len;
+        }
+
+    return insn_len;
+}
+
+
+
+/* void fuse_stats(FILE *target)
+ *
+ * write out the fused sequences and how often they were executed
+ */
+void fuse_stats(FILE *target)
+{
+    unsigned int pattern, pos;
+    unsigned long total = 0, saved = 0;
+
+    fprintf(target, "superinstruction         sites      executed\n");
+
+    for(pattern = 0; pattern < FUSE_PATTERNS; pattern ++) {
+        unsigned long executed = 0;
+
+        if(engine_counts)
+            for(pos = 0; pos < insn_len; pos ++)
+                if(insn[pos].op == fuse_patterns[pattern].fused)
+                    executed += engine_counts[pos];
+
+        fprintf(target, "%-20s %9u %13lu\n", fuse_patterns[pattern].name,
+                fuse_sites[pattern], executed);
+
+        saved += executed * (fuse_patterns[pattern].len - 1);
+    }
+
+    if(! engine_counts) return;
+
+    for(pos = 0; pos < insn_len; pos ++)
+        total += engine_counts[pos];
+
+    fprintf(target, "%lu instructions dispatched, %lu saved by fusion.\n",
+            total, saved);
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
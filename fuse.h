@@ -0,0 +1,54 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * fuse.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * fusion of common instruction sequences into superinstructions
+ */
+
+#ifndef _FUSE_H
+#define _FUSE_H
+
+#include <stdio.h>
+#include "decode.h"
+
+
+
+/* prototypes *****************************************************************/
+unsigned int fuse_program(void);
+unsigned int fuse_tails(void);
+void fuse_stats(FILE *target);
+
+/* fuse_program replaces frequent instruction sequences of the decoded
+ * program by superinstructions (OP_PUSH_ADD etc.), it must be called
+ * right after decode_program. The replaced instructions are kept where
+ * they are (the superinstruction's next just skips them), therefore the
+ * engine can fall back to them if a superinstruction fails.
+ *
+ * fuse_tails turns calls and jumps ending up at a ret into OP_TAIL_CALL
+ * and OP_JUMP_RET, which leave the return stack alone (unless there's no
+ * caller, and the ret has to fail). It's independent of fuse_program,
+ * since without it, tail recursion eats up the return stack. Neither of
+ * them is meant for the debugger, which shows the real backtrace.
+ *
+ * fuse_stats writes out which sequences were fused and, if engine_counts
+ * was set up, how often they were executed.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
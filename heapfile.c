@@ -0,0 +1,218 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * heapfile.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * keeping exec_heap's pages in a memory mapped file
+ */
+
+#include "heapfile.h"
+
+#ifdef HEAPFILE_AVAILABLE
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MAP_NORESERVE
+#  define MAP_NORESERVE 0
+#endif
+
+/* the header and the index blocks are of HEAPFILE_BLOCK bytes, an index
+ * block holds the numbers of the HEAPFILE_GROUP pages behind it
+ */
+#define HEAPFILE_MAGIC "wsheap1\n"
+#define HEAPFILE_BLOCK 4096
+#define HEAPFILE_GROUP (HEAPFILE_BLOCK / sizeof(unsigned long))
+#define HEAPFILE_GROUP_SIZE \
+    (HEAPFILE_BLOCK + HEAPFILE_GROUP * (sizeof(WSVAR_TYPE) << PAGE_BITS))
+
+/* address space to map the file to, it may grow up to that size */
+#define HEAPFILE_RESERVE ((size_t) 1 << (sizeof(void *) > 4 ? 40 : 30))
+
+typedef struct {
+    char magic[8];
+    unsigned long cell_size;    /* sizeof(WSVAR_TYPE) */
+    unsigned long page_cells;   /* PAGE_CELLS */
+    unsigned long pages;        /* number of pages in the file */
+} heapfile_header_t;
+
+static int heapfile_fd = -1;
+static unsigned char *heapfile_map = NULL;
+static size_t heapfile_size = 0;    /* bytes in the file */
+
+/* the i-th page of the file and its number */
+#define HEAPFILE_GROUP_AT(i) \
+    (heapfile_map + HEAPFILE_BLOCK + (i) / HEAPFILE_GROUP * HEAPFILE_GROUP_SIZE)
+#define HEAPFILE_NUMBER(i) \
+    (((unsigned long *) HEAPFILE_GROUP_AT(i))[(i) % HEAPFILE_GROUP])
+#define HEAPFILE_PAGE(i) \
+    (HEAPFILE_GROUP_AT(i) + HEAPFILE_BLOCK \
+     + (i) % HEAPFILE_GROUP * (sizeof(WSVAR_TYPE) << PAGE_BITS))
+
+static void *heapfile_alloc(unsigned long number);
+
+
+
+/* int heapfile_open(const char *fname)
+ *
+ * map the file and put its pages into exec_heap, new ones are taken
+ * from it from now on
+ *
+ * RETURN: 0 on success, -1 on error (or if another run has it open)
+ */
+int heapfile_open(const char *fname)
+{
+    heapfile_header_t *header;
+    struct flock lock;
+    struct stat st;
+    unsigned long i;
+
+    assert(heapfile_fd < 0 && ! exec_heap.len);
+
+    if((heapfile_fd = open(fname, O_RDWR | O_CREAT, 0644)) < 0) return -1;
+
+    /* two runs appending pages at a time would mess up the index, the
+     * lock's gone once we close the file
+     */
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if(fcntl(heapfile_fd, F_SETLK, &lock)) goto fail;
+
+    if(fstat(heapfile_fd, &st)) goto fail;
+
+    /* a new one, put the header in */
+    if(! st.st_size) {
+        heapfile_header_t init;
+
+        memset(&init, 0, sizeof(init));
+        memcpy(init.magic, HEAPFILE_MAGIC, sizeof(init.magic));
+        init.cell_size = sizeof(WSVAR_TYPE);
+        init.page_cells = PAGE_CELLS;
+
+        if(ftruncate(heapfile_fd, HEAPFILE_BLOCK)
+           || pwrite(heapfile_fd, &init, sizeof(init), 0) != sizeof(init))
+            goto fail;
+
+        st.st_size = HEAPFILE_BLOCK;
+    }
+
+    if((size_t) st.st_size > HEAPFILE_RESERVE
+       || (size_t) st.st_size < HEAPFILE_BLOCK)
+        goto fail;
+
+    heapfile_size = st.st_size;
+    heapfile_map = mmap(NULL, HEAPFILE_RESERVE, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_NORESERVE, heapfile_fd, 0);
+    if(heapfile_map == MAP_FAILED) {
+        heapfile_map = NULL;
+        goto fail;
+    }
+
+    /* it has to be one of ours, of the same kind of cells, that's all
+     * there (i.e. we don't check the page numbers are unique)
+     */
+    header = (heapfile_header_t *) heapfile_map;
+    if(memcmp(header->magic, HEAPFILE_MAGIC, sizeof(header->magic))
+       || header->cell_size != sizeof(WSVAR_TYPE)
+       || header->page_cells != PAGE_CELLS
+       || (header->pages && (size_t) (HEAPFILE_PAGE(header->pages - 1)
+                                      - heapfile_map)
+                            + (sizeof(WSVAR_TYPE) << PAGE_BITS)
+                            > heapfile_size)) {
+        heapfile_close();
+        return -1;
+    }
+
+    for(i = 0; i < header->pages; i ++)
+        pagedir_insert(&exec_heap, HEAPFILE_NUMBER(i), HEAPFILE_PAGE(i));
+
+    exec_heap.alloc = heapfile_alloc;
+    return 0;
+
+ fail:
+    close(heapfile_fd);
+    heapfile_fd = -1;
+    return -1;
+}
+
+
+
+/* void heapfile_close(void)
+ *
+ * unmap and close the file, what's been written to the pages is in the
+ * file already
+ */
+void heapfile_close(void)
+{
+    if(heapfile_fd < 0) return;
+
+    exec_heap.alloc = NULL;
+
+    if(heapfile_map) munmap(heapfile_map, HEAPFILE_RESERVE);
+    heapfile_map = NULL;
+
+    close(heapfile_fd);
+    heapfile_fd = -1;
+}
+
+
+
+/* void *heapfile_alloc(unsigned long number)
+ *
+ * exec_heap's allocator, append a page to the file. The file's extended
+ * by a whole group of pages, once the group's first page is needed.
+ *
+ * RETURN: the page (zeroed), NULL if the file can't grow
+ */
+static void *heapfile_alloc(unsigned long number)
+{
+    heapfile_header_t *header = (heapfile_header_t *) heapfile_map;
+    unsigned long i = header->pages;
+    size_t end = HEAPFILE_GROUP_AT(i) - heapfile_map + HEAPFILE_GROUP_SIZE;
+
+    if(end > heapfile_size) {
+        if(end > HEAPFILE_RESERVE || ftruncate(heapfile_fd, end))
+            return NULL;
+
+        heapfile_size = end;
+    }
+
+    /* the number goes first, the page counts only once it's there */
+    HEAPFILE_NUMBER(i) = number;
+    header->pages = i + 1;
+
+    return HEAPFILE_PAGE(i);
+}
+
+#else /* ! HEAPFILE_AVAILABLE */
+
+int heapfile_open(const char *fname)
+{
+    (void) fname;
+    return -1;
+}
+
+void heapfile_close(void)
+{
+}
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
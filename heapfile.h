@@ -0,0 +1,60 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * heapfile.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * keeping exec_heap's pages in a memory mapped file
+ */
+
+#ifndef _HEAPFILE_H
+#define _HEAPFILE_H
+
+#include "interprt.h"
+
+/* the cells have to be plain numbers (no GNU MP ones, that point to
+ * memory of their own), and we need to map the file
+ */
+#if ! defined(HAVE_LIBGMP) && defined(HAVE_SYS_MMAN_H) \
+    && defined(HAVE_UNISTD_H) && defined(HAVE_FCNTL_H)
+#  define HEAPFILE_AVAILABLE 1
+#endif
+
+
+
+/* prototypes *****************************************************************/
+int heapfile_open(const char *fname);
+void heapfile_close(void);
+
+/* heapfile_open maps the file and makes exec_heap take its pages from
+ * there, the ones already in the file (from a run before) as well as new
+ * ones, that are appended to it. Therefore the heap may be bigger than
+ * memory, and is still there for the next run. The file's created, if
+ * it doesn't exist. Call it after interprt_init, the heap must be empty.
+ * The file's locked till heapfile_close, i.e. only one run may use it.
+ * RETURN: 0 on success, -1 on error (and without HEAPFILE_AVAILABLE).
+ *
+ * heapfile_close unmaps the file, exec_heap mustn't be used afterwards.
+ *
+ * the file starts with a header block, followed by groups of an index
+ * block (the numbers of the group's pages) and HEAPFILE_GROUP pages.
+ * Space is allocated as the pages are used, a group at a time. If the
+ * file cannot grow, exec_heap_failed() is set.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,277 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * hybrid.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * hybrid numbers, native long unless they overflow, GNU MP otherwise
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#ifdef WSVAR_HYBRID
+
+#include <assert.h>
+
+#include "hybrid.h"
+
+/* scratch space of the slow paths, the operands (if they're small) and
+ * the result are calculated in here, so we needn't mpz_init all the time
+ */
+static mpz_t hybrid_a, hybrid_b, hybrid_r;
+static int hybrid_ready = 0;
+
+/* GNU MP numbers of values, that became small again. They're kept (limbs
+ * and all) for the next value, that overflows, instead of free'ing them.
+ */
+#define HYBRID_POOL_SIZE 64
+static hybrid_big_t *hybrid_pool[HYBRID_POOL_SIZE];
+static unsigned int hybrid_pool_len = 0;
+
+static hybrid_big_t *hybrid_alloc(void);
+static mpz_srcptr hybrid_src(const hybrid_t *h, mpz_ptr scratch);
+static void hybrid_result(hybrid_t *dest);
+
+
+
+/* void hybrid_free(hybrid_t *h)
+ *
+ * release h's reference to its GNU MP number, leaving h small (with an
+ * undefined value)
+ */
+void hybrid_free(hybrid_t *h)
+{
+    if(-- h->big->refs)
+        ; /* still used by some other copy */
+
+    else if(hybrid_pool_len < HYBRID_POOL_SIZE)
+        hybrid_pool[hybrid_pool_len ++] = h->big;
+
+    else {
+        mpz_clear(h->big->value);
+        free(h->big);
+    }
+
+    h->big = NULL;
+}
+
+
+
+/* hybrid_big_t *hybrid_alloc(void)
+ *
+ * RETURN: an initialized GNU MP number (with a single reference), from
+ *         the pool if possible
+ */
+static hybrid_big_t *hybrid_alloc(void)
+{
+    hybrid_big_t *big;
+
+    if(hybrid_pool_len)
+        big = hybrid_pool[-- hybrid_pool_len];
+    else {
+        big = malloc(sizeof(*big));
+        assert(big);
+        mpz_init(big->value);
+    }
+
+    big->refs = 1;
+    return big;
+}
+
+
+
+/* mpz_srcptr hybrid_src(const hybrid_t *h, mpz_ptr scratch)
+ *
+ * RETURN: GNU MP number holding the value of h, either h's own or scratch
+ */
+static mpz_srcptr hybrid_src(const hybrid_t *h, mpz_ptr scratch)
+{
+    if(! hybrid_ready) {
+        mpz_init(hybrid_a);
+        mpz_init(hybrid_b);
+        mpz_init(hybrid_r);
+        hybrid_ready = 1;
+    }
+
+    if(h->big) return h->big->value;
+
+    mpz_set_si(scratch, h->small);
+    return scratch;
+}
+
+
+
+/* void hybrid_result(hybrid_t *dest)
+ *
+ * store the value of hybrid_r to dest, demoting it to small if it fits
+ */
+static void hybrid_result(hybrid_t *dest)
+{
+    if(mpz_fits_slong_p(hybrid_r)) {
+        hybrid_set_si(dest, mpz_get_si(hybrid_r));
+        return;
+    }
+
+    /* don't touch a value, that's shared with others */
+    if(dest->big && dest->big->refs > 1)
+        hybrid_free(dest);
+
+    if(! dest->big)
+        dest->big = hybrid_alloc();
+
+    /* dest's old value may be used as scratch space from now on */
+    mpz_swap(dest->big->value, hybrid_r);
+}
+
+
+
+/* the slow paths of the arithmetic, see hybrid.h ****************************/
+void hybrid_add_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b)
+{
+    mpz_add(hybrid_r, hybrid_src(a, hybrid_a), hybrid_src(b, hybrid_b));
+    hybrid_result(dest);
+}
+
+void hybrid_sub_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b)
+{
+    mpz_sub(hybrid_r, hybrid_src(a, hybrid_a), hybrid_src(b, hybrid_b));
+    hybrid_result(dest);
+}
+
+void hybrid_mul_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b)
+{
+    mpz_mul(hybrid_r, hybrid_src(a, hybrid_a), hybrid_src(b, hybrid_b));
+    hybrid_result(dest);
+}
+
+void hybrid_div_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b)
+{
+    mpz_tdiv_q(hybrid_r, hybrid_src(a, hybrid_a), hybrid_src(b, hybrid_b));
+    hybrid_result(dest);
+}
+
+void hybrid_mod_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b)
+{
+    mpz_tdiv_r(hybrid_r, hybrid_src(a, hybrid_a), hybrid_src(b, hybrid_b));
+    hybrid_result(dest);
+}
+
+void hybrid_neg_big(hybrid_t *dest, const hybrid_t *src)
+{
+    mpz_neg(hybrid_r, hybrid_src(src, hybrid_a));
+    hybrid_result(dest);
+}
+
+void hybrid_2exp_big(hybrid_t *dest, const hybrid_t *src, unsigned long k,
+                     int op)
+{
+    mpz_srcptr s = hybrid_src(src, hybrid_a);
+
+    switch(op) {
+        case HYBRID_MUL: mpz_mul_2exp(hybrid_r, s, k); break;
+        case HYBRID_DIV: mpz_tdiv_q_2exp(hybrid_r, s, k); break;
+        default:         mpz_tdiv_r_2exp(hybrid_r, s, k); break;
+    }
+
+    hybrid_result(dest);
+}
+
+void hybrid_ui_big(hybrid_t *dest, const hybrid_t *src, unsigned long ui,
+                   int op)
+{
+    mpz_srcptr s = hybrid_src(src, hybrid_a);
+
+    if(op == HYBRID_ADD)
+        mpz_add_ui(hybrid_r, s, ui);
+    else
+        mpz_mul_ui(hybrid_r, s, ui);
+
+    hybrid_result(dest);
+}
+
+
+
+/* void hybrid_assign_big(hybrid_t *dest, const hybrid_t *src)
+ *
+ * copy src, that is big, to dest, i.e. share its GNU MP number
+ */
+void hybrid_assign_big(hybrid_t *dest, const hybrid_t *src)
+{
+    if(dest->big == src->big) return;
+
+    if(dest->big) hybrid_free(dest);
+
+    dest->big = src->big;
+    dest->big->refs ++;
+}
+
+
+
+/* int hybrid_cmp_big(const hybrid_t *a, const hybrid_t *b)
+ *
+ * compare a and b, at least one of them is big
+ *
+ * RETURN: like mpz_cmp
+ */
+int hybrid_cmp_big(const hybrid_t *a, const hybrid_t *b)
+{
+    /* a big value is beyond any small one */
+    if(! a->big) return -mpz_sgn(b->big->value);
+    if(! b->big) return mpz_sgn(a->big->value);
+
+    return a->big == b->big ? 0 : mpz_cmp(a->big->value, b->big->value);
+}
+
+
+
+/* void hybrid_get_mpz(mpz_t dest, const hybrid_t *src)
+ *
+ * store the value of src to the (initialized) GNU MP number dest
+ */
+void hybrid_get_mpz(mpz_t dest, const hybrid_t *src)
+{
+    if(src->big)
+        mpz_set(dest, src->big->value);
+    else
+        mpz_set_si(dest, src->small);
+}
+
+
+
+/* size_t hybrid_input(hybrid_t *dest)
+ *
+ * read a number from stdin, like mpz_inp_str
+ *
+ * RETURN: number of bytes read, 0 on error
+ */
+size_t hybrid_input(hybrid_t *dest)
+{
+    size_t result;
+
+    /* keep dest on error, like GNU MP */
+    mpz_set(hybrid_r, hybrid_src(dest, hybrid_a));
+
+    if((result = mpz_inp_str(hybrid_r, stdin, 0)))
+        hybrid_result(dest);
+
+    return result;
+}
+
+#endif /* WSVAR_HYBRID */
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,269 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * hybrid.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * hybrid numbers, native long unless they overflow, GNU MP otherwise
+ */
+
+#ifndef _HYBRID_H
+#define _HYBRID_H
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <gmp.h>
+
+
+
+/* hybrid number **************************************************************/
+typedef struct {
+    mpz_t value;
+    unsigned int refs;  /* number of hybrid numbers, that share it */
+} hybrid_big_t;
+
+typedef struct {
+    long small;         /* the value, unless big is set */
+    hybrid_big_t *big;  /* malloc'd value, if it doesn't fit into small */
+} hybrid_t;
+
+/* a value is never stored in big, if it fits into small, therefore
+ * values are equal only if both are small (or both are big).
+ *
+ * Copies of a big value share it (copy on write), dup'ing a number of
+ * thousands of digits just counts up refs. Shared values are never
+ * modified, the results of calculations go to a GNU MP number of their
+ * own.
+ *
+ * The inline functions below handle the common case, i.e. all operands
+ * and the result fitting into a long, and leave everything else to the
+ * hybrid_*_big functions of hybrid.c
+ */
+
+
+
+/* prototypes *****************************************************************/
+void hybrid_free(hybrid_t *h);
+void hybrid_assign_big(hybrid_t *dest, const hybrid_t *src);
+void hybrid_add_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b);
+void hybrid_sub_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b);
+void hybrid_mul_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b);
+void hybrid_div_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b);
+void hybrid_mod_big(hybrid_t *dest, const hybrid_t *a, const hybrid_t *b);
+void hybrid_2exp_big(hybrid_t *dest, const hybrid_t *src, unsigned long k,
+                     int op);
+void hybrid_ui_big(hybrid_t *dest, const hybrid_t *src, unsigned long ui,
+                   int op);
+void hybrid_neg_big(hybrid_t *dest, const hybrid_t *src);
+int hybrid_cmp_big(const hybrid_t *a, const hybrid_t *b);
+void hybrid_get_mpz(mpz_t dest, const hybrid_t *src);
+size_t hybrid_input(hybrid_t *dest);
+
+/* operations of hybrid_2exp_big and hybrid_ui_big */
+#define HYBRID_MUL  0
+#define HYBRID_DIV  1
+#define HYBRID_MOD  2
+#define HYBRID_ADD  3
+
+
+
+/* inline fast paths **********************************************************/
+static inline void hybrid_set_si(hybrid_t *dest, long v)
+{
+    if(dest->big) hybrid_free(dest);
+    dest->small = v;
+}
+
+static inline void hybrid_assign(hybrid_t *dest, const hybrid_t *src)
+{
+    if(src->big)
+        hybrid_assign_big(dest, src);
+    else
+        hybrid_set_si(dest, src->small);
+}
+
+static inline void hybrid_swap(hybrid_t *a, hybrid_t *b)
+{
+    hybrid_t swap = *a;
+    *a = *b;
+    *b = swap;
+}
+
+static inline void hybrid_add(hybrid_t *dest, const hybrid_t *a,
+                              const hybrid_t *b)
+{
+    long r;
+
+    if(a->big || b->big || __builtin_add_overflow(a->small, b->small, &r))
+        hybrid_add_big(dest, a, b);
+    else
+        hybrid_set_si(dest, r);
+}
+
+static inline void hybrid_sub(hybrid_t *dest, const hybrid_t *a,
+                              const hybrid_t *b)
+{
+    long r;
+
+    if(a->big || b->big || __builtin_sub_overflow(a->small, b->small, &r))
+        hybrid_sub_big(dest, a, b);
+    else
+        hybrid_set_si(dest, r);
+}
+
+static inline void hybrid_mul(hybrid_t *dest, const hybrid_t *a,
+                              const hybrid_t *b)
+{
+    long r;
+
+    if(a->big || b->big || __builtin_mul_overflow(a->small, b->small, &r))
+        hybrid_mul_big(dest, a, b);
+    else
+        hybrid_set_si(dest, r);
+}
+
+/* division by zero is left to GNU MP, to fail just like it does */
+#define HYBRID_DIV_SMALL(a,b) \
+    (! (a)->big && ! (b)->big && (b)->small \
+     && ((b)->small != -1 || (a)->small != LONG_MIN))
+
+static inline void hybrid_div(hybrid_t *dest, const hybrid_t *a,
+                              const hybrid_t *b)
+{
+    if(HYBRID_DIV_SMALL(a, b))
+        hybrid_set_si(dest, a->small / b->small);
+    else
+        hybrid_div_big(dest, a, b);
+}
+
+static inline void hybrid_mod(hybrid_t *dest, const hybrid_t *a,
+                              const hybrid_t *b)
+{
+    if(HYBRID_DIV_SMALL(a, b))
+        hybrid_set_si(dest, a->small % b->small);
+    else
+        hybrid_mod_big(dest, a, b);
+}
+
+static inline void hybrid_add_ui(hybrid_t *dest, const hybrid_t *src,
+                                 unsigned long ui)
+{
+    long r;
+
+    if(src->big || ui > LONG_MAX
+       || __builtin_add_overflow(src->small, (long) ui, &r))
+        hybrid_ui_big(dest, src, ui, HYBRID_ADD);
+    else
+        hybrid_set_si(dest, r);
+}
+
+static inline void hybrid_mul_ui(hybrid_t *dest, const hybrid_t *src,
+                                 unsigned long ui)
+{
+    long r;
+
+    if(src->big || ui > LONG_MAX
+       || __builtin_mul_overflow(src->small, (long) ui, &r))
+        hybrid_ui_big(dest, src, ui, HYBRID_MUL);
+    else
+        hybrid_set_si(dest, r);
+}
+
+static inline void hybrid_neg(hybrid_t *dest, const hybrid_t *src)
+{
+    if(src->big || src->small == LONG_MIN)
+        hybrid_neg_big(dest, src);
+    else
+        hybrid_set_si(dest, -src->small);
+}
+
+/* k is at most 30, see optimize.c */
+static inline void hybrid_mul_2exp(hybrid_t *dest, const hybrid_t *src,
+                                   unsigned long k)
+{
+    long r;
+
+    if(src->big || __builtin_mul_overflow(src->small, 1L << k, &r))
+        hybrid_2exp_big(dest, src, k, HYBRID_MUL);
+    else
+        hybrid_set_si(dest, r);
+}
+
+static inline void hybrid_div_2exp(hybrid_t *dest, const hybrid_t *src,
+                                   unsigned long k)
+{
+    if(src->big)
+        hybrid_2exp_big(dest, src, k, HYBRID_DIV);
+    else
+        hybrid_set_si(dest, src->small / (1L << k));
+}
+
+static inline void hybrid_mod_2exp(hybrid_t *dest, const hybrid_t *src,
+                                   unsigned long k)
+{
+    if(src->big)
+        hybrid_2exp_big(dest, src, k, HYBRID_MOD);
+    else
+        hybrid_set_si(dest, src->small % (1L << k));
+}
+
+static inline int hybrid_cmp(const hybrid_t *a, const hybrid_t *b)
+{
+    if(a->big || b->big)
+        return hybrid_cmp_big(a, b);
+
+    return (a->small > b->small) - (a->small < b->small);
+}
+
+static inline int hybrid_sgn(const hybrid_t *h)
+{
+    if(h->big)
+        return mpz_sgn(h->big->value);
+
+    return (h->small > 0) - (h->small < 0);
+}
+
+/* like mpz_get_ui, i.e. the least significant bits of the absolute value */
+static inline unsigned long hybrid_get_ui(const hybrid_t *h)
+{
+    if(h->big)
+        return mpz_get_ui(h->big->value);
+
+    return h->small < 0 ? 0UL - (unsigned long) h->small
+                        : (unsigned long) h->small;
+}
+
+/* like mpz_get_si, i.e. the least significant bits, with the sign */
+static inline long hybrid_get_si(const hybrid_t *h)
+{
+    if(h->big)
+        return mpz_get_si(h->big->value);
+
+    return h->small;
+}
+
+static inline void hybrid_print(const hybrid_t *h)
+{
+    if(h->big)
+        gmp_printf("%Zd", h->big->value);
+    else
+        printf("%ld", h->small);
+}
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,646 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * idiom.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * recognizing loops, that fill, copy, print or sum up heap cells
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "idiom.h"
+
+/* maximum number of instructions per iteration */
+#define IDIOM_MAX_LEN 64
+
+/* symbolic values of the stack items and heap cells within an iteration */
+#define VAL_CONST   0  /* literal lit, c holds its value if small is set */
+#define VAL_VAR     1  /* variable var plus c */
+#define VAL_LOADED  2  /* the value loaded, minus literal lit (if set) */
+#define VAL_SUM     3  /* variable var plus the value loaded */
+
+typedef struct {
+    unsigned char kind;
+    unsigned char var;
+    unsigned char small;
+    unsigned int lit;
+    long c;
+} idiom_val_t;
+
+idiom_t *idiom_table = NULL;
+
+/* the loop being analyzed. Its entry is at IDIOM_MAX_DEPTH on
+ * idiom_stack, below are the items it starts with.
+ */
+static idiom_t *idiom_loop;
+static idiom_val_t idiom_stack[2 * IDIOM_MAX_DEPTH];
+static unsigned int idiom_sp, idiom_low;
+static idiom_val_t idiom_cells[IDIOM_MAX_VARS];
+static unsigned int idiom_loads, idiom_stores, idiom_prints, idiom_conds;
+static unsigned int idiom_copies;
+
+static int idiom_analyze(unsigned int head);
+static int idiom_finish(void);
+static int idiom_reaches(unsigned int pos, unsigned int head);
+static int idiom_push(idiom_val_t v);
+static int idiom_pop(idiom_val_t *v);
+static idiom_val_t idiom_literal(unsigned int lit);
+static int idiom_arith(idiom_val_t *x, idiom_val_t y, int sub);
+static int idiom_cell(long address, unsigned char *var);
+static int idiom_address(idiom_val_t a, unsigned char *var, long *offset);
+static int idiom_cond(idiom_val_t v, int exit);
+static long idiom_count(long t, long step, int exit);
+static long idiom_before(long n, long cell, long address, long step);
+
+
+
+/* void idiom_program(void)
+ *
+ * find the loops, that can be run in bulk
+ */
+void idiom_program(void)
+{
+    unsigned int pos;
+    unsigned char *entry = decode_entries();
+
+    idiom_table = realloc(idiom_table, insn_len * sizeof(*idiom_table));
+    assert(idiom_table);
+
+    /* a loop starts at a jump target, that starts a block as well */
+    for(pos = 0; pos < insn_len; pos ++)
+        if(entry[pos] && (insn[pos].block == BLOCK_CHECKED
+                          || insn[pos].block == BLOCK_LEADER)
+           && idiom_analyze(pos)) {
+            idiom_table[pos].leader = insn[pos].block == BLOCK_LEADER;
+            insn[pos].block = BLOCK_IDIOM;
+        }
+
+    free(entry);
+}
+
+
+
+/* int idiom_analyze(unsigned int head)
+ *
+ * follow the instructions starting at head, till we're back at head,
+ * keeping track of the stack items and heap cells symbolically. Fill in
+ * idiom_table[head] on the way.
+ *
+ * RETURN: 1 if it's a loop we can run in bulk, 0 if not
+ */
+static int idiom_analyze(unsigned int head)
+{
+    unsigned int pos = head, len = 0, i;
+    int stay;
+    idiom_val_t v, w;
+
+    idiom_loop = &idiom_table[head];
+    idiom_loop->vars = IDIOM_MAX_DEPTH;
+    idiom_loop->fill_lit = idiom_loop->cond_lit = IDIOM_NO_LIT;
+    idiom_loop->cond_load = 0;
+    idiom_loads = idiom_stores = idiom_prints = idiom_conds = 0;
+    idiom_copies = 0;
+
+    for(i = 0; i < IDIOM_MAX_DEPTH; i ++) {
+        idiom_var_t *var = &idiom_loop->var[i];
+
+        var->slot = 1;
+        var->exact = 0;
+        var->at = i;
+        var->step = 0;
+
+        v.kind = VAL_VAR;
+        v.var = i;
+        v.lit = IDIOM_NO_LIT;
+        v.c = 0;
+        idiom_stack[IDIOM_MAX_DEPTH - 1 - i] = v;
+    }
+    idiom_sp = idiom_low = IDIOM_MAX_DEPTH;
+
+    do {
+        const insn_t *in = &insn[pos];
+
+        if(++ len > IDIOM_MAX_LEN) return 0;
+        pos = in->next;
+
+        switch(in->op) {
+            case OP_PUSH:
+                if(! idiom_push(idiom_literal(in->arg))) return 0;
+                break;
+
+            case OP_DUP:
+            case OP_COPY:
+                i = in->op == OP_DUP ? 0 : in->arg;
+                if(i >= idiom_sp) return 0;
+                if(! idiom_push(idiom_stack[idiom_sp - 1 - i])) return 0;
+                break;
+
+            case OP_SWAP:
+                if(! idiom_pop(&v) || ! idiom_pop(&w)) return 0;
+                idiom_push(v);
+                idiom_push(w);
+                break;
+
+            case OP_DISCARD:
+                if(! idiom_pop(&v)) return 0;
+                break;
+
+            case OP_SLIDE:
+                if(! idiom_pop(&v)) return 0;
+                for(i = 0; i < in->arg; i ++)
+                    if(! idiom_pop(&w)) return 0;
+                idiom_push(v);
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+                if(! idiom_pop(&w) || ! idiom_pop(&v)) return 0;
+                if(! idiom_arith(&v, w, in->op == OP_SUB)) return 0;
+                idiom_push(v);
+                break;
+
+            case OP_PUSH_ADD:
+            case OP_PUSH_SUB:
+                if(! idiom_pop(&v)) return 0;
+                if(! idiom_arith(&v, idiom_literal(in->arg),
+                                 in->op == OP_PUSH_SUB))
+                    return 0;
+                idiom_push(v);
+                break;
+
+            case OP_COPY_PUSH_SUB:
+                if(in->arg >= idiom_sp) return 0;
+                v = idiom_stack[idiom_sp - 1 - in->arg];
+                if(! idiom_arith(&v, idiom_literal(in->arg2), 1)) return 0;
+                if(! idiom_push(v)) return 0;
+                break;
+
+            case OP_STORE:
+            case OP_PUSH_SWAP_STORE:
+                if(! idiom_pop(&v)) return 0;
+
+                if(in->op == OP_PUSH_SWAP_STORE) {
+                    w.kind = VAL_CONST;
+                    w.small = 1;
+                    w.c = (int) in->arg2;
+                }
+                else if(! idiom_pop(&w))
+                    return 0;
+
+                /* heap cells at constant addresses are kept track of,
+                 * like stack items
+                 */
+                if(w.kind == VAL_CONST) {
+                    unsigned char var;
+
+                    if(! w.small || ! idiom_cell(w.c, &var)) return 0;
+                    idiom_cells[var] = v;
+                    break;
+                }
+
+                if(idiom_stores ++) return 0;
+                if(! idiom_address(w, &idiom_loop->store_var,
+                                   &idiom_loop->store_offset))
+                    return 0;
+
+                if(v.kind == VAL_CONST && v.lit != IDIOM_NO_LIT)
+                    idiom_loop->fill_lit = v.lit;
+                else if(v.kind == VAL_VAR && ! v.c)
+                    idiom_loop->fill_var = v.var;
+                else if(v.kind == VAL_LOADED && v.lit == IDIOM_NO_LIT)
+                    idiom_copies = 1;
+                else
+                    return 0;
+                break;
+
+            case OP_RETRIEVE:
+            case OP_PUSH_RETRIEVE:
+                if(in->op == OP_PUSH_RETRIEVE) {
+                    v.kind = VAL_CONST;
+                    v.small = 1;
+                    v.c = (int) in->arg2;
+                }
+                else if(! idiom_pop(&v))
+                    return 0;
+
+                if(v.kind == VAL_CONST) {
+                    unsigned char var;
+
+                    if(! v.small || ! idiom_cell(v.c, &var)) return 0;
+                    idiom_push(idiom_cells[var]);
+                    break;
+                }
+
+                /* a load behind the store might read what was stored */
+                if(idiom_loads ++ || idiom_stores) return 0;
+                if(! idiom_address(v, &idiom_loop->load_var,
+                                   &idiom_loop->load_offset))
+                    return 0;
+
+                v.kind = VAL_LOADED;
+                v.lit = IDIOM_NO_LIT;
+                idiom_push(v);
+                break;
+
+            case OP_PRINTC:
+            case OP_PRINTN:
+                if(! idiom_pop(&v) || idiom_prints ++) return 0;
+                if(v.kind != VAL_LOADED || v.lit != IDIOM_NO_LIT) return 0;
+                idiom_loop->print_op = in->op;
+                break;
+
+            case OP_LABEL:
+                break;
+
+            case OP_JUMP:
+                pos = in->arg;
+                break;
+
+            case OP_JZ:
+            case OP_JN:
+            case OP_DUP_JZ:
+            case OP_DUP_JN:
+            case OP_PUSH_SUB_JZ:
+                /* exactly one way leads back to head */
+                stay = idiom_reaches(in->next, head);
+                if(stay == idiom_reaches(in->arg, head)) return 0;
+                if(! stay) pos = in->arg;
+
+                if(in->op == OP_DUP_JZ || in->op == OP_DUP_JN) {
+                    if(! idiom_sp) return 0;
+                    v = idiom_stack[idiom_sp - 1];
+                }
+                else if(! idiom_pop(&v))
+                    return 0;
+
+                if(in->op == OP_PUSH_SUB_JZ
+                   && ! idiom_arith(&v, idiom_literal(in->arg2), 1))
+                    return 0;
+
+                /* if we stay, the jump leaves the loop */
+                if(in->op == OP_JN || in->op == OP_DUP_JN)
+                    i = stay ? IDIOM_EXIT_NEG : IDIOM_EXIT_NONNEG;
+                else
+                    i = stay ? IDIOM_EXIT_ZERO : IDIOM_EXIT_NONZERO;
+
+                if(! idiom_cond(v, i)) return 0;
+                break;
+
+            default: /* calls, input, anything that may fail */
+                return 0;
+        }
+    } while(pos != head);
+
+    return idiom_finish();
+}
+
+
+
+/* int idiom_finish(void)
+ *
+ * check, that all the variables changed as they have to (and that we've
+ * got one of the kinds of loops, we know to run)
+ *
+ * RETURN: 1 if so, 0 if not
+ */
+static int idiom_finish(void)
+{
+    idiom_t *id = idiom_loop;
+    unsigned int i, sums = 0;
+
+    if(idiom_sp != IDIOM_MAX_DEPTH || idiom_conds != 1) return 0;
+
+    for(i = 0; i < id->vars; i ++) {
+        const idiom_val_t *v = i < IDIOM_MAX_DEPTH
+            ? &idiom_stack[IDIOM_MAX_DEPTH - 1 - i] : &idiom_cells[i];
+
+        if((v->kind != VAL_VAR && v->kind != VAL_SUM) || v->var != i)
+            return 0;
+
+        if(v->kind == VAL_SUM) {
+            id->sum_var = i;
+            sums ++;
+        }
+        else if((id->var[i].step = v->c))
+            id->var[i].exact = 1;
+    }
+
+    if(idiom_stores && idiom_loads) {
+        id->kind = IDIOM_COPY;
+        if(! idiom_copies || idiom_prints || sums) return 0;
+    }
+    else if(idiom_stores) {
+        id->kind = IDIOM_FILL;
+        if(id->fill_lit == IDIOM_NO_LIT && id->var[id->fill_var].step)
+            return 0;
+    }
+    else if(idiom_loads && idiom_prints)
+        id->kind = sums ? 0 : IDIOM_PRINT;
+    else if(idiom_loads && sums == 1)
+        id->kind = IDIOM_SUM;
+    else
+        return 0;
+
+    if(! id->kind || sums > 1) return 0;
+
+    /* the heap is run through cell by cell, and the sum isn't a counter */
+    if(idiom_loads) {
+        long step = id->var[id->load_var].step;
+        if(step != 1 && step != -1) return 0;
+        if(sums && id->load_var == id->sum_var) return 0;
+    }
+
+    if(idiom_stores) {
+        long step = id->var[id->store_var].step;
+        if(step != 1 && step != -1) return 0;
+    }
+
+    if(! id->cond_load && sums && id->cond_var == id->sum_var) return 0;
+
+    id->need = IDIOM_MAX_DEPTH - idiom_low;
+    return 1;
+}
+
+
+
+/* int idiom_reaches(unsigned int pos, unsigned int head)
+ *
+ * RETURN: 1 if the instructions starting at pos go on to head, without
+ *         any branch in between, 0 otherwise
+ */
+static int idiom_reaches(unsigned int pos, unsigned int head)
+{
+    unsigned int len;
+
+    for(len = 0; len < IDIOM_MAX_LEN && pos < insn_len; len ++) {
+        if(pos == head) return 1;
+
+        switch(insn[pos].op) {
+            case OP_JUMP:
+                pos = insn[pos].arg;
+                break;
+
+            case OP_RET:
+            case OP_EXIT:
+            case OP_SYNTAX_ERROR:
+            case OP_NO_LABEL:
+            case OP_END:
+            case OP_MEMO_RET:
+                return 0;
+
+            default:
+                if(insn_has_target(insn[pos].op)) return 0;
+                pos = insn[pos].next;
+                break;
+        }
+    }
+
+    return 0;
+}
+
+
+
+/* symbolic stack and values **************************************************/
+static int idiom_push(idiom_val_t v)
+{
+    if(idiom_sp == 2 * IDIOM_MAX_DEPTH) return 0;
+
+    idiom_stack[idiom_sp ++] = v;
+    return 1;
+}
+
+static int idiom_pop(idiom_val_t *v)
+{
+    if(! idiom_sp) return 0;
+
+    *v = idiom_stack[-- idiom_sp];
+    if(idiom_sp < idiom_low) idiom_low = idiom_sp;
+    return 1;
+}
+
+/* the value of literal lit */
+static idiom_val_t idiom_literal(unsigned int lit)
+{
+    idiom_val_t v;
+
+    v.kind = VAL_CONST;
+    v.lit = lit;
+    v.c = WSVAR_FITS_SI(insn_lit[lit]) ? WSVAR_GET_SI(insn_lit[lit]) : 0;
+    v.small = WSVAR_FITS_SI(insn_lit[lit])
+        && v.c > -IDIOM_MAX_LIT && v.c < IDIOM_MAX_LIT;
+
+    return v;
+}
+
+/* calculate x + y (or x - y, if sub is set) to x */
+static int idiom_arith(idiom_val_t *x, idiom_val_t y, int sub)
+{
+    long c;
+
+    if(y.kind == VAL_VAR && x->kind == VAL_CONST && ! sub) {
+        idiom_val_t swap = *x;
+        *x = y;
+        y = swap;
+    }
+
+    if(y.kind == VAL_CONST && x->kind == VAL_LOADED) {
+        /* good for testing the loaded value for equality only */
+        if(! sub || x->lit != IDIOM_NO_LIT || y.lit == IDIOM_NO_LIT)
+            return 0;
+        x->lit = y.lit;
+        return 1;
+    }
+
+    if(y.kind == VAL_LOADED && x->kind == VAL_VAR && ! sub) {
+        idiom_val_t swap = *x;
+        *x = y;
+        y = swap;
+    }
+
+    if(x->kind == VAL_LOADED && y.kind == VAL_VAR && ! sub) {
+        if(x->lit != IDIOM_NO_LIT || y.c) return 0;
+        x->kind = VAL_SUM;
+        x->var = y.var;
+        return 1;
+    }
+
+    if(y.kind != VAL_CONST || ! y.small) return 0;
+    if(x->kind != VAL_VAR && (x->kind != VAL_CONST || ! x->small))
+        return 0;
+
+    c = sub ? x->c - y.c : x->c + y.c;
+    if(c <= -IDIOM_MAX_LIT || c >= IDIOM_MAX_LIT) return 0;
+
+    x->c = c;
+    x->lit = IDIOM_NO_LIT;
+    return 1;
+}
+
+/* the variable of the heap cell at address */
+static int idiom_cell(long address, unsigned char *var)
+{
+    idiom_t *id = idiom_loop;
+    unsigned int i;
+
+    for(i = IDIOM_MAX_DEPTH; i < id->vars; i ++)
+        if(id->var[i].at == address) {
+            *var = i;
+            return 1;
+        }
+
+    if(id->vars == IDIOM_MAX_VARS) return 0;
+
+    id->var[i].slot = 0;
+    id->var[i].exact = 0;
+    id->var[i].at = address;
+    id->var[i].step = 0;
+    id->vars ++;
+
+    idiom_cells[i].kind = VAL_VAR;
+    idiom_cells[i].var = i;
+    idiom_cells[i].lit = IDIOM_NO_LIT;
+    idiom_cells[i].c = 0;
+
+    *var = i;
+    return 1;
+}
+
+/* the heap cells accessed through a must be variable plus offset */
+static int idiom_address(idiom_val_t a, unsigned char *var, long *offset)
+{
+    if(a.kind != VAL_VAR) return 0;
+
+    *var = a.var;
+    *offset = a.c;
+    idiom_loop->var[a.var].exact = 1;
+    return 1;
+}
+
+/* the loop leaves, if v matches exit */
+static int idiom_cond(idiom_val_t v, int exit)
+{
+    idiom_t *id = idiom_loop;
+
+    if(idiom_conds ++) return 0;
+    id->exit = exit;
+
+    if(v.kind == VAL_LOADED) {
+        /* a literal's been subtracted, equality is all we know */
+        if(v.lit != IDIOM_NO_LIT && exit > IDIOM_EXIT_NONZERO) return 0;
+
+        id->cond_load = 1;
+        id->cond_lit = v.lit;
+        return 1;
+    }
+
+    if(v.kind != VAL_VAR) return 0;
+
+    id->cond_var = v.var;
+    id->cond_offset = v.c;
+    id->var[v.var].exact = 1;
+    return 1;
+}
+
+
+
+/* long idiom_iterations(const idiom_t *id, const long *value)
+ *
+ * tell, how many iterations the loop id does without leaving
+ */
+long idiom_iterations(const idiom_t *id, const long *value)
+{
+    long n = LONG_MAX, k;
+    unsigned int i;
+
+    /* the variables have to stay below IDIOM_MAX_VALUE */
+    for(i = 0; i < id->vars; i ++)
+        if(id->var[i].step) {
+            k = (IDIOM_MAX_VALUE - 1 - labs(value[i])) / labs(id->var[i].step);
+            if(k < n) n = k;
+        }
+
+    if(! id->cond_load) {
+        k = idiom_count(value[id->cond_var] + id->cond_offset,
+                        id->var[id->cond_var].step, id->exit);
+        if(k < n) n = k;
+    }
+
+    /* stop in front of the heap cells, we keep track of on our own */
+    for(i = IDIOM_MAX_DEPTH; i < id->vars; i ++) {
+        if(id->kind != IDIOM_FILL)
+            n = idiom_before(n, id->var[i].at,
+                             value[id->load_var] + id->load_offset,
+                             id->var[id->load_var].step);
+
+        if(id->kind == IDIOM_FILL || id->kind == IDIOM_COPY)
+            n = idiom_before(n, id->var[i].at,
+                             value[id->store_var] + id->store_offset,
+                             id->var[id->store_var].step);
+    }
+
+    return n;
+}
+
+
+
+/* long idiom_count(long t, long step, int exit)
+ *
+ * RETURN: the number of iterations, the value tested stays away from
+ *         exit, if it's t at first and changes by step (LONG_MAX if
+ *         it never gets there)
+ */
+static long idiom_count(long t, long step, int exit)
+{
+    switch(exit) {
+        case IDIOM_EXIT_ZERO:
+            if(! t) return 0;
+            if(! step || t % step || -t / step < 0) return LONG_MAX;
+            return -t / step;
+
+        case IDIOM_EXIT_NONZERO:
+            if(t) return 0;
+            return step ? 1 : LONG_MAX;
+
+        case IDIOM_EXIT_NEG:
+            if(t < 0) return 0;
+            if(step >= 0) return LONG_MAX;
+            return t / -step + 1;
+
+        default: /* IDIOM_EXIT_NONNEG */
+            if(t >= 0) return 0;
+            if(step <= 0) return LONG_MAX;
+            return (-t + step - 1) / step;
+    }
+}
+
+
+
+/* long idiom_before(long n, long cell, long address, long step)
+ *
+ * RETURN: the number of iterations (at most n), before the address
+ *         (which changes by step, 1 or -1) gets to the cell
+ */
+static long idiom_before(long n, long cell, long address, long step)
+{
+    long k = (cell - address) * step;
+    return k >= 0 && k < n ? k : n;
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
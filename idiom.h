@@ -0,0 +1,113 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * idiom.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * recognizing loops, that fill, copy, print or sum up heap cells
+ */
+
+#ifndef _IDIOM_H
+#define _IDIOM_H
+
+#include "decode.h"
+
+/* the variables of a loop (and the values it calculates) stay below
+ * IDIOM_MAX_VALUE, so even 32 bit numbers never wrap around. The
+ * literals a loop adds have to be below IDIOM_MAX_LIT.
+ */
+#define IDIOM_MAX_VALUE (1L << 30)
+#define IDIOM_MAX_LIT   (1L << 28)
+
+/* a loop works on at most IDIOM_MAX_DEPTH stack items and IDIOM_MAX_CELLS
+ * heap cells at constant addresses, its variables. Variable i is item i
+ * (0 being the top), the heap cells follow.
+ */
+#define IDIOM_MAX_DEPTH 8
+#define IDIOM_MAX_CELLS 4
+#define IDIOM_MAX_VARS  (IDIOM_MAX_DEPTH + IDIOM_MAX_CELLS)
+
+/* kinds of loops */
+#define IDIOM_FILL  1   /* heap[store] = value */
+#define IDIOM_COPY  2   /* heap[store] = heap[load] */
+#define IDIOM_PRINT 3   /* print heap[load] */
+#define IDIOM_SUM   4   /* sum += heap[load] */
+
+/* the loop's exit, depending on the tested value */
+#define IDIOM_EXIT_ZERO    0
+#define IDIOM_EXIT_NONZERO 1
+#define IDIOM_EXIT_NEG     2
+#define IDIOM_EXIT_NONNEG  3
+
+#define IDIOM_NO_LIT (~0U)
+
+/* a variable of the loop, that changes by step each iteration */
+typedef struct {
+    unsigned char slot;     /* 1 if a stack item, 0 if a heap cell */
+    unsigned char exact;    /* the loop needs its value */
+    long at;                /* item (0 being the top) or heap address */
+    long step;
+} idiom_var_t;
+
+/* per loop information, indexed by the loop's first instruction */
+typedef struct {
+    unsigned char kind;     /* one of IDIOM_* */
+    unsigned char leader;   /* it's been a BLOCK_LEADER before */
+    unsigned char need;     /* stack items the loop works on */
+    unsigned char vars;
+    idiom_var_t var[IDIOM_MAX_VARS];
+
+    /* the heap cells accessed are variable plus offset */
+    unsigned char load_var, store_var;
+    long load_offset, store_offset;
+
+    /* the value IDIOM_FILL stores, a literal or a variable */
+    unsigned int fill_lit;
+    unsigned char fill_var;
+
+    unsigned char sum_var;  /* sum of IDIOM_SUM */
+    unsigned int print_op;  /* OP_PRINTC or OP_PRINTN */
+
+    /* the exit either tests variable plus offset, or the value loaded
+     * (compared to a literal, if cond_lit is set)
+     */
+    unsigned char cond_load, cond_var, exit;
+    long cond_offset;
+    unsigned int cond_lit;
+} idiom_t;
+
+extern idiom_t *idiom_table;
+
+
+
+/* prototypes *****************************************************************/
+void idiom_program(void);
+long idiom_iterations(const idiom_t *id, const long *value);
+
+/* idiom_program looks for loops, that run through the heap cell by cell
+ * (filling, copying, printing or summing them up) and marks their first
+ * instruction BLOCK_IDIOM. idiom_table describes the loop then.
+ *
+ * idiom_iterations tells, how many iterations of the loop can be run in
+ * bulk, given the values of its variables at the loop's start (that
+ * must be below IDIOM_MAX_VALUE). If the loop tests the values loaded,
+ * it may stop earlier. The iteration, that leaves the loop, is always
+ * up to the engine (see engine_idiom.h).
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
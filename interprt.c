@@ -13,42 +13,50 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "fileio.h"
 #include "interprt.h"
-
-/* gcc complains, that strchr is for signed chars actually, but unsigned 
- * ones shouldn't hurt -- especially since we hunt for '\0' here and there.
- */
-#define u_strchr(a,b) ((unsigned char *)strchr((char *)a, (signed char) b))
-#define u_strcmp(a,b) ((unsigned char *)strcmp((char *)a, (char *)b))
-
-
+#include "engine.h"
+#include "iothread.h"
+
+#ifdef HAVE_LIBGMP
+static void interprt_page_init(void *page);
+static void interprt_page_fini(void *page);
+#  define INTERPRT_PAGE_INIT interprt_page_init
+#  define INTERPRT_PAGE_FINI interprt_page_fini
+#else
+/* plain ints are fine, being zeroed */
+#  define INTERPRT_PAGE_INIT NULL
+#  define INTERPRT_PAGE_FINI NULL
+#endif
 
 /* define interpreter stacks first */
 STACK_DEF(WSVAR_TYPE, exec_stack, exec_stack_len, exec_stack_alloc)
-STACK_DEF(WSVAR_TYPE, exec_heap, exec_heap_len, exec_heap_alloc)
+PAGEDIR_DEF(WSVAR_TYPE, exec_heap, INTERPRT_PAGE_INIT, INTERPRT_PAGE_FINI)
 STACK_DEF(unsigned int, exec_bt, exec_bt_len, exec_bt_alloc)
 
 int interprt_running = 0;
 
+/* size of the buffer of standard output */
+#define INTERPRT_OUTBUF 65536
 
-/* prototypes of interprt_do_... worker functions */
-static interprt_do_stat interprt_do_stack_manip(const unsigned char *ip);
-static interprt_do_stat interprt_do_arithmetic(const unsigned char *ip);
-static interprt_do_stat interprt_do_heap_access(const unsigned char *ip);
-static interprt_do_stat interprt_do_io_command(const unsigned char *ip); 
-static interprt_do_stat interprt_do_flow_control(const unsigned char *ip); 
-
-static interprt_do_stat interprt_search_label(const unsigned char *label); 
-static void interprt_value(WSVAR_TYPE *dest, const unsigned char *ptr);
-static unsigned int interprt_number(const unsigned char *ptr);
+/* the breakpoints, one bit per instruction of insn (NULL if none has been
+ * set yet), and the number of them
+ */
+static unsigned char *interprt_breaks = NULL;
+static unsigned int interprt_breaks_count = 0;
 
+static int interprt_break_at(unsigned int index);
 
 
-/* when reading in chars (in interprt_do_io_command) try to reset terminal's
+/* when reading in chars (in interprt_input) try to reset terminal's
  * canonical flag so we can read character by character. otherwise we
  * would have to require the user to enter a whole line (terminated by \n);
  * this however is probably not what we want to have. 
@@ -66,42 +74,62 @@ static unsigned int interprt_number(const unsigned char *ptr);
 #  undef CAN_DISABLE_CANON
 #endif
 
+#if defined(HAVE_TERMIO_H)
+#  define TERMMODE_READ_COMMAND(a) ioctl(0, TCGETA, (a))
+#  define TERMMODE_WRITE_COMMAND(a) ioctl(0, TCSETA, (a))
+static struct termio interprt_canon_backup;
+#elif defined(HAVE_TERMIOS_H)
+#  define TERMMODE_READ_COMMAND(a) tcgetattr(0, (a))
+#  define TERMMODE_WRITE_COMMAND(a) tcsetattr(0, TCSANOW, (a))
+static struct termios interprt_canon_backup;
+#endif
 
-
-/* in order to increase lookup-speed of labels we cache those, therefore
- * we scan the whole file for labels, if the first lookup is requested.
- *
- * Define SMALL_HASH, to request creation a hash with 16 buckets, else
- * 256 buckets would be reserved. Typically a small hash is enough, i.e.
- * if you don't intend to run really large (say programs >50 labels)
- * programs.
+#ifdef CAN_DISABLE_CANON
+/* the terminal mode is switched at the first input of a run (the engine
+ * running till it stops, see interprt_err_handler) and restored when it
+ * stops, not on every single read. interprt_canon_state is 0 before the
+ * first input of a run, 1 if the backup has to be restored and -1 if
+ * there's nothing to restore (not a terminal, or nocanon is unset).
  */
-#define SMALL_CACHE 1
-/* #define DEBUG_CACHE_STATISTICS 1 */
-/* define DEBUG_CACHE if you want some statistics to be printed, every
- * time the cache gets created/updated. This is particularly useful when
- * updating/refining the hashing function
+static int interprt_canon_state = 0;
+static void interprt_canon_off(void);
+static void interprt_canon_restore(void);
+static void interprt_canon_guard(void);
+static void interprt_canon_signal(int sig);
+#endif
+
+
+
+/* if nobody but the program reads from stdin, and it's no terminal, the
+ * input is read ahead into interprt_inbuf, a lot of it at once, and
+ * parsed from there (see interprt_input). The debugger reads its commands
+ * from stdin as well, so it leaves interprt_buffer_input unset.
  */
+int interprt_buffer_input = 0;
 
-typedef struct label_cache_t_ label_cache_t;
-struct label_cache_t_ {
-    unsigned int ws_ptr;
-    label_cache_t *next;
-};
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#  define CAN_BUFFER_INPUT 1
 
-#ifdef SMALL_CACHE
-label_cache_t *label_cache[16] = {0};
-#else
-label_cache_t *label_cache[256] = {0};
-#endif
+/* size of the buffer, input is read ahead into */
+#define INTERPRT_INBUF 65536
 
-/* static variable, telling whether our cache is in sane state. we need
- * to mark it dirty if wsdata is changed (=> setting breakpoints)
+static unsigned char interprt_inbuf[INTERPRT_INBUF];
+static size_t interprt_inbuf_pos = 0, interprt_inbuf_len = 0;
+
+/* -1 as long as we don't know whether to buffer, 1 if we do, 2 if we do
+ * and have hit the end of the input, 0 if we don't
  */
-int label_cache_ready;
+static int interprt_inbuf_state = -1;
+
+static int interprt_inbuf_fill(void);
+static void interprt_inbuf_number(WSVAR_TYPE *dest);
 
-static int label_cache_hash_func(const unsigned char *);
-static void label_cache_create(void);
+/* the next character of the input, without consuming it, or EOF */
+#define INBUF_PEEK() \
+    (interprt_inbuf_pos < interprt_inbuf_len || interprt_inbuf_fill() \
+     ? interprt_inbuf[interprt_inbuf_pos] : EOF)
+#endif
 
 
 
@@ -122,17 +150,21 @@ void interprt_init(void)
 {
     interprt_reset(); 
 
-    /* set instruction pointer to beginning-of-file => IP=0 */
+    /* set instruction pointer to the first instruction => IP=0 */
     exec_bt_push(0);
     interprt_running = 1;
 
-    /* disable buffering of standard output */
-    setvbuf(stdout, NULL, _IONBF, 0);
+    /* buffer standard output, a lot of it. It's flushed before reading
+     * input (see interprt_input) and when the engine stops (see
+     * interprt_err_handler), i.e. whenever the user might be waiting for
+     * it, and at exit of course.
+     */
+    setvbuf(stdout, NULL, _IOFBF, INTERPRT_OUTBUF);
 
-    /* label cache is setup on first jump/call, perhaps we got a program
-     * without any jump request, well, even that's somewhat unlikely ..
+    /* the program is normally decoded as soon as it's loaded, however
+     * if there is none, we need at least the OP_END instruction
      */
-    label_cache_ready = 0;
+    if(! insn_len) decode_program(NULL);
 }
 
 
@@ -153,74 +185,40 @@ void interprt_reset(void)
 
 
 
-/* interprt_do_stat interprt_step(void)
- * 
- * execute exactly one instruction
+#ifdef HAVE_LIBGMP
+/* void interprt_page_init(void *page)
+ *
+ * initialize the numbers of a new page of exec_heap
  */
-interprt_do_stat interprt_step(void)
+static void interprt_page_init(void *page)
 {
-    interprt_do_stat stat = DO_SYNTAX_ERROR;
-    const unsigned char *ip = &wsdata[exec_bt_get()];
-
-    if(ip >= wsdata + wsdata_len)
-         /* we've reached end of programm, but there was no \n\n\n */
-        return DO_END_NOT_EXPECTED;
-   
-    switch(ip[0]) {
-        case ' ': stat = interprt_do_stack_manip(&ip[1]); break;
-                  
-        case '\t':
-            switch(ip[1]) {
-                case ' ': stat = interprt_do_arithmetic(&ip[2]); break;
-                case '\t': stat = interprt_do_heap_access(&ip[2]); break;
-                case '\n': stat = interprt_do_io_command(&ip[2]); break;
-                default: return DO_SYNTAX_ERROR;
-            }
-            
-            break;
-            
-        case '\n': stat = interprt_do_flow_control(&ip[1]); break;
-
-        case 0xCF:
-            exec_bt_replace((ip - wsdata) + 2); /* inc to beg of next insn */
-            return DO_REACHED_BREAKPOINT;
+    WSVAR_TYPE *cells = page;
+    WSVAR_INIT_DECL(cells, 0);
+    WSVAR_INIT_EXEC(cells, PAGE_CELLS);
+}
 
-        default:
-            return DO_SYNTAX_ERROR;
-    }
 
-    switch(stat) {
-        case DO_SYNTAX_ERROR:
-        case DO_LABEL_NOT_FOUND:
-        case DO_EXIT:
-        case DO_END_NOT_EXPECTED:
-        case DO_STACK_UNDERFLOW:
-            interprt_running = 0;
 
-        case DO_REACHED_BREAKPOINT: 
-            return stat;
+/* void interprt_page_fini(void *page)
+ *
+ * clear the numbers of a page of exec_heap, that's about to be free'd
+ */
+static void interprt_page_fini(void *page)
+{
+    WSVAR_TYPE *cells = page;
+    WSVAR_CLEAR_STACK(cells, PAGE_CELLS);
+}
+#endif
 
-        case DO_OKAY:
-            /* okay, called interprt_do_... didn't update the stack but
-             * everything went perfectly well. 
-             * therefore forward the instruction pointer to the next insn
-             */
-            ip = u_strchr(ip, '\0');
-            assert(ip);
-            exec_bt_replace((ip - wsdata) + 1); /* inc to beg of next line */
-            break;
 
-        case DO_OKAY_IP_MANIP:
-            /* DO_OKAY_IP_MANIP is returned if the command either was an
-             * unconditional jump, a call or an executed conditional jump.
-             *
-             * the interprt_do_flow_control() function already manipulated the
-             * stack, so we don't have to!
-             */
-             break;
-    }
 
-    return DO_OKAY;
+/* interprt_do_stat interprt_step(void)
+ * 
+ * execute exactly one instruction
+ */
+interprt_do_stat interprt_step(void)
+{
+    return engine_step();
 }
 
 
@@ -234,10 +232,14 @@ interprt_do_stat interprt_next(void)
     interprt_do_stat stat;
     unsigned int stack_level = exec_bt_len;
 
-    do
+    do {
         if((stat = interprt_step()) != DO_OKAY) 
             return stat; /* error occured */
-    while(exec_bt_len > stack_level);
+
+        /* stop at breakpoints within subroutines as well */
+        if(exec_bt_len > stack_level && interprt_break_at(exec_bt_get()))
+            return DO_REACHED_BREAKPOINT;
+    } while(exec_bt_len > stack_level);
 
     return stat;
 }
@@ -250,549 +252,403 @@ interprt_do_stat interprt_next(void)
  */
 interprt_do_stat interprt_cont(void)
 {
-    for(;;) {
-        interprt_do_stat stat = interprt_step();
-        if(stat != DO_OKAY) return stat; /* error occured */
-    }
+    interprt_do_stat stat;
+
+    /* without breakpoints, the engine needn't look out for them */
+    if(! interprt_breaks_count) return engine_run();
+
+    /* otherwise go step by step, till we're in front of one. The one we
+     * may be in front of already doesn't count.
+     */
+    do
+        if((stat = interprt_step()) != DO_OKAY)
+            return stat;
+    while(! interprt_break_at(exec_bt_get()));
+
+    return DO_REACHED_BREAKPOINT;
 }
 
 
 
-
-/* interprt_do_stack_manip
+/* int interprt_break(unsigned int index, int set)
+ *
+ * set the breakpoint at the instruction index (or clear it, if set is 0).
+ * The instruction itself is left alone, it's interprt_cont and
+ * interprt_next, that stop in front of it.
  *
- * interpret a stack manipulation command. where ip points to the first
- * command bit (right after imp)
+ * RETURN: 1 on success, 0 if it is set (or clear) already
  */
-static interprt_do_stat interprt_do_stack_manip(const unsigned char *ip)
+int interprt_break(unsigned int index, int set)
 {
-    switch(ip[0]) {
-        case '\n':
-            switch(ip[1]) {
-                case ' ': /* duplicate top item */
-                    {
-                        WSVAR_TYPE value; WSVAR_INIT(value);
-
-                        if(! exec_stack_len) return DO_STACK_UNDERFLOW;
-
-                        exec_stack_get(value);
-                        exec_stack_push(value);
-
-                        WSVAR_CLEAR(value);
-                        return DO_OKAY;
-                    }
-                    
-                case '\t': /* swap top two items */
-                    {
-                        WSVAR_TYPE first, second;
-                        WSVAR_INIT(first);
-                        WSVAR_INIT(second);
-
-                        if(exec_stack_len < 2) return DO_STACK_UNDERFLOW;
-
-                        exec_stack_pop(first);
-                        exec_stack_pop(second);
-
-                        /* okay, now push first element (former top) first */
-                        exec_stack_push(first);
-                        exec_stack_push(second);
-
-                        /* free our variables again */
-                        WSVAR_CLEAR(first);
-                        WSVAR_CLEAR(second); 
-                        return DO_OKAY;
-                    }
-                    
-                case '\n': /* discard item at the top of the stack */
-                    exec_stack_len --;
-                    return DO_OKAY;
-                
-                default: return DO_SYNTAX_ERROR;
-            }
-
-        case '\t':
-            switch(ip[1]) {
-                case ' ':
-                    /* copy n-th item onto top of stack */
-
-                    /* enforce positive numbers, which begin with a space */
-                    if(ip[2] != ' ') return DO_SYNTAX_ERROR;
-                    {
-                        WSVAR_TYPE value; 
-
-                        unsigned int stack_pos = interprt_number(&ip[3]);
-
-                        if(stack_pos >= exec_stack_len) 
-                            return DO_STACK_UNDERFLOW;
-
-                        WSVAR_INIT(value);
-                        
-                        WSVAR_ASSIGN(value, exec_stack[exec_stack_len - 1 - stack_pos]);
-                        exec_stack_push(value);
-
-                        WSVAR_CLEAR(value);
-                        return DO_OKAY;
-                    }
-                    
-                case '\n':
-                    /* discard a whole lot items from stack,
-                     * not touching the top!
-                     */
-                    if(ip[2] != ' ') return DO_SYNTAX_ERROR; 
-                    {
-                        WSVAR_TYPE stack_save;
-
-                        unsigned int discard_items = interprt_number(&ip[3]);
-
-                        if(discard_items + 1 >= exec_stack_len)
-                            return DO_STACK_UNDERFLOW;
-
-                        WSVAR_INIT(stack_save);
-
-                        exec_stack_pop(stack_save);
-                        exec_stack_len -= discard_items;
-                        exec_stack_push(stack_save);
-                        WSVAR_CLEAR(stack_save);
-
-                        return DO_OKAY;
-                    }
-                    
-                case '\t':
-                default:
-                    return DO_SYNTAX_ERROR;
-            }
+    unsigned char bit = 1 << (index & 7);
 
-        case ' ': 
-            /* push a number onto top of stack */
+    assert(index < insn_len);
 
-            /* sign must be either \t or ' '! */
-            if(ip[1] == '\n') return DO_SYNTAX_ERROR; 
+    if(! interprt_breaks) {
+        if(! set) return 0;
 
-            {
-                WSVAR_TYPE value;
-                WSVAR_INIT(value);
+        interprt_breaks = calloc(insn_len / 8 + 1, 1);
+        assert(interprt_breaks);
+    }
 
-                interprt_value(&value, &ip[1]);
-                exec_stack_push(value);
+    if(! (interprt_breaks[index >> 3] & bit) == ! set) return 0;
 
-                WSVAR_CLEAR(value);
-                return DO_OKAY;
-            }
-    }
+    interprt_breaks[index >> 3] ^= bit;
+    if(set)
+        interprt_breaks_count ++;
+    else
+        interprt_breaks_count --;
 
-    return DO_SYNTAX_ERROR;
+    return 1;
 }
 
 
 
-
-/* unsigned int interprt_number(const unsigned char *ptr)
+/* void interprt_break_reset(void)
  *
- * reinterpret ws-style-number to common unsigned int value, make
- * sure ptr pointer to the char, behind the signed bit of the ws-string!
+ * clear all the breakpoints, e.g. since the program's been decoded anew
  */
-static unsigned int interprt_number(const unsigned char *ptr) {
-    unsigned int value = 0;
-
-    if(*ptr != '\n') do {
-        value <<= 1;
-        if(*ptr == '\t') value |= 1;
-    } while(*(++ ptr) != '\n');
-
-    return value;
+void interprt_break_reset(void)
+{
+    free(interprt_breaks);
+    interprt_breaks = NULL;
+    interprt_breaks_count = 0;
 }
 
 
 
-
-/* void interprt_value(WSVAR_TYPE *result, const unsigned char *ptr)
+/* int interprt_break_at(unsigned int index)
  *
- * reinterpret ws-style-number to WSVAR_TYPE
+ * RETURN: 1 if there's a breakpoint at instruction index, 0 otherwise
  */
-static void interprt_value(WSVAR_TYPE *result, const unsigned char *ptr) {
-    WSVAR_SET_SI(*result, 0); 
-
-    if(*ptr != '\n') do {
-        WSVAR_MUL_UI(*result, *result, 2);
-        if(*ptr == '\t') WSVAR_ADD_UI(*result, *result, 1);
-    } while(*(++ ptr) != '\n');
+static int interprt_break_at(unsigned int index)
+{
+    return interprt_breaks_count
+        && (interprt_breaks[index >> 3] & (1 << (index & 7)));
 }
 
 
 
+
 
-/* interprt_do_arithmetic
+/* void interprt_input(WSVAR_TYPE *dest, int read_number)
  *
- * interpret an arithmetic command. where ip points to the first
- * command bit (right after imp)
+ * read a character (or a number, if read_number is set) from stdin into
+ * dest, flushing stdout before waiting for it. The terminal is put into
+ * non-canonical mode till the engine stops, if the nocanon toggle is set.
  */
-static interprt_do_stat interprt_do_arithmetic(const unsigned char *ip)
+void interprt_input(WSVAR_TYPE *dest, int read_number)
 {
-    /* the first _pushed_ argument is the first argument of the operation! */
-    WSVAR_TYPE first, second;
-
-    if(exec_stack_len < 2) return DO_STACK_UNDERFLOW;
-
-    WSVAR_INIT(first);
-    WSVAR_INIT(second);
-    
-    exec_stack_pop(second);
-    exec_stack_pop(first);
-
-    switch(ip[0]) {
-        case ' ':
-            switch(ip[1]) {
-                case ' ': WSVAR_ADD(first, first, second); break;
-                case '\t': WSVAR_SUB(first, first, second); break;
-                case '\n': WSVAR_MUL(first, first, second); break;
-            }
-            break;
+#ifdef CAN_BUFFER_INPUT
+    if(interprt_inbuf_state < 0)
+        interprt_inbuf_state = interprt_buffer_input && ! isatty(0);
+#endif
 
-        case '\t':
-            switch(ip[1]) {
-                case ' ': WSVAR_DIV(first, first, second); break;
-                case '\t': WSVAR_MOD(first, first, second); break;
-                default: return DO_SYNTAX_ERROR;
-            }
-            break;
+#ifdef CAN_DISABLE_CANON
+    if(! interprt_canon_state) interprt_canon_off();
+#endif
 
-        default:
-            return DO_SYNTAX_ERROR;
+#ifdef CAN_BUFFER_INPUT
+    /* stdout is flushed, once we're about to wait for input (see
+     * interprt_inbuf_fill), not when reading what we've got already
+     */
+    if(interprt_inbuf_state) {
+        int c;
+
+        if(read_number)
+            interprt_inbuf_number(dest);
+        else {
+            if((c = INBUF_PEEK()) != EOF) interprt_inbuf_pos ++;
+            WSVAR_SET_SI(*dest, c);
+        }
+        return;
     }
+#endif
 
-    exec_stack_push(first);
-
-    WSVAR_CLEAR(first);
-    WSVAR_CLEAR(second);
+    /* the output buffered so far might be the prompt, we're reading for */
+    fflush(stdout);
 
-    return DO_OKAY;
+    if(read_number)
+        WSVAR_INPUT(*dest);
+    else
+        WSVAR_SET_SI(*dest, getchar());
 }
 
 
 
-
-/* interprt_do_heap_access
+#ifdef CAN_DISABLE_CANON
+/* void interprt_canon_off(void)
  *
- * interpret a heap access command. where ip points to the first
- * command bit (right after imp)
+ * turn off canonical mode, so we can read character by character.
+ * Otherwise we would have to require the user to enter a whole line
+ * (terminated by \n); this however is probably not what we want to have.
  */
-static interprt_do_stat interprt_do_heap_access(const unsigned char *ip)
+static void interprt_canon_off(void)
 {
-    WSVAR_TYPE value, address_ws;
-    unsigned int address;
-
-    WSVAR_INIT(value);
-    WSVAR_INIT(address_ws);
+#if defined(HAVE_TERMIO_H)
+    struct termio termmode;
+#else
+    struct termios termmode;
+#endif
 
-    switch(*ip) {
-        case ' ': /* store */
-            if(exec_stack_len < 2) {
-                WSVAR_CLEAR(value);
-                WSVAR_CLEAR(address_ws);
+    interprt_canon_state = -1;
 
-                return DO_STACK_UNDERFLOW;
-            }
+#ifdef CAN_BUFFER_INPUT
+    /* no terminal, for sure */
+    if(interprt_inbuf_state > 0) return;
+#endif
 
-            /* FIXME check, that address is positive!! */
+    if(! toggles[TOGGLE_NOCANON].state || TERMMODE_READ_COMMAND(&termmode))
+        return;
 
-            exec_stack_pop(value);
-            exec_stack_pop(address_ws);
+    memmove(&interprt_canon_backup, &termmode, sizeof(termmode));
 
-            address = WSVAR_GET_UI(address_ws);
+    termmode.c_lflag &= ~ICANON;
+    termmode.c_cc[VMIN] = 1;
+    termmode.c_cc[VTIME] = 0;
 
-            exec_heap_allocate(address);
-            exec_heap_write(address,value);
-            break;
+    if(! TERMMODE_WRITE_COMMAND(&termmode)) {
+        interprt_canon_state = 1;
+        interprt_canon_guard();
+    }
+}
 
-        case '\t': /* retrieve */
-            if(! exec_stack_len) {
-                WSVAR_CLEAR(value);
-                WSVAR_CLEAR(address_ws);
 
-                return DO_STACK_UNDERFLOW;
-            }
 
-            /* FIXME make sure that address is positive!! */
+/* void interprt_canon_restore(void)
+ *
+ * restore previous mode of canonical flag, if necessary, the engine has
+ * stopped
+ */
+static void interprt_canon_restore(void)
+{
+    if(interprt_canon_state > 0)
+        TERMMODE_WRITE_COMMAND(&interprt_canon_backup);
 
-            exec_stack_pop(address_ws);
-            address = WSVAR_GET_UI(address_ws);
+    interprt_canon_state = 0;
+}
 
-            exec_heap_allocate(address);
-            exec_heap_read(address,value);
 
-            exec_stack_push(value);
-            break;
 
-        default:
-            WSVAR_CLEAR(value);
-            WSVAR_CLEAR(address_ws);
+/* void interprt_canon_guard(void)
+ *
+ * make sure the terminal's mode is restored, even if we don't get to
+ * interprt_err_handler, since we exit or are killed (e.g. by ^C, or by
+ * a division by zero, that traps) while it's changed
+ */
+static void interprt_canon_guard(void)
+{
+    static const int sigs[] = { SIGINT, SIGTERM, SIGQUIT, SIGHUP, SIGFPE };
+    static int guarded = 0;
+    unsigned int i;
 
-            return DO_SYNTAX_ERROR;
-    }
+    if(guarded) return;
+    guarded = 1;
 
-    WSVAR_CLEAR(value);
-    WSVAR_CLEAR(address_ws);
+    atexit(interprt_canon_restore);
 
-    return DO_OKAY;
+    /* leave the signals alone, that are ignored */
+    for(i = 0; i < sizeof(sigs) / sizeof(sigs[0]); i ++)
+        if(signal(sigs[i], interprt_canon_signal) == SIG_IGN)
+            signal(sigs[i], SIG_IGN);
 }
 
 
 
-
-/* interprt_do_io_command
+/* void interprt_canon_signal(int sig)
  *
- * interpret a I/O command. where ip points to the first
- * command bit (right after imp)
+ * handler of the signals, that kill us: restore the terminal's mode and
+ * let the signal do what it would have done
  */
-static interprt_do_stat interprt_do_io_command(const unsigned char *ip)
+static void interprt_canon_signal(int sig)
 {
-    WSVAR_TYPE value;
-    WSVAR_INIT(value); 
-
-    if(*ip == ' ') {
-        /* we got an I/O write */
-        if(! exec_stack_len) {
-            WSVAR_CLEAR(value);
-            return DO_STACK_UNDERFLOW;
-        }
+    interprt_canon_restore();
 
-        exec_stack_pop(value);
-
-        switch(ip[1]) {
-            case ' ': /* output character */
-                printf("%c", (int)WSVAR_GET_UI(value) & 0xff);
-                break;
-
-            case '\t': /* output number */
-                WSVAR_PRINTF(value);
-                break;
-                
-            default:
-                WSVAR_CLEAR(value);
-                return DO_SYNTAX_ERROR;
-        }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+#endif
 
-        WSVAR_CLEAR(value);
-        return DO_OKAY;
-    }
 
-    if(*ip != '\t') {
-        WSVAR_CLEAR(value);
-        return DO_SYNTAX_ERROR;
-    }
 
-#ifdef CAN_DISABLE_CANON
-    /* turn off canonical mode, if it isn't turned off yet! */
+#ifdef CAN_BUFFER_INPUT
+/* int interprt_inbuf_fill(void)
+ *
+ * read the next piece of input into interprt_inbuf, all that's there
+ * (up to INTERPRT_INBUF bytes), but without waiting for more
+ *
+ * RETURN: 1 on success, 0 at the end of the input (or on error)
+ */
+static int interprt_inbuf_fill(void)
 {
-#if defined(HAVE_TERMIO_H)
-#  define TERMMODE_READ_COMMAND(a) ioctl(0, TCGETA, (a))
-#  define TERMMODE_WRITE_COMMAND(a) ioctl(0, TCSETA, (a))
-    struct termio backup, termmode;
-
-#elif defined(HAVE_TERMIOS_H)
-#  define TERMMODE_READ_COMMAND(a) tcgetattr(0, (a))
-#  define TERMMODE_WRITE_COMMAND(a) tcsetattr(0, TCSANOW, (a))
-    struct termios backup, termmode;
+    ssize_t got;
 
-#endif
+    if(interprt_inbuf_state > 1) return 0;
 
-    int termio_restore_backup = 0;
+    /* the output buffered so far might be the prompt, we're reading for */
+    fflush(stdout);
 
-    if(toggles[TOGGLE_NOCANON].state && !TERMMODE_READ_COMMAND(&termmode)) {
-        memmove(&backup, &termmode, sizeof(termmode));
-        
-        termmode.c_lflag &= ~ICANON;
-        termmode.c_cc[VMIN] = 1;
-        termmode.c_cc[VTIME] = 0;
+    if(iothread_input)
+        /* the reader thread has read ahead already, see iothread.c */
+        got = iothread_read(interprt_inbuf, INTERPRT_INBUF);
+    else
+        do
+            got = read(0, interprt_inbuf, INTERPRT_INBUF);
+        while(got < 0 && errno == EINTR);
 
-        if(! TERMMODE_WRITE_COMMAND(&termmode))
-            termio_restore_backup = 1;
+    if(got <= 0) {
+        interprt_inbuf_state = 2;
+        return 0;
     }
-#endif
 
-    /* we got an I/O read insn */
-    switch(ip[1]) {
-        case ' ': /* read character */
-            WSVAR_SET_SI(value, getchar());
-            break;
+    interprt_inbuf_pos = 0;
+    interprt_inbuf_len = got;
+    return 1;
+}
 
-        case '\t': /* read number */
-            WSVAR_INPUT(value);
-            break;
 
-        default:
-            WSVAR_CLEAR(value);
-            return DO_SYNTAX_ERROR;
-    }
 
-#ifdef CAN_DISABLE_CANON
-    /* restore previous mode of canonical flag, if necessary */
-    if(termio_restore_backup)
-        TERMMODE_WRITE_COMMAND(&backup);
+/* int interprt_digit(int c)
+ *
+ * RETURN: the value of digit c (up to base 36), 36 if it's no digit
+ */
+static int interprt_digit(int c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'z') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    return 36;
 }
-#endif
-
-    /* okay, now store that value to the heap */
-    {
-        unsigned int address;
-        WSVAR_TYPE address_ws;
-
-        if(! exec_stack_len) {
-            WSVAR_CLEAR(value);
-            return DO_STACK_UNDERFLOW;
-        }
 
-        /* FIXME make sure address is not negative! */
 
-        WSVAR_INIT(address_ws);
-        exec_stack_pop(address_ws);
-        address = WSVAR_GET_UI(address_ws);
 
-        exec_heap_allocate(address);
-        exec_heap_write(address,value);
+/* void interprt_inbuf_append(WSVAR_TYPE *dest, int first,
+ *                            unsigned long scale, unsigned long digits)
+ *
+ * append digits (scale being the base to the power of their count) to
+ * the number in dest, that's 0 if first is set
+ */
+static void interprt_inbuf_append(WSVAR_TYPE *dest, int first,
+                                  unsigned long scale, unsigned long digits)
+{
+    if(first)
+        WSVAR_SET_SI(*dest, 0);
+    else
+        WSVAR_MUL_UI(*dest, *dest, scale);
 
-        WSVAR_CLEAR(value);  
-        WSVAR_CLEAR(address_ws);
-    }
-    return DO_OKAY;
+    WSVAR_ADD_UI(*dest, *dest, digits);
 }
 
 
 
-
-/* interprt_do_flow_control
+/* void interprt_inbuf_number(WSVAR_TYPE *dest)
  *
- * interpret a flow control command. where ip points to the first
- * command bit (right after imp)
+ * parse a number from interprt_inbuf into dest, like WSVAR_INPUT would
+ * from stdin: mpz_inp_str (with base 0) with GNU MP, scanf("%d")
+ * otherwise. dest is kept, if there's no number. The digits are
+ * collected in an unsigned long, as many as fit, so unless the number
+ * is a big one, there's no arithmetic on dest (and no allocation).
  */
-static interprt_do_stat interprt_do_flow_control(const unsigned char *ip)
+static void interprt_inbuf_number(WSVAR_TYPE *dest)
 {
-    switch(ip[0]) {
-        case ' ':
-            switch(ip[1]) {
-                case ' ': /* label mark, ignore */
-                    break;
-
-                case '\t': /* call subroutine */
-                    /* interprt_search_label pushes the correct instruction
-                     * pointer onto the stack. the old one (aka this call here
-                     * is left untouched and must be corrected when RETURN
-                     * is called below!
-                     */
-                    return interprt_search_label(&ip[2]);
-
-                case '\n': /* unconditional jump */
-                    exec_bt_len --; /* drop old ip */
-                    return interprt_search_label(&ip[2]);
-
-                default:
-                    return DO_SYNTAX_ERROR;
-            }
-            break;
+    unsigned long base = 10, scale = 1, digits = 0;
+    int c, negative = 0, first = 1;
 
-        case '\t':
-            switch(ip[1]) {
-                case '\n': /* subroutine return */
-                    {
-                        unsigned int ip;
-                        
-                        exec_bt_len --; /* discard our instruction pointer */
-                        ip = exec_bt_pop(); /* ip of caller */
-
-                        /* now advance the former ip */
-                        for(;wsdata[ip] != 0; ip ++);
-                        exec_bt_push(ip + 1);
-                        return DO_OKAY_IP_MANIP;
-                    }
-
-                case ' ':
-                case '\t':
-                    /* space => jump if stack value is zero
-                     * tab => jump if stack value is negative
-                     */
-                    {
-                        WSVAR_TYPE value;
-                        int compare_result;
-                        
-                        if(! exec_stack_len) return DO_STACK_UNDERFLOW;
-
-                        WSVAR_INIT(value);
-                        exec_stack_pop(value);
-
-                        compare_result = WSVAR_CMP_ZERO(value);
-                        /* compare_result:
-                         * positive => value is positive
-                         * zero => value is zero
-                         * negative => value is negative
-                         */
-
-                        if((ip[1] == ' ' && compare_result == 0) || 
-                           (ip[1] == '\t' && compare_result < 0)) {
-                            /* okay, we've got to jump ... */
-                            exec_bt_len --; /* drop old insn ptr */
-                            return interprt_search_label(&ip[2]);
-                        }
-                    }
-                    /* nope, don't jump since conditions not met */
-                    break;
-
-                default:
-                    return DO_SYNTAX_ERROR;
-            }
-                
-            break;
+    while(isspace(c = INBUF_PEEK()))
+        interprt_inbuf_pos ++;
 
-        case '\n':
-            return ip[1] == '\n' ? DO_EXIT : DO_SYNTAX_ERROR;
+#ifdef HAVE_LIBGMP
+    if(c == '-') {
+        negative = 1;
+        interprt_inbuf_pos ++;
+        c = INBUF_PEEK();
+    }
 
-        default:
-            return DO_SYNTAX_ERROR;
+    /* GNU MP drops the character, that isn't a digit */
+    if(c == EOF) return;
+    if(interprt_digit(c) >= 10) {
+        interprt_inbuf_pos ++;
+        return;
     }
 
-    return DO_OKAY;
-}
+    /* 0x..., 0b... and 0... are hexadecimal, binary and octal numbers */
+    if(c == '0') {
+        base = 8;
+        interprt_inbuf_pos ++;
+        c = INBUF_PEEK();
+
+        if(c == 'x' || c == 'X' || c == 'b' || c == 'B') {
+            base = (c == 'x' || c == 'X') ? 16 : 2;
+            interprt_inbuf_pos ++;
+            c = INBUF_PEEK();
+        }
+    }
+#else
+    if(c == '-' || c == '+') {
+        negative = c == '-';
+        interprt_inbuf_pos ++;
+        c = INBUF_PEEK();
+    }
 
+    if(c == EOF || interprt_digit(c) >= 10) return;
+#endif
 
+    while(c != EOF && (unsigned long) interprt_digit(c) < base) {
+        if(scale > ULONG_MAX / base) {
+            /* digits is full, that's a big number */
+            interprt_inbuf_append(dest, first, scale, digits);
+            first = 0;
+            scale = 1;
+            digits = 0;
+        }
 
-
-/* interprt_search_label
- *
- * scan the wsdata array for the label, pointed to by label argument
- */
-static interprt_do_stat interprt_search_label(const unsigned char *label)
-{
-    label_cache_t *bucket_ptr;
-    int bucket = label_cache_hash_func(label);
+        digits = digits * base + interprt_digit(c);
+        scale *= base;
+
+        interprt_inbuf_pos ++;
+        c = INBUF_PEEK();
+    }
 
-    if(! label_cache_ready) label_cache_create();
+#ifndef HAVE_LIBGMP
+    /* scanf saturates out of range numbers (like strtol does), before
+     * cutting them down to an int
+     */
+    if(! first || digits > (unsigned long) LONG_MAX + negative) {
+        WSVAR_SET_SI(*dest, negative ? LONG_MIN : LONG_MAX);
+        return;
+    }
+#endif
 
-    for(bucket_ptr = label_cache[bucket]; bucket_ptr != NULL;
-        bucket_ptr = bucket_ptr->next)
-        /* scan through the whole bucket step by step, scanning for the
-         * label we need
-         */
-        if(! u_strcmp(&wsdata[bucket_ptr->ws_ptr], label)) {
-            /* hey, got the label, push pointer to the next insn to stack */
-            unsigned char *ptr = u_strchr(&wsdata[bucket_ptr->ws_ptr], '\0');
-            assert(ptr);
-            exec_bt_push((ptr - wsdata) + 1); /* begin of next line */
-            return DO_OKAY_IP_MANIP;
-        }
+    if(first && digits <= LONG_MAX) {
+        /* the usual case */
+        WSVAR_SET_SI(*dest, negative ? - (long) digits : (long) digits);
+        return;
+    }
 
-    return DO_LABEL_NOT_FOUND;
+    interprt_inbuf_append(dest, first, scale, digits);
+    if(negative) WSVAR_NEG(*dest, *dest);
 }
+#endif
+
+
 
 
 
-
 /* void interprt_err_handler(FILE *target interprt_do_stat)
  *
- * Write out an error message to the user, if the interprt_do_... worker
- * function ran into an error. Furthermore write out the current line,
+ * Write out an error message to the user, if the engine ran into an
+ * error. Furthermore write out the current line,
  * the bt-stack pointer points to.
  */
 interprt_do_stat interprt_err_handler(FILE *target, interprt_do_stat status)
 {
+    /* the program's output goes first */
+    fflush(stdout);
+
+#ifdef CAN_DISABLE_CANON
+    interprt_canon_restore();
+#endif
+
     switch(status) {
         case DO_SYNTAX_ERROR:
             fprintf(target,"Syntax Error, cannot continue.\n");
@@ -802,13 +658,18 @@ interprt_do_stat interprt_err_handler(FILE *target, interprt_do_stat status)
             fprintf(target,"Stack Underflown, unable to continue.\n");
             break;
 
+        case DO_HEAP_FULL:
+            fprintf(target, "Heap cannot grow, unable to continue.\n");
+            break;
+
         case DO_EXIT:
             fprintf(target, "Program exited normally.\n");
             return status; /* -> don't write stack dump */
 
         case DO_REACHED_BREAKPOINT:
             fprintf(target, 
-                "Breakpoint at 0x%04x reached.\n", exec_bt_get() - 2);
+                "Breakpoint at 0x%04x reached.\n",
+                insn[exec_bt_get()].ws_ptr);
             break;
 
         case DO_OKAY:
@@ -828,7 +689,7 @@ interprt_do_stat interprt_err_handler(FILE *target, interprt_do_stat status)
 
     /* okay, now tell what the instruction, the IP points to, is */
     if(exec_bt_len)
-        interprt_output_list(target, &wsdata[exec_bt_get()], 1);
+        interprt_output_list(target, &wsdata[insn[exec_bt_get()].ws_ptr], 1);
     else
         fprintf(target, "exec_bt stack empty, is the program running?\n");
 
@@ -842,6 +703,8 @@ interprt_do_stat interprt_err_handler(FILE *target, interprt_do_stat status)
         for(dump = exec_stack_len - 1; dump >= dump_to; dump --)
             WSVAR_DUMP_HEXPREFIX(exec_stack[dump]);
 
+        /* the values went to stdout, which is buffered */
+        fflush(stdout);
         fprintf(target, "\n");
     }
 
@@ -873,12 +736,19 @@ void interprt_output_list(FILE *target, const unsigned char *wsdata_ptr, int lin
 
         fprintf(target, "[ip=0x%04x]: ", wsdata_ptr - wsdata);
 
+        if(interprt_breaks_count) {
+            unsigned int index = decode_lookup(wsdata_ptr - wsdata);
+
+            if(insn[index].ws_ptr == wsdata_ptr - wsdata
+               && interprt_break_at(index))
+                fprintf(target, "<break-point>");
+        }
+
         for(; *wsdata_ptr && -- count; wsdata_ptr ++)
             switch(wsdata_ptr[0]) {
                 case '\t': fprintf(target, "[TAB]"); break;
                 case '\n': fprintf(target, "[LF]"); break;
                 case ' ': fprintf(target, "[SPACE]"); break;
-                case 0xCF: fprintf(target, "<break-point>"); break;
             }
 
         if(! count) {
@@ -898,134 +768,6 @@ void interprt_output_list(FILE *target, const unsigned char *wsdata_ptr, int lin
 
 
 
-/* int label_cache_hash_func(const unsigned char *)
- *
- * calculate the corresponding hash bucket number for the label
- */
-static int label_cache_hash_func(const unsigned char *ptr) 
-{
-    int hash = 0;
-    int shift = 1;
-
-    for(; *ptr != '\n'; shift = shift == 128 ? 1 : shift << 1, ptr ++)
-        if(*ptr == '\t')
-            hash ^= shift;
-
-#ifdef SMALL_CACHE
-    /* user wants just a small hash, merge (xor) it down to 4 bits then
-     */
-    hash = (hash & 0x0F) ^ ((hash & 0xF0) >> 4);
-#endif
-
-    return hash;
-}
-
-
-
-/* void label_cache_clear(void)
- *
- * clear a previously generated label cache (especially free() allocated
- * memory on heap
- */
-static void label_cache_clear(void)
-{
-    label_cache_t *ptr, *next;
-    int bucket;
-#ifdef SMALL_CACHE
-    int buckets = 16;
-#else
-    int buckets = 256;
-#endif
-
-    for(bucket = 0; bucket < buckets; bucket ++) {
-        ptr = label_cache[bucket];
-
-        if(ptr && (ptr = ptr->next))
-            do {
-                next = ptr->next;
-                free(ptr);
-            } while((ptr = next));
-    }
-
-    memset(label_cache, 0, sizeof(label_cache));
-}
-
-
-
-/* void label_cache_create(void)
- *
- * scan the whole wsdata buffer for label marks to generate our label cache
- */
-static void label_cache_create(void) 
-{
-    unsigned int pos;
-#ifdef DEBUG_CACHE_STATISTICS
-    int bucket, buckets = sizeof(label_cache) / sizeof(label_cache[0]);
-    unsigned int cache_entries = 0;
-#endif
-
-    label_cache_clear();
-
-    for(pos = 0; pos < wsdata_len; pos ++) {
-        if(wsdata[pos] == '\n' && wsdata[pos + 1] == ' '
-           && wsdata[pos + 2] == ' ') {
-            /* okay, we've found a label marker */
-            int bucket = label_cache_hash_func(&wsdata[pos + 3]);
-            label_cache_t *entry = malloc(sizeof(label_cache_t));
-
-            entry->next = label_cache[bucket];
-            entry->ws_ptr = pos + 3;
-            
-            label_cache[bucket] = entry;
-
-#ifdef DEBUG_CACHE_STATISTICS
-            cache_entries ++;
-#endif
-        }
-    }
-
-    /* okay, our cache should be sane now ... */
-    label_cache_ready = 1;
-
-#ifdef DEBUG_CACHE_STATISTICS
-    fprintf(stderr, 
-            "=== LABEL CACHE STATISTICS ===\n\n"
-            "cache has %d entries, and %d buckets\n"
-            "therefore perfect bucket-depth would be: %f\n\n"
-            "actual bucket depth of each bucket is however as follows:\n",
-            cache_entries, buckets, (float)cache_entries / buckets);
-
-    for(bucket = 0; bucket < buckets; bucket ++) {
-        label_cache_t *ptr = label_cache[bucket];
-        int entries = 0;
-
-        for(; ptr != NULL; entries ++, ptr = ptr->next);
-        fprintf(stderr, "bucket 0x%02x has %d entries.\n", bucket, entries);
-    }
-#endif
-}
-
-
-
-/* void label_cache_update(unsigned int start, unsigned int offset);
- *
- * Update the label_cache offsets into wsdata. Adjust every pointer pointing
- * to wsdata[start] or behind by offset
- */
-void label_cache_update(unsigned int start, unsigned int offset) 
-{
-    label_cache_t *ptr;
-    unsigned int bucket;
-    unsigned int buckets = sizeof(label_cache) / sizeof(label_cache[0]);
-
-    if(! label_cache_ready) return;
-
-    for(bucket = 0; bucket < buckets; bucket ++)
-        for(ptr = label_cache[bucket]; ptr; ptr = ptr->next)
-            if(ptr->ws_ptr >= start)
-                ptr->ws_ptr += offset;
-}
-
 
 /***** -*- emacs is great -*-
 Local Variables:
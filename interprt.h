@@ -26,7 +26,62 @@
 #include <stdio.h>
 #include <string.h>
 
-#ifdef HAVE_LIBGMP
+#if defined(HAVE_LIBGMP) && defined(WSVAR_HYBRID)
+/* GNU MP numbers are slow, if they are small (as most are), therefore
+ * keep them in a long and switch over to GNU MP only on overflow
+ */
+#  include "hybrid.h"
+#  define WSVAR_TYPE hybrid_t
+
+/* memory management */
+#  define WSVAR_INIT(v) ((v).small = 0, (v).big = NULL)
+#  define WSVAR_INIT_DECL(s,a) unsigned int i = (a)
+#  define WSVAR_INIT_EXEC(s,a) for(;i < (a); i++) WSVAR_INIT((s)[i])
+#  define WSVAR_CLEAR(v) ((v).big ? hybrid_free(&(v)) : (void) 0)
+#  define WSVAR_CLEAR_STACK(s,a) \
+    do { \
+        unsigned int i; \
+        for(i = 0; i < (a); i++) \
+            WSVAR_CLEAR((s)[i]); \
+    } while(0)
+#  define WSVAR_GET_UI(v) hybrid_get_ui(&(v))
+#  define WSVAR_GET_SI(v) hybrid_get_si(&(v))
+#  define WSVAR_FITS_SI(v) (! (v).big)
+#  define WSVAR_PRINTF(v) hybrid_print(&(v))
+#  define WSVAR_SET_SI(dest,v) hybrid_set_si(&(dest),(v))
+#  define WSVAR_INPUT(dest) hybrid_input(&(dest))
+#  define WSVAR_CMP_ZERO(v) hybrid_sgn(&(v))
+#  define WSVAR_CMP(a,b) hybrid_cmp(&(a), &(b))
+
+#  define WSVAR_DUMP_(h,v) \
+    { \
+        mpz_t dump_tmp; \
+        mpz_init(dump_tmp); \
+        hybrid_get_mpz(dump_tmp, &(v)); \
+        if(mpz_cmp_si(dump_tmp, ' ') >= 0 && mpz_cmp_si(dump_tmp, 'z') <= 0) \
+            printf(" '%c' ", (int)mpz_get_ui(dump_tmp) & 0xFF); \
+        else \
+            gmp_printf(h"%Z04x ", dump_tmp); \
+        mpz_clear(dump_tmp); \
+    }
+
+/* arithmetic stuff */
+#  define WSVAR_ASSIGN(dest,src) hybrid_assign(&(dest), &(src))
+#  define WSVAR_MOVE(dest,src) hybrid_swap(&(dest), &(src))
+#  define WSVAR_SWAP(a,b) hybrid_swap(&(a), &(b))
+#  define WSVAR_ADD(dest,s1,s2) hybrid_add(&(dest), &(s1), &(s2))
+#  define WSVAR_ADD_UI(dest,s1,s2) hybrid_add_ui(&(dest), &(s1), (s2))
+#  define WSVAR_SUB(dest,s1,s2) hybrid_sub(&(dest), &(s1), &(s2))
+#  define WSVAR_NEG(dest,src) hybrid_neg(&(dest), &(src))
+#  define WSVAR_MUL(dest,s1,s2) hybrid_mul(&(dest), &(s1), &(s2))
+#  define WSVAR_MUL_UI(dest,s1,s2) hybrid_mul_ui(&(dest), &(s1), (s2))
+#  define WSVAR_DIV(dest,s1,s2) hybrid_div(&(dest), &(s1), &(s2))
+#  define WSVAR_MOD(dest,s1,s2) hybrid_mod(&(dest), &(s1), &(s2))
+#  define WSVAR_MUL_2EXP(dest,src,k) hybrid_mul_2exp(&(dest), &(src), (k))
+#  define WSVAR_DIV_2EXP(dest,src,k) hybrid_div_2exp(&(dest), &(src), (k))
+#  define WSVAR_MOD_2EXP(dest,src,k) hybrid_mod_2exp(&(dest), &(src), (k))
+
+#elif defined(HAVE_LIBGMP)
 /* we have support for GNU's MP library aboard, then let's make use
  * of it. The original whitespace interpreter written in Haskell
  * makes use of it as well
@@ -46,10 +101,13 @@
             WSVAR_CLEAR((s)[i]); \
     } while(0)
 #  define WSVAR_GET_UI(v) mpz_get_ui(v)
+#  define WSVAR_GET_SI(v) mpz_get_si(v)
+#  define WSVAR_FITS_SI(v) mpz_fits_slong_p(v)
 #  define WSVAR_PRINTF(v) gmp_printf("%Zd", (v))
 #  define WSVAR_SET_SI(dest,v) mpz_set_si((dest),(v))
 #  define WSVAR_INPUT(dest) mpz_inp_str((dest),stdin,0)
 #  define WSVAR_CMP_ZERO(v) mpz_cmp_si((v), 0)
+#  define WSVAR_CMP(a,b) mpz_cmp((a), (b))
 
 #  define WSVAR_DUMP_(h,v) \
     if(mpz_cmp_si((v), ' ') >= 0 && mpz_cmp_si((v), 'z') <= 0) \
@@ -59,13 +117,19 @@
 
 /* arithmetic stuff */
 #  define WSVAR_ASSIGN(dest,src) mpz_set((dest), (src))
+#  define WSVAR_MOVE(dest,src) mpz_swap((dest), (src))
+#  define WSVAR_SWAP(a,b) mpz_swap((a), (b))
 #  define WSVAR_ADD(dest,s1,s2) mpz_add((dest), (s1), (s2))
 #  define WSVAR_ADD_UI(dest,s1,s2) mpz_add_ui((dest), (s1), (s2))
 #  define WSVAR_SUB(dest,s1,s2) mpz_sub((dest), (s1), (s2))
+#  define WSVAR_NEG(dest,src) mpz_neg((dest), (src))
 #  define WSVAR_MUL(dest,s1,s2) mpz_mul((dest), (s1), (s2))
 #  define WSVAR_MUL_UI(dest,s1,s2) mpz_mul_ui((dest), (s1), (s2))
 #  define WSVAR_DIV(dest,s1,s2) mpz_tdiv_q((dest), (s1), (s2))
 #  define WSVAR_MOD(dest,s1,s2) mpz_tdiv_r((dest), (s1), (s2))
+#  define WSVAR_MUL_2EXP(dest,src,k) mpz_mul_2exp((dest), (src), (k))
+#  define WSVAR_DIV_2EXP(dest,src,k) mpz_tdiv_q_2exp((dest), (src), (k))
+#  define WSVAR_MOD_2EXP(dest,src,k) mpz_tdiv_r_2exp((dest), (src), (k))
 #else
 
 /* don't have GNU's MP library available, so let's use signed int */
@@ -78,10 +142,13 @@
 #  define WSVAR_CLEAR(v)
 #  define WSVAR_CLEAR_STACK(s,a)
 #  define WSVAR_GET_UI(v) ((unsigned int) v)
+#  define WSVAR_GET_SI(v) ((long) (v))
+#  define WSVAR_FITS_SI(v) 1
 #  define WSVAR_PRINTF(v) printf("%d", (v))
 #  define WSVAR_SET_SI(dest,v) (dest) = (v)
 #  define WSVAR_INPUT(dest) scanf("%d", &(dest))
 #  define WSVAR_CMP_ZERO(v) (v)
+#  define WSVAR_CMP(a,b) (((a) > (b)) - ((a) < (b)))
 
 #  define WSVAR_DUMP_(h,v) \
     if((v) >= ' ' && (v) <= 'z') \
@@ -91,13 +158,34 @@
 
 /* arithmetic stuff */
 #  define WSVAR_ASSIGN(dest,src) dest = src
+#  define WSVAR_MOVE(dest,src) dest = src
+#  define WSVAR_SWAP(a,b) \
+    do { \
+        signed int swap_tmp = (a); \
+        (a) = (b); \
+        (b) = swap_tmp; \
+    } while(0)
 #  define WSVAR_ADD(dest,s1,s2) (dest) = (s1) + (s2)
 #  define WSVAR_ADD_UI(dest,s1,s2) (dest) = (s1) + (s2)
 #  define WSVAR_SUB(dest,s1,s2) (dest) = (s1) - (s2)
+#  define WSVAR_NEG(dest,src) (dest) = -(src)
 #  define WSVAR_MUL(dest,s1,s2) (dest) = (s1) * (s2)
 #  define WSVAR_MUL_UI(dest,s1,s2) (dest) = (s1) * (s2)
 #  define WSVAR_DIV(dest,s1,s2) (dest) = (s1) / (s2)
 #  define WSVAR_MOD(dest,s1,s2) (dest) = (s1) % (s2)
+/* shifts are done unsigned, to get the same wrap around as
+ * WSVAR_MUL, WSVAR_DIV and WSVAR_MOD (rounding towards zero)
+ */
+#  define WSVAR_MUL_2EXP(dest,src,k) \
+    (dest) = (signed int) ((unsigned int) (src) << (k))
+#  define WSVAR_DIV_2EXP(dest,src,k) \
+    (dest) = (src) < 0 \
+        ? -(signed int) ((0U - (unsigned int) (src)) >> (k)) \
+        : (signed int) ((unsigned int) (src) >> (k))
+#  define WSVAR_MOD_2EXP(dest,src,k) \
+    (dest) = (src) < 0 \
+        ? -(signed int) ((0U - (unsigned int) (src)) & ((1U << (k)) - 1)) \
+        : (signed int) ((unsigned int) (src) & ((1U << (k)) - 1))
 #endif
 
 
@@ -130,6 +218,7 @@
 #define WSVAR_STACK_POP(s,l,d) WSVAR_ASSIGN((d), (s)[-- (l)])
 
 #define WSVAR_STACK_WRITE(s,a,v) WSVAR_ASSIGN((s)[a], v)
+#define WSVAR_STACK_MOVE(s,a,v)  WSVAR_MOVE((s)[a], v)
 #define WSVAR_STACK_READ(s,a,d)  WSVAR_ASSIGN(d, (s)[a])
 
 
@@ -138,8 +227,6 @@
 #  define WSVAR_DUMP(v) WSVAR_DUMP_(,v)
 
 
-
-
 
 /* exec_stack stack ***********************************************************/
 STACK_DEF_EXT(WSVAR_TYPE, exec_stack, exec_stack_len, exec_stack_alloc)
@@ -154,26 +241,33 @@ STACK_DEF_EXT(WSVAR_TYPE, exec_stack, exec_stack_len, exec_stack_alloc)
  */
 
 
-
 
-/* exec_heap stack ************************************************************/
-STACK_DEF_EXT(WSVAR_TYPE, exec_heap, exec_heap_len, exec_heap_alloc)
-#define exec_heap_reset()       WSVAR_STACK_RESET(exec_heap,exec_heap_len,exec_heap_alloc)
-#define exec_heap_allocate(a)   WSVAR_STACK_ALLOCATE(exec_heap,exec_heap_len,exec_heap_alloc,a)
-#define exec_heap_write(a,v)    WSVAR_STACK_WRITE(exec_heap, a, v)
-#define exec_heap_read(a,d)     WSVAR_STACK_READ(exec_heap, a, d)
+/* exec_heap pages ************************************************************/
+PAGEDIR_DEF_EXT(exec_heap)
+#define exec_heap_reset()       pagedir_reset(&exec_heap)
+#define exec_heap_cell(a)       PAGEDIR_CELL(WSVAR_TYPE, exec_heap, a)
+#define exec_heap_write(a,v)    WSVAR_ASSIGN(*exec_heap_cell(a), v)
+#define exec_heap_move(a,v)     WSVAR_MOVE(*exec_heap_cell(a), v)
+#define exec_heap_read(a,d)     WSVAR_ASSIGN(d, *exec_heap_cell(a))
+#define exec_heap_failed()      (exec_heap.failed)
 
 /* all heap access operations use are performed in this piece of memory 
  *
- * BE CAREFUL, exec_heap yet is only able to serve _positive_ heap addresses.
- * negative addresses will fail and abort the program!
- * 
- * make sure to exec_heap_allocate(a) before calling exec_heap_read(a)
- * or exec_heap_write(a,v)!!
+ * addresses are longs, negative ones included (take them from the stack
+ * using WSVAR_GET_SI, i.e. bigger ones wrap around). The heap is sparse,
+ * a page of cells is allocated, once any of its cells is accessed first,
+ * all the cells reading zero until written to. exec_heap_cell(a) returns
+ * a pointer to the cell at a, it may evaluate a more than once.
+ *
+ * exec_heap_move(a,v) is like exec_heap_write(a,v), but may leave any
+ * value in v (it just swaps, if numbers are GNU MP ones). Use it, if v
+ * isn't needed any longer.
+ *
+ * exec_heap_failed() tells, whether a page couldn't be allocated (from
+ * the --heap-file, see heapfile.c), the cells accessed since are lost.
  */
 
 
-
 
 /* exec_backtrace stack *******************************************************/
 STACK_DEF_EXT(unsigned int, exec_bt, exec_bt_len, exec_bt_alloc)
@@ -184,12 +278,12 @@ STACK_DEF_EXT(unsigned int, exec_bt, exec_bt_len, exec_bt_alloc)
 #define exec_bt_get()       (exec_bt[exec_bt_len - 1])
 #define exec_bt_replace(a)  (exec_bt[exec_bt_len - 1] = (a))
 
-/* instruction pointer is pushed onto this stack, if programmer makes use of
- * the CALL operation (lf, space, tab)
+/* index (into insn) of the instruction to execute next is on top of this
+ * stack. If programmer makes use of the CALL operation (lf, space, tab)
+ * the index of the instruction to return to is kept below.
  */
 
 
-
 
 /* return value type of interpreter / debugger functions **********************/
 typedef enum {
@@ -200,11 +294,12 @@ typedef enum {
     DO_LABEL_NOT_FOUND,
     DO_END_NOT_EXPECTED,
     DO_REACHED_BREAKPOINT,
-    DO_STACK_UNDERFLOW
+    DO_STACK_UNDERFLOW,
+    DO_HEAP_FULL      /* the heap's pages couldn't be allocated */
 } interprt_do_stat;
 
 
-
+
 /* interpreter toggles, changing behaviour ************************************/
 extern struct toggle_t {
     char *name;
@@ -219,7 +314,6 @@ enum {
 };
 
 
-
 
 /* prototypes for interpreter / debugger couple *******************************/
 void interprt_init(void);
@@ -230,13 +324,16 @@ interprt_do_stat interprt_next(void);
 interprt_do_stat interprt_cont(void);
 interprt_do_stat interprt_err_handler(FILE *target, interprt_do_stat status);
 void interprt_output_list(FILE *target, const unsigned char *wsdata_ptr, int lines);
+void interprt_input(WSVAR_TYPE *dest, int read_number);
 
 extern int interprt_running;
+extern int interprt_buffer_input;
 
-/* label_cache store's offsets into wsdata, therefore we need to update it,
- * if we e.g. add a breakpoint into it.
+/* breakpoints are kept apart from the program, one per instruction of
+ * insn (see decode.h), the debugger's commands stop in front of them.
  */
-void label_cache_update(unsigned int start, unsigned int offset);
+int interprt_break(unsigned int index, int set);
+void interprt_break_reset(void);
 
 #endif
 
@@ -0,0 +1,360 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * iothread.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * doing the program's input and output on threads of their own
+ */
+
+/* fopencookie is a GNU extension */
+#define _GNU_SOURCE 1
+
+#include "iothread.h"
+
+#include <stdio.h>
+
+/* is there input in the ring buffer, read ahead by the reader thread? */
+int iothread_input = 0;
+
+#ifdef IOTHREAD_AVAILABLE
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* a ring buffer, with a single producer and a single consumer. head and
+ * tail count the bytes put in and taken out, only the producer changes
+ * head, only the consumer changes tail, so neither of them has to lock
+ * anything to get at the data. The lock's there to wait for the other
+ * one only, if the ring's full or empty.
+ */
+typedef struct {
+    unsigned char *data;  /* IOTHREAD_RING bytes */
+    size_t head;          /* bytes put in so far */
+    size_t tail;          /* bytes taken out so far */
+    int closed;           /* the producer is done */
+    int sleeping;         /* is anybody waiting on cond? */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} iothread_ring_t;
+
+static iothread_ring_t iothread_out, iothread_in;
+static pthread_t iothread_writer;
+static FILE *iothread_stdout = NULL;
+
+static int iothread_ring_init(iothread_ring_t *r);
+static void iothread_wait(iothread_ring_t *r, const size_t *watched,
+                          size_t old);
+static void iothread_wake(iothread_ring_t *r);
+static void *iothread_write_loop(void *arg);
+static void *iothread_read_loop(void *arg);
+static ssize_t iothread_cookie_write(void *cookie, const char *buf,
+                                     size_t len);
+
+#define LOAD(v)     __atomic_load_n(&(v), __ATOMIC_SEQ_CST)
+#define STORE(v,x)  __atomic_store_n(&(v), (x), __ATOMIC_SEQ_CST)
+
+/* the bytes in ring r, and how many of them are in one piece */
+#define RING_USED(r,head)  ((head) - (r)->tail)
+#define RING_PIECE(pos,n) \
+    ((n) < IOTHREAD_RING - (pos) % IOTHREAD_RING \
+     ? (n) : IOTHREAD_RING - (pos) % IOTHREAD_RING)
+
+
+
+/* int iothread_start(void)
+ *
+ * start the writer thread (and the reader thread, if stdin isn't a
+ * terminal) and put the former behind stdout
+ *
+ * RETURN: 0 on success, -1 on error
+ */
+int iothread_start(void)
+{
+    static cookie_io_functions_t funcs = {
+        NULL, iothread_cookie_write, NULL, NULL
+    };
+    pthread_attr_t attr;
+    pthread_t reader;
+    FILE *stream;
+
+    if(iothread_ring_init(&iothread_out)) return -1;
+
+    if(! (stream = fopencookie(&iothread_out, "w", funcs))) return -1;
+
+    if(pthread_create(&iothread_writer, NULL, iothread_write_loop, NULL)) {
+        fclose(stream);
+        return -1;
+    }
+
+    /* whatever's been written so far goes first */
+    fflush(stdout);
+    iothread_stdout = stdout;
+    stdout = stream;
+
+    /* the terminal's mode is switched on input, reading ahead of it
+     * would read in the wrong mode (see interprt_input)
+     */
+    if(isatty(0) || iothread_ring_init(&iothread_in)) return 0;
+
+    /* nobody waits for the reader, it might be waiting for input */
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    if(! pthread_create(&reader, &attr, iothread_read_loop, NULL))
+        iothread_input = 1;
+
+    pthread_attr_destroy(&attr);
+    return 0;
+}
+
+
+
+/* void iothread_stop(void)
+ *
+ * write out what's left of the output, and stop the writer thread
+ */
+void iothread_stop(void)
+{
+    if(! iothread_stdout) return;
+
+    fclose(stdout);
+    stdout = iothread_stdout;
+    iothread_stdout = NULL;
+
+    STORE(iothread_out.closed, 1);
+    iothread_wake(&iothread_out);
+    pthread_join(iothread_writer, NULL);
+}
+
+
+
+/* size_t iothread_read(void *buf, size_t len)
+ *
+ * take up to len bytes from the input, read ahead by the reader thread,
+ * waiting for some, if there aren't any
+ *
+ * RETURN: number of bytes, 0 at the end of the input
+ */
+size_t iothread_read(void *buf, size_t len)
+{
+    iothread_ring_t *r = &iothread_in;
+    size_t head, piece, done = 0;
+
+    /* the reader closes the ring after putting in the last bytes */
+    while((head = LOAD(r->head)) == r->tail) {
+        if(LOAD(r->closed) && LOAD(r->head) == r->tail) return 0;
+        iothread_wait(r, &r->head, head);
+    }
+
+    if(len > RING_USED(r, head)) len = RING_USED(r, head);
+
+    while(done < len) {
+        piece = RING_PIECE(r->tail, len - done);
+        memcpy((char *) buf + done, r->data + r->tail % IOTHREAD_RING, piece);
+        done += piece;
+        STORE(r->tail, r->tail + piece);
+    }
+
+    iothread_wake(r);
+    return len;
+}
+
+
+
+/* int iothread_ring_init(iothread_ring_t *r)
+ *
+ * RETURN: 0 on success, -1 if we're out of memory
+ */
+static int iothread_ring_init(iothread_ring_t *r)
+{
+    if(! (r->data = malloc(IOTHREAD_RING))) return -1;
+
+    r->head = r->tail = 0;
+    r->closed = r->sleeping = 0;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    return 0;
+}
+
+
+
+/* void iothread_wait(iothread_ring_t *r, const size_t *watched,
+ *                    size_t old)
+ *
+ * wait till the other side changes *watched from old (or closes r).
+ * sleeping is set before looking at *watched again, and the other side
+ * looks at sleeping after changing it, so one of us notices.
+ */
+static void iothread_wait(iothread_ring_t *r, const size_t *watched,
+                          size_t old)
+{
+    pthread_mutex_lock(&r->lock);
+    STORE(r->sleeping, r->sleeping + 1);
+
+    while(__atomic_load_n(watched, __ATOMIC_SEQ_CST) == old
+          && ! LOAD(r->closed))
+        pthread_cond_wait(&r->cond, &r->lock);
+
+    STORE(r->sleeping, r->sleeping - 1);
+    pthread_mutex_unlock(&r->lock);
+}
+
+
+
+/* void iothread_wake(iothread_ring_t *r)
+ *
+ * wake the other side of r, if it's waiting for us
+ */
+static void iothread_wake(iothread_ring_t *r)
+{
+    if(! LOAD(r->sleeping)) return;
+
+    pthread_mutex_lock(&r->lock);
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+}
+
+
+
+/* void *iothread_write_loop(void *arg)
+ *
+ * the writer thread, write out iothread_out till it's closed and empty
+ */
+static void *iothread_write_loop(void *arg)
+{
+    iothread_ring_t *r = &iothread_out;
+    size_t head;
+    ssize_t done;
+
+    (void) arg;
+
+    for(;;) {
+        if((head = LOAD(r->head)) == r->tail) {
+            if(LOAD(r->closed) && LOAD(r->head) == r->tail) return NULL;
+            iothread_wait(r, &r->head, head);
+            continue;
+        }
+
+        do
+            done = write(1, r->data + r->tail % IOTHREAD_RING,
+                         RING_PIECE(r->tail, RING_USED(r, head)));
+        while(done < 0 && errno == EINTR);
+
+        /* there's nobody to tell about a failure, drop the output (like
+         * stdio would), rather than blocking the interpreter for ever
+         */
+        if(done < 0)
+            done = RING_PIECE(r->tail, RING_USED(r, head));
+
+        STORE(r->tail, r->tail + done);
+        iothread_wake(r);
+    }
+}
+
+
+
+/* void *iothread_read_loop(void *arg)
+ *
+ * the reader thread, read stdin into iothread_in as far as there's room
+ */
+static void *iothread_read_loop(void *arg)
+{
+    iothread_ring_t *r = &iothread_in;
+    size_t tail;
+    ssize_t got;
+
+    (void) arg;
+
+    for(;;) {
+        if(r->head - (tail = LOAD(r->tail)) == IOTHREAD_RING) {
+            iothread_wait(r, &r->tail, tail);
+            continue;
+        }
+
+        do
+            got = read(0, r->data + r->head % IOTHREAD_RING,
+                       RING_PIECE(r->head, IOTHREAD_RING - (r->head - tail)));
+        while(got < 0 && errno == EINTR);
+
+        if(got <= 0) {
+            STORE(r->closed, 1);
+            iothread_wake(r);
+            return NULL;
+        }
+
+        STORE(r->head, r->head + got);
+        iothread_wake(r);
+    }
+}
+
+
+
+/* ssize_t iothread_cookie_write(void *cookie, const char *buf, size_t len)
+ *
+ * stdout's write function, put buf into the ring buffer cookie, waiting
+ * for the writer thread to make room, if necessary
+ *
+ * RETURN: len
+ */
+static ssize_t iothread_cookie_write(void *cookie, const char *buf,
+                                     size_t len)
+{
+    iothread_ring_t *r = cookie;
+    size_t tail, piece, done = 0;
+
+    while(done < len) {
+        if(r->head - (tail = LOAD(r->tail)) == IOTHREAD_RING) {
+            iothread_wait(r, &r->tail, tail);
+            continue;
+        }
+
+        piece = RING_PIECE(r->head, IOTHREAD_RING - (r->head - tail));
+        if(piece > len - done) piece = len - done;
+
+        memcpy(r->data + r->head % IOTHREAD_RING, buf + done, piece);
+        done += piece;
+
+        STORE(r->head, r->head + piece);
+        iothread_wake(r);
+    }
+
+    return len;
+}
+
+#else /* ! IOTHREAD_AVAILABLE */
+
+int iothread_start(void)
+{
+    return -1;
+}
+
+void iothread_stop(void)
+{
+}
+
+size_t iothread_read(void *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+    return 0;
+}
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
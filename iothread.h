@@ -0,0 +1,68 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * iothread.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * doing the program's input and output on threads of their own
+ */
+
+#ifndef _IOTHREAD_H
+#define _IOTHREAD_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stddef.h>
+
+/* we need POSIX threads and a stdout, that writes to where we want it */
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_UNISTD_H) \
+    && defined(HAVE_FOPENCOOKIE)
+#  define IOTHREAD_AVAILABLE 1
+#endif
+
+/* size of the ring buffers between the interpreter and the threads */
+#define IOTHREAD_RING (1U << 20)
+
+
+
+/* prototypes *****************************************************************/
+int iothread_start(void);
+void iothread_stop(void);
+size_t iothread_read(void *buf, size_t len);
+
+extern int iothread_input;
+
+/* iothread_start puts a writer thread behind stdout: whatever's written
+ * to stdout goes to a ring buffer, the writer thread writes it out from
+ * there. Unless stdin is a terminal, a reader thread reads ahead as much
+ * of it as fits into a second ring buffer, and sets iothread_input. The
+ * interpreter has to wait then only if the one is full or the other one
+ * is empty, never for a write or a read to finish.
+ *
+ * iothread_read takes up to len bytes of the input, waiting for at least
+ * one. It returns 0 at the end of the input. iothread_stop writes out
+ * the remaining output and stops the writer, stdout is the real one
+ * again then. The reader may keep on waiting for input till exit.
+ *
+ * Without IOTHREAD_AVAILABLE, iothread_start returns -1 and does
+ * nothing.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,1215 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * jit.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * compiling the decoded program to x86-64 machine code
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jit.h"
+#include "verify.h"
+
+#ifdef JIT_AVAILABLE
+
+#include <sys/mman.h>
+
+/* the compiled code keeps these in registers (all callee saved, they
+ * survive calls into the runtime):
+ *
+ *   rbx  exec_stack, i.e. &exec_stack[0]
+ *   r12  &exec_stack[exec_stack_len], the item above the top
+ *   r13  &exec_stack[exec_stack_alloc], the end of the stack
+ *   r14  &exec_heap
+ *   r15  &jit_stack
+ *   rbp  scratch, kept across calls
+ *
+ * rax, rcx, rdx, rsi and rdi are scratch registers.
+ */
+enum {
+    JIT_RAX, JIT_RCX, JIT_RDX, JIT_RBX, JIT_RSP, JIT_RBP, JIT_RSI, JIT_RDI,
+    JIT_R8, JIT_R9, JIT_R10, JIT_R11, JIT_R12, JIT_R13, JIT_R14, JIT_R15
+};
+
+/* the reg field of 0x81 / 0x83 (immediate operand), opcode (ext << 3) | 1
+ * is op r/m, reg
+ */
+#define JIT_ADD     0
+#define JIT_OR      1
+#define JIT_AND     4
+#define JIT_SUB     5
+#define JIT_CMP     7
+
+/* condition codes of jcc, JIT_JMP jumps unconditionally */
+#define JIT_JMP     -1
+#define JIT_JO      0x0
+#define JIT_JB      0x2
+#define JIT_JAE     0x3
+#define JIT_JE      0x4
+#define JIT_JNE     0x5
+#define JIT_JA      0x7
+#define JIT_JL      0xC
+
+/* displacement of stack item n from the top (relative to r12) */
+#define JIT_TOP(n)  (-(long) sizeof(hybrid_t) * (long) ((n) + 1))
+#define JIT_SMALL   ((long) offsetof(hybrid_t, small))
+#define JIT_BIG     ((long) offsetof(hybrid_t, big))
+
+/* cells are 1 << JIT_CELL_SHIFT bytes, see jit_cell */
+#define JIT_CELL_SHIFT 4
+
+/* instructions accessing stack items beyond, are left to the engine */
+#define JIT_MAX_DEPTH (1U << 24)
+
+/* arith's operand isn't a literal, but the top item of the stack */
+#define JIT_NO_LIT  UINT_MAX
+
+/* code is collected in two sections: hot (the instructions' fast paths)
+ * and cold (slow paths, calling the runtime). The cold one is appended
+ * to the hot one, positions within it have JIT_COLD set.
+ */
+#define JIT_HOT     0
+#define JIT_COLD    1
+#define JIT_COLD_POS 0x80000000U
+
+typedef struct {
+    unsigned char *code;
+    unsigned int len, alloc;
+} jit_section_t;
+
+/* a rel32 jump (or call) to patch, once the code is in place */
+typedef struct {
+    unsigned int at;    /* position of the rel32 */
+    unsigned int to;    /* target position, or instruction index */
+    unsigned char insn; /* to is an instruction index */
+} jit_fix_t;
+
+static jit_section_t jit_sections[2];
+static unsigned int jit_current;
+static jit_fix_t *jit_fixes = NULL;
+static unsigned int jit_fixes_len, jit_fixes_alloc;
+static unsigned int *jit_positions = NULL;
+static void **jit_table = NULL;
+static unsigned int jit_epilogue;
+
+/* the stack, while the compiled code is running, see jit_do_require */
+typedef struct {
+    hybrid_t *base, *top, *limit;
+} jit_stack_t;
+
+static jit_stack_t jit_stack;
+
+static unsigned char *jit_compile(size_t *size);
+static void jit_insn(unsigned int pos);
+static void jit_effect(const insn_t *in, unsigned int *need,
+                       unsigned int *push);
+
+static void jit_need(unsigned int n, unsigned int pos);
+static void jit_reserve(unsigned int n);
+static void jit_push(unsigned int lit);
+static void jit_copy(unsigned int n);
+static void jit_swap(unsigned int a, unsigned int b);
+static void jit_drop(unsigned int n);
+static void jit_arith(unsigned int op, unsigned int lit);
+static void jit_cell(void);
+static void jit_store(void);
+static void jit_retrieve(void);
+static void jit_push_retrieve(long address);
+static void jit_swap_store(long address);
+static void jit_jz(unsigned int target, int pop);
+static void jit_jn(unsigned int target, int pop);
+static void jit_jeq(unsigned int target, unsigned int lit);
+static void jit_ret(unsigned int pos);
+
+static void jit_byte(unsigned int b);
+static void jit_imm32(long v);
+static void jit_imm64(unsigned long v);
+static void jit_opcode(unsigned int op, int w, int reg, int rm);
+static void jit_mem(unsigned int op, int w, int reg, int base, long disp);
+static void jit_reg(unsigned int op, int w, int reg, int rm);
+static void jit_alu(int ext, int w, int rm, long imm);
+static void jit_movi(int reg, long v);
+static void jit_call(void *fn);
+static void jit_swap_mem(int base1, long disp1, int base2, long disp2);
+static unsigned int jit_pos(void);
+static unsigned int jit_resolve(unsigned int pos);
+static unsigned int jit_jump(int cc);
+static void jit_jump_insn(int cc, unsigned int pos);
+static void jit_bind(unsigned int fix);
+static void jit_cold(unsigned int fix);
+static void jit_resume(void);
+static void jit_bail(int cc, unsigned int pos);
+
+/* runtime, called by the compiled code */
+static hybrid_t *jit_do_require(hybrid_t *top, unsigned int n);
+static void jit_do_assign(hybrid_t *dest, const hybrid_t *src);
+static void jit_do_store(hybrid_t *top);
+static void jit_do_retrieve(hybrid_t *top);
+static void jit_do_input(const hybrid_t *item, int read_number);
+static void jit_do_printc(const hybrid_t *item);
+static void jit_do_printn(const hybrid_t *item);
+static void jit_do_call(unsigned int next);
+static void jit_do_tail_call(unsigned int next);
+static unsigned int jit_do_ret(void);
+static int jit_do_cmp(const hybrid_t *a, const hybrid_t *b);
+
+#endif /* JIT_AVAILABLE */
+
+
+
+/* interprt_do_stat jit_run(void)
+ *
+ * compile the decoded program and run it, leave it to engine_run, once
+ * the code gives up
+ */
+interprt_do_stat jit_run(void)
+{
+#ifdef JIT_AVAILABLE
+    unsigned char *code;
+    unsigned int (*entry)(unsigned int), start;
+    size_t size;
+
+    /* counting and memoizing is done by the engine only */
+    if(engine_counts || engine_memoize) return engine_run();
+
+    verify_program();
+
+    if(! (code = jit_compile(&size))) {
+        free(jit_table);
+        jit_table = NULL;
+        return engine_run();
+    }
+
+    jit_stack.base = exec_stack;
+    jit_stack.top = exec_stack + exec_stack_len;
+    jit_stack.limit = exec_stack + exec_stack_alloc;
+
+    /* the code returns the instruction to go on with, which is the one
+     * that exits or fails
+     */
+    *(void **) &entry = code;
+    start = exec_bt_pop();
+    start = entry(start);   /* exec_bt_push might evaluate it too late */
+    exec_bt_push(start);
+    exec_stack_len = jit_stack.top - exec_stack;
+
+    munmap(code, size);
+    free(jit_table);
+    jit_table = NULL;
+#endif
+
+    return engine_run();
+}
+
+
+
+#ifdef JIT_AVAILABLE
+/* unsigned char *jit_compile(size_t *size)
+ *
+ * compile the whole program, the code is called with the index of the
+ * instruction to start at and returns the one to go on with.
+ *
+ * RETURN: the mmap'd code (size bytes), NULL if we can't get executable
+ *         memory
+ */
+static unsigned char *jit_compile(size_t *size)
+{
+    unsigned char *code;
+    unsigned int i;
+
+    assert(sizeof(hybrid_t) == 1 << JIT_CELL_SHIFT);
+
+    jit_positions = realloc(jit_positions,
+                            insn_len * sizeof(*jit_positions));
+    jit_table = malloc(insn_len * sizeof(*jit_table));
+    assert(jit_positions && jit_table);
+
+    jit_sections[JIT_HOT].len = jit_sections[JIT_COLD].len = 0;
+    jit_current = JIT_HOT;
+    jit_fixes_len = 0;
+
+    /* prologue, save the callee saved registers (keeping rsp aligned to
+     * 16 bytes for the calls), set up ours and jump to the start
+     */
+    jit_byte(0x53);                                 /* push rbx */
+    jit_byte(0x55);                                 /* push rbp */
+    jit_byte(0x41); jit_byte(0x54);                 /* push r12 */
+    jit_byte(0x41); jit_byte(0x55);                 /* push r13 */
+    jit_byte(0x41); jit_byte(0x56);                 /* push r14 */
+    jit_byte(0x41); jit_byte(0x57);                 /* push r15 */
+    jit_alu(JIT_SUB, 1, JIT_RSP, 8);
+
+    jit_movi(JIT_R15, (long) &jit_stack);
+    jit_mem(0x8B, 1, JIT_RBX, JIT_R15, offsetof(jit_stack_t, base));
+    jit_mem(0x8B, 1, JIT_R12, JIT_R15, offsetof(jit_stack_t, top));
+    jit_mem(0x8B, 1, JIT_R13, JIT_R15, offsetof(jit_stack_t, limit));
+    jit_movi(JIT_R14, (long) &exec_heap);
+
+    jit_reg(0x89, 0, JIT_RDI, JIT_RAX);             /* mov eax, edi */
+    jit_movi(JIT_RCX, (long) jit_table);
+    jit_byte(0xFF); jit_byte(0x24); jit_byte(0xC1); /* jmp [rcx+rax*8] */
+
+    /* epilogue, eax holds the instruction to go on with */
+    jit_epilogue = jit_pos();
+    jit_mem(0x89, 1, JIT_R12, JIT_R15, offsetof(jit_stack_t, top));
+    jit_alu(JIT_ADD, 1, JIT_RSP, 8);
+    jit_byte(0x41); jit_byte(0x5F);                 /* pop r15 */
+    jit_byte(0x41); jit_byte(0x5E);                 /* pop r14 */
+    jit_byte(0x41); jit_byte(0x5D);                 /* pop r13 */
+    jit_byte(0x41); jit_byte(0x5C);                 /* pop r12 */
+    jit_byte(0x5D);                                 /* pop rbp */
+    jit_byte(0x5B);                                 /* pop rbx */
+    jit_byte(0xC3);                                 /* ret */
+
+    for(i = 0; i < insn_len; i ++) {
+        jit_positions[i] = jit_pos();
+        jit_insn(i);
+
+        if(insn[i].next != i + 1 && insn[i].next < insn_len)
+            jit_jump_insn(JIT_JMP, insn[i].next);
+    }
+
+    /* put the sections into executable memory and link them */
+    *size = jit_sections[JIT_HOT].len + jit_sections[JIT_COLD].len;
+    code = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED) return NULL;
+
+    memcpy(code, jit_sections[JIT_HOT].code, jit_sections[JIT_HOT].len);
+    memcpy(code + jit_sections[JIT_HOT].len, jit_sections[JIT_COLD].code,
+           jit_sections[JIT_COLD].len);
+
+    for(i = 0; i < jit_fixes_len; i ++) {
+        const jit_fix_t *f = &jit_fixes[i];
+        unsigned int at = jit_resolve(f->at);
+        int rel = jit_resolve(f->insn ? jit_positions[f->to] : f->to)
+            - (at + 4);
+
+        memcpy(code + at, &rel, 4);
+    }
+
+    for(i = 0; i < insn_len; i ++)
+        jit_table[i] = code + jit_resolve(jit_positions[i]);
+
+    if(mprotect(code, *size, PROT_READ | PROT_EXEC)) {
+        munmap(code, *size);
+        return NULL;
+    }
+
+    return code;
+}
+
+
+
+/* void jit_insn(unsigned int pos)
+ *
+ * compile the instruction at pos. Stack underflows (as well as anything
+ * else the compiled code doesn't handle) leave the instruction to the
+ * engine, before it has done anything. Superinstructions are checked as
+ * a whole therefore, the engine knows how far they get.
+ */
+static void jit_insn(unsigned int pos)
+{
+    const insn_t *in = &insn[pos];
+    unsigned int need, push;
+
+    jit_effect(in, &need, &push);
+
+    if(in->block == BLOCK_LEADER) {
+        /* the checks of the whole block */
+        jit_need(in->need, pos);
+        jit_reserve(in->grow);
+    }
+    else if(in->block == BLOCK_CHECKED) {
+        jit_need(need, pos);
+        jit_reserve(push);
+    }
+
+    if(need > JIT_MAX_DEPTH) return; /* jit_need gave up */
+
+    switch(in->op) {
+        case OP_PUSH:
+            jit_push(in->arg);
+            break;
+
+        case OP_DUP:
+            jit_copy(0);
+            break;
+
+        case OP_COPY:
+            jit_copy(in->arg);
+            break;
+
+        case OP_SWAP:
+            jit_swap(0, 1);
+            break;
+
+        case OP_DISCARD:
+            jit_drop(1);
+            break;
+
+        case OP_SLIDE:
+            if(! in->arg) break;
+            jit_swap(0, in->arg);
+            jit_drop(in->arg);
+            break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            jit_arith(in->op, JIT_NO_LIT);
+            jit_drop(1);
+            break;
+
+        case OP_STORE:
+            jit_store();
+            break;
+
+        case OP_RETRIEVE:
+            jit_retrieve();
+            break;
+
+        case OP_LABEL:
+            break;
+
+        case OP_CALL:
+            jit_movi(JIT_RDI, in->next);
+            jit_call(jit_do_call);
+            jit_jump_insn(JIT_JMP, in->arg);
+            break;
+
+        case OP_JUMP:
+            jit_jump_insn(JIT_JMP, in->arg);
+            break;
+
+        case OP_JZ:
+            jit_jz(in->arg, 1);
+            break;
+
+        case OP_JN:
+            jit_jn(in->arg, 1);
+            break;
+
+        case OP_RET:
+            jit_ret(pos);
+            break;
+
+        case OP_PRINTC:
+        case OP_PRINTN:
+            jit_drop(1);
+            jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+            jit_call(in->op == OP_PRINTC ? (void *) jit_do_printc
+                                         : (void *) jit_do_printn);
+            break;
+
+        case OP_READC:
+        case OP_READN:
+            jit_mem(0x8D, 1, JIT_RDI, JIT_R12, JIT_TOP(0));
+            jit_movi(JIT_RSI, in->op == OP_READN);
+            jit_call(jit_do_input);
+            jit_drop(1);
+            break;
+
+        case OP_PUSH_ADD:
+            jit_arith(OP_ADD, in->arg);
+            break;
+
+        case OP_PUSH_SUB:
+            jit_arith(OP_SUB, in->arg);
+            break;
+
+        case OP_SHL:
+            jit_arith(OP_MUL, in->arg);
+            break;
+
+        case OP_DIV_POW2:
+            jit_arith(OP_DIV, in->arg);
+            break;
+
+        case OP_MOD_POW2:
+            jit_arith(OP_MOD, in->arg);
+            break;
+
+        case OP_PUSH_RETRIEVE:
+            jit_push_retrieve((int) in->arg2);
+            break;
+
+        case OP_PUSH_SWAP_STORE:
+            jit_swap_store((int) in->arg2);
+            break;
+
+        case OP_DUP_JZ:
+            jit_jz(in->arg, 0);
+            break;
+
+        case OP_DUP_JN:
+            jit_jn(in->arg, 0);
+            break;
+
+        case OP_COPY_PUSH_SUB:
+            jit_copy(in->arg);
+            jit_arith(OP_SUB, in->arg2);
+            break;
+
+        case OP_PUSH_SUB_JZ:
+            jit_jeq(in->arg, in->arg2);
+            break;
+
+        case OP_TAIL_CALL:
+            jit_movi(JIT_RDI, in->next);
+            jit_call(jit_do_tail_call);
+            jit_jump_insn(JIT_JMP, in->arg);
+            break;
+
+        case OP_JUMP_RET:
+            jit_ret(in->arg);
+            break;
+
+        default:
+            /* exits and errors are up to the engine */
+            jit_bail(JIT_JMP, pos);
+            break;
+    }
+}
+
+
+
+/* void jit_effect(const insn_t *in, unsigned int *need, unsigned int *push)
+ *
+ * store the number of items instruction in needs on the stack to need
+ * (exactly what its handler checks for) and the number of items it
+ * pushes at most to push
+ */
+static void jit_effect(const insn_t *in, unsigned int *need,
+                       unsigned int *push)
+{
+    *need = *push = 0;
+
+    switch(in->op) {
+        case OP_PUSH:
+        case OP_PUSH_RETRIEVE:
+            *push = 1;
+            break;
+
+        case OP_COPY:
+        case OP_COPY_PUSH_SUB:
+            *need = in->arg < JIT_MAX_DEPTH ? in->arg + 1 : UINT_MAX;
+            *push = 1;
+            break;
+
+        case OP_DUP:
+            *need = *push = 1;
+            break;
+
+        case OP_SLIDE:
+            *need = in->arg < JIT_MAX_DEPTH ? in->arg + 1 : UINT_MAX;
+            break;
+
+        case OP_SWAP:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_STORE:
+            *need = 2;
+            break;
+
+        case OP_DISCARD:
+        case OP_RETRIEVE:
+        case OP_JZ:
+        case OP_JN:
+        case OP_PRINTC:
+        case OP_PRINTN:
+        case OP_READC:
+        case OP_READN:
+        case OP_PUSH_ADD:
+        case OP_PUSH_SUB:
+        case OP_PUSH_SWAP_STORE:
+        case OP_DUP_JZ:
+        case OP_DUP_JN:
+        case OP_PUSH_SUB_JZ:
+        case OP_SHL:
+        case OP_DIV_POW2:
+        case OP_MOD_POW2:
+            *need = 1;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+
+/* code generators of the instructions ***************************************/
+
+/* bail out at instruction pos, unless there are n items on the stack */
+static void jit_need(unsigned int n, unsigned int pos)
+{
+    if(! n) return;
+
+    if(n > JIT_MAX_DEPTH) {
+        jit_bail(JIT_JMP, pos);
+        return;
+    }
+
+    jit_reg(0x89, 1, JIT_R12, JIT_RAX);
+    jit_reg(0x29, 1, JIT_RBX, JIT_RAX);
+    jit_alu(JIT_CMP, 1, JIT_RAX, n * sizeof(hybrid_t));
+    jit_bail(JIT_JB, pos);
+}
+
+/* make room for n more items on the stack */
+static void jit_reserve(unsigned int n)
+{
+    unsigned int fix;
+
+    if(! n) return;
+
+    jit_mem(0x8D, 1, JIT_RAX, JIT_R12, n * sizeof(hybrid_t));
+    jit_reg(0x39, 1, JIT_R13, JIT_RAX);
+    fix = jit_jump(JIT_JA);
+
+    jit_cold(fix);
+    jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+    jit_movi(JIT_RSI, n);
+    jit_call(jit_do_require);
+    jit_reg(0x89, 1, JIT_RAX, JIT_R12);
+    jit_mem(0x8B, 1, JIT_RBX, JIT_R15, offsetof(jit_stack_t, base));
+    jit_mem(0x8B, 1, JIT_R13, JIT_R15, offsetof(jit_stack_t, limit));
+    jit_resume();
+}
+
+/* push insn_lit[lit] */
+static void jit_push(unsigned int lit)
+{
+    unsigned int fix;
+
+    if(insn_lit[lit].big) {
+        jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+        jit_movi(JIT_RSI, (long) &insn_lit[lit]);
+        jit_call(jit_do_assign);
+    }
+    else {
+        /* the item above the top may still hold a big value */
+        jit_mem(0x83, 1, JIT_CMP, JIT_R12, JIT_BIG); jit_byte(0);
+        fix = jit_jump(JIT_JNE);
+        jit_movi(JIT_RAX, insn_lit[lit].small);
+        jit_mem(0x89, 1, JIT_RAX, JIT_R12, JIT_SMALL);
+
+        jit_cold(fix);
+        jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+        jit_movi(JIT_RSI, (long) &insn_lit[lit]);
+        jit_call(jit_do_assign);
+        jit_resume();
+    }
+
+    jit_alu(JIT_ADD, 1, JIT_R12, sizeof(hybrid_t));
+}
+
+/* push a copy of the n-th item */
+static void jit_copy(unsigned int n)
+{
+    unsigned int fix;
+
+    jit_mem(0x8B, 1, JIT_RAX, JIT_R12, JIT_TOP(n) + JIT_BIG);
+    jit_mem(0x0B, 1, JIT_RAX, JIT_R12, JIT_BIG);
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x8B, 1, JIT_RAX, JIT_R12, JIT_TOP(n) + JIT_SMALL);
+    jit_mem(0x89, 1, JIT_RAX, JIT_R12, JIT_SMALL);
+
+    jit_cold(fix);
+    jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+    jit_mem(0x8D, 1, JIT_RSI, JIT_R12, JIT_TOP(n));
+    jit_call(jit_do_assign);
+    jit_resume();
+
+    jit_alu(JIT_ADD, 1, JIT_R12, sizeof(hybrid_t));
+}
+
+/* swap the a-th and the b-th item */
+static void jit_swap(unsigned int a, unsigned int b)
+{
+    jit_swap_mem(JIT_R12, JIT_TOP(a), JIT_R12, JIT_TOP(b));
+}
+
+/* drop n items */
+static void jit_drop(unsigned int n)
+{
+    jit_alu(JIT_SUB, 1, JIT_R12, (long) n * sizeof(hybrid_t));
+}
+
+/* op (one of OP_ADD to OP_MOD) the second item and the top item (or
+ * insn_lit[lit], if lit isn't JIT_NO_LIT) into the second (or top) one.
+ * The caller drops the top item.
+ */
+static void jit_arith(unsigned int op, unsigned int lit)
+{
+    long a = lit == JIT_NO_LIT ? JIT_TOP(1) : JIT_TOP(0);
+    long b = JIT_TOP(0);
+    unsigned int fix[3], fixes = 0, i;
+    void *slow;
+
+    switch(op) {
+        case OP_ADD: slow = hybrid_add_big; break;
+        case OP_SUB: slow = hybrid_sub_big; break;
+        case OP_MUL: slow = hybrid_mul_big; break;
+        case OP_DIV: slow = hybrid_div_big; break;
+        default:     slow = hybrid_mod_big; break;
+    }
+
+    /* literals, that are big (or the division doesn't work natively
+     * with), go to GNU MP right away
+     */
+    if(lit != JIT_NO_LIT
+       && (insn_lit[lit].big
+           || ((op == OP_DIV || op == OP_MOD)
+               && (insn_lit[lit].small == 0 || insn_lit[lit].small == -1))))
+        goto slow_path;
+
+    if(lit == JIT_NO_LIT) {
+        jit_mem(0x8B, 1, JIT_RAX, JIT_R12, a + JIT_BIG);
+        jit_mem(0x0B, 1, JIT_RAX, JIT_R12, b + JIT_BIG);
+    }
+    else {
+        jit_mem(0x83, 1, JIT_CMP, JIT_R12, a + JIT_BIG); jit_byte(0);
+    }
+    fix[fixes ++] = jit_jump(JIT_JNE);
+
+    jit_mem(0x8B, 1, JIT_RAX, JIT_R12, a + JIT_SMALL);
+    if(lit == JIT_NO_LIT)
+        jit_mem(0x8B, 1, JIT_RCX, JIT_R12, b + JIT_SMALL);
+    else
+        jit_movi(JIT_RCX, insn_lit[lit].small);
+
+    switch(op) {
+        case OP_ADD:
+            jit_reg(0x01, 1, JIT_RCX, JIT_RAX);
+            fix[fixes ++] = jit_jump(JIT_JO);
+            break;
+
+        case OP_SUB:
+            jit_reg(0x29, 1, JIT_RCX, JIT_RAX);
+            fix[fixes ++] = jit_jump(JIT_JO);
+            break;
+
+        case OP_MUL:
+            jit_reg(0x0FAF, 1, JIT_RAX, JIT_RCX);
+            fix[fixes ++] = jit_jump(JIT_JO);
+            break;
+
+        default:
+            /* division by zero and LONG_MIN / -1 are up to GNU MP */
+            if(lit == JIT_NO_LIT) {
+                jit_reg(0x85, 1, JIT_RCX, JIT_RCX);
+                fix[fixes ++] = jit_jump(JIT_JE);
+                jit_alu(JIT_CMP, 1, JIT_RCX, -1);
+                fix[fixes ++] = jit_jump(JIT_JE);
+            }
+            jit_byte(0x48); jit_byte(0x99);         /* cqo */
+            jit_reg(0xF7, 1, 7, JIT_RCX);           /* idiv rcx */
+            if(op == OP_MOD)
+                jit_reg(0x89, 1, JIT_RDX, JIT_RAX);
+            break;
+    }
+
+    jit_mem(0x89, 1, JIT_RAX, JIT_R12, a + JIT_SMALL);
+
+    jit_cold(fix[0]);
+    for(i = 1; i < fixes; i ++)
+        jit_bind(fix[i]);
+
+slow_path:
+    jit_mem(0x8D, 1, JIT_RDI, JIT_R12, a);
+    jit_reg(0x89, 1, JIT_RDI, JIT_RSI);
+    if(lit == JIT_NO_LIT)
+        jit_mem(0x8D, 1, JIT_RDX, JIT_R12, b);
+    else
+        jit_movi(JIT_RDX, (long) &insn_lit[lit]);
+    jit_call(slow);
+
+    if(jit_current == JIT_COLD)
+        jit_resume();
+}
+
+/* rdx = exec_heap_cell(rax), for a (small) address in rax. Clobbers rax
+ * and rcx. The page accessed last is checked inline, others are looked
+ * up by pagedir_fault.
+ */
+static void jit_cell(void)
+{
+    unsigned int fix;
+
+    jit_reg(0x89, 1, JIT_RAX, JIT_RCX);
+    jit_reg(0xC1, 1, 5, JIT_RCX); jit_byte(PAGE_BITS); /* shr rcx, .. */
+    jit_mem(0x3B, 1, JIT_RCX, JIT_R14, offsetof(pagedir_t, last_number));
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x8B, 1, JIT_RDX, JIT_R14, offsetof(pagedir_t, last_page));
+
+    jit_cold(fix);
+    jit_reg(0x89, 1, JIT_RAX, JIT_RBP);
+    jit_reg(0x89, 1, JIT_R14, JIT_RDI);
+    jit_reg(0x89, 1, JIT_RCX, JIT_RSI);
+    jit_call(pagedir_fault);
+    jit_reg(0x89, 1, JIT_RAX, JIT_RDX);
+    jit_reg(0x89, 1, JIT_RBP, JIT_RAX);
+    jit_resume();
+
+    jit_alu(JIT_AND, 0, JIT_RAX, PAGE_CELLS - 1);
+    jit_reg(0xC1, 0, 4, JIT_RAX); jit_byte(JIT_CELL_SHIFT); /* shl eax, .. */
+    jit_reg(0x01, 1, JIT_RAX, JIT_RDX);
+}
+
+/* store the top item to the address below, pop both */
+static void jit_store(void)
+{
+    unsigned int fix;
+
+    jit_mem(0x83, 1, JIT_CMP, JIT_R12, JIT_TOP(1) + JIT_BIG); jit_byte(0);
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x8B, 1, JIT_RAX, JIT_R12, JIT_TOP(1) + JIT_SMALL);
+    jit_cell();
+    jit_swap_mem(JIT_RDX, 0, JIT_R12, JIT_TOP(0));
+
+    jit_cold(fix);
+    jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+    jit_call(jit_do_store);
+    jit_resume();
+
+    jit_drop(2);
+}
+
+/* replace the address on top by the value stored there */
+static void jit_retrieve(void)
+{
+    unsigned int fix, value;
+
+    jit_mem(0x83, 1, JIT_CMP, JIT_R12, JIT_TOP(0) + JIT_BIG); jit_byte(0);
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x8B, 1, JIT_RAX, JIT_R12, JIT_TOP(0) + JIT_SMALL);
+    jit_cell();
+    jit_mem(0x83, 1, JIT_CMP, JIT_RDX, JIT_BIG); jit_byte(0);
+    value = jit_jump(JIT_JNE);
+    jit_mem(0x8B, 1, JIT_RAX, JIT_RDX, JIT_SMALL);
+    jit_mem(0x89, 1, JIT_RAX, JIT_R12, JIT_TOP(0) + JIT_SMALL);
+
+    jit_cold(fix);
+    jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+    jit_call(jit_do_retrieve);
+    jit_resume();
+
+    jit_cold(value);
+    jit_mem(0x8D, 1, JIT_RDI, JIT_R12, JIT_TOP(0));
+    jit_reg(0x89, 1, JIT_RDX, JIT_RSI);
+    jit_call(jit_do_assign);
+    jit_resume();
+}
+
+/* push the value stored at address */
+static void jit_push_retrieve(long address)
+{
+    unsigned int fix;
+
+    jit_movi(JIT_RAX, address);
+    jit_cell();
+    jit_mem(0x8B, 1, JIT_RAX, JIT_RDX, JIT_BIG);
+    jit_mem(0x0B, 1, JIT_RAX, JIT_R12, JIT_BIG);
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x8B, 1, JIT_RAX, JIT_RDX, JIT_SMALL);
+    jit_mem(0x89, 1, JIT_RAX, JIT_R12, JIT_SMALL);
+
+    jit_cold(fix);
+    jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+    jit_reg(0x89, 1, JIT_RDX, JIT_RSI);
+    jit_call(jit_do_assign);
+    jit_resume();
+
+    jit_alu(JIT_ADD, 1, JIT_R12, sizeof(hybrid_t));
+}
+
+/* store the top item to address, pop it */
+static void jit_swap_store(long address)
+{
+    jit_movi(JIT_RAX, address);
+    jit_cell();
+    jit_swap_mem(JIT_RDX, 0, JIT_R12, JIT_TOP(0));
+    jit_drop(1);
+}
+
+/* jump to target, if the top item is zero (popping it, if pop is set) */
+static void jit_jz(unsigned int target, int pop)
+{
+    long top = pop ? 0 : JIT_TOP(0);
+    unsigned int fix;
+
+    if(pop) jit_drop(1);
+
+    /* big values are never zero */
+    jit_mem(0x83, 1, JIT_CMP, JIT_R12, top + JIT_BIG); jit_byte(0);
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x83, 1, JIT_CMP, JIT_R12, top + JIT_SMALL); jit_byte(0);
+    jit_jump_insn(JIT_JE, target);
+    jit_bind(fix);
+}
+
+/* jump to target, if the top item is negative (popping it, if pop is set) */
+static void jit_jn(unsigned int target, int pop)
+{
+    long top = pop ? 0 : JIT_TOP(0);
+    unsigned int fix;
+
+    if(pop) jit_drop(1);
+
+    jit_mem(0x8B, 1, JIT_RAX, JIT_R12, top + JIT_BIG);
+    jit_reg(0x85, 1, JIT_RAX, JIT_RAX);
+    fix = jit_jump(JIT_JNE);
+    jit_mem(0x83, 1, JIT_CMP, JIT_R12, top + JIT_SMALL); jit_byte(0);
+    jit_jump_insn(JIT_JL, target);
+
+    /* the sign of a GNU MP number is the sign of its size */
+    jit_cold(fix);
+    jit_mem(0x83, 0, JIT_CMP, JIT_RAX,
+            offsetof(hybrid_big_t, value[0]._mp_size)); jit_byte(0);
+    jit_jump_insn(JIT_JL, target);
+    jit_resume();
+}
+
+/* pop the top item, jump to target if it equals insn_lit[lit] */
+static void jit_jeq(unsigned int target, unsigned int lit)
+{
+    unsigned int fix;
+
+    jit_drop(1);
+
+    if(insn_lit[lit].big) {
+        jit_reg(0x89, 1, JIT_R12, JIT_RDI);
+        jit_movi(JIT_RSI, (long) &insn_lit[lit]);
+        jit_call(jit_do_cmp);
+        jit_reg(0x85, 0, JIT_RAX, JIT_RAX);
+        jit_jump_insn(JIT_JE, target);
+        return;
+    }
+
+    /* a big value never equals a small one */
+    jit_mem(0x83, 1, JIT_CMP, JIT_R12, JIT_BIG); jit_byte(0);
+    fix = jit_jump(JIT_JNE);
+    jit_movi(JIT_RAX, insn_lit[lit].small);
+    jit_mem(0x39, 1, JIT_RAX, JIT_R12, JIT_SMALL);
+    jit_jump_insn(JIT_JE, target);
+    jit_bind(fix);
+}
+
+/* return to the instruction on exec_bt, bail out at pos if it's empty */
+static void jit_ret(unsigned int pos)
+{
+    jit_call(jit_do_ret);
+    jit_alu(JIT_CMP, 0, JIT_RAX, -1);
+    jit_bail(JIT_JE, pos);
+
+    jit_reg(0x89, 0, JIT_RAX, JIT_RAX);             /* zero extend */
+    jit_movi(JIT_RCX, (long) jit_table);
+    jit_byte(0xFF); jit_byte(0x24); jit_byte(0xC1); /* jmp [rcx+rax*8] */
+}
+
+
+
+/* x86-64 encoding ************************************************************/
+static void jit_byte(unsigned int b)
+{
+    jit_section_t *s = &jit_sections[jit_current];
+
+    if(s->len == s->alloc) {
+        s->alloc = s->alloc ? s->alloc << 1 : 4096;
+        s->code = realloc(s->code, s->alloc);
+        assert(s->code);
+    }
+
+    s->code[s->len ++] = b;
+}
+
+static void jit_imm32(long v)
+{
+    unsigned int i;
+
+    for(i = 0; i < 32; i += 8)
+        jit_byte((unsigned long) v >> i & 0xff);
+}
+
+static void jit_imm64(unsigned long v)
+{
+    unsigned int i;
+
+    for(i = 0; i < 64; i += 8)
+        jit_byte(v >> i & 0xff);
+}
+
+/* the REX prefix (if any) and the opcode (one or two bytes) */
+static void jit_opcode(unsigned int op, int w, int reg, int rm)
+{
+    unsigned int rex = 0x40 | w << 3 | (reg & 8) >> 1 | (rm & 8) >> 3;
+
+    if(rex != 0x40) jit_byte(rex);
+    if(op > 0xff) jit_byte(op >> 8);
+    jit_byte(op & 0xff);
+}
+
+/* op reg, [base + disp] (64 bit, if w is set) */
+static void jit_mem(unsigned int op, int w, int reg, int base, long disp)
+{
+    unsigned int mod = disp == 0 && (base & 7) != JIT_RBP ? 0
+                     : disp >= -128 && disp <= 127 ? 1 : 2;
+
+    jit_opcode(op, w, reg, base);
+    jit_byte(mod << 6 | (reg & 7) << 3 | (base & 7));
+
+    if((base & 7) == JIT_RSP)
+        jit_byte(0x24); /* SIB, base only */
+
+    if(mod == 1)
+        jit_byte(disp & 0xff);
+    else if(mod == 2)
+        jit_imm32(disp);
+}
+
+/* op reg, rm (both registers) */
+static void jit_reg(unsigned int op, int w, int reg, int rm)
+{
+    jit_opcode(op, w, reg, rm);
+    jit_byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* ext (one of JIT_ADD to JIT_CMP) rm, imm */
+static void jit_alu(int ext, int w, int rm, long imm)
+{
+    if(imm >= -128 && imm <= 127) {
+        jit_reg(0x83, w, ext, rm);
+        jit_byte(imm & 0xff);
+    }
+    else {
+        jit_reg(0x81, w, ext, rm);
+        jit_imm32(imm);
+    }
+}
+
+/* mov reg, v */
+static void jit_movi(int reg, long v)
+{
+    if(v >= 0 && v <= 0xffffffffL) {
+        jit_opcode(0xB8 + (reg & 7), 0, 0, reg);    /* zero extended */
+        jit_imm32(v);
+    }
+    else if(v >= INT_MIN && v <= INT_MAX) {
+        jit_reg(0xC7, 1, 0, reg);                   /* sign extended */
+        jit_imm32(v);
+    }
+    else {
+        jit_opcode(0xB8 + (reg & 7), 1, 0, reg);
+        jit_imm64(v);
+    }
+}
+
+/* call fn, the stack is aligned (see jit_compile) */
+static void jit_call(void *fn)
+{
+    jit_movi(JIT_RAX, (long) fn);
+    jit_byte(0xFF); jit_byte(0xD0);                 /* call rax */
+}
+
+/* swap the 16 bytes at [base1 + disp1] and [base2 + disp2] */
+static void jit_swap_mem(int base1, long disp1, int base2, long disp2)
+{
+    jit_mem(0x8B, 1, JIT_RAX, base1, disp1);
+    jit_mem(0x8B, 1, JIT_RCX, base1, disp1 + 8);
+    jit_mem(0x8B, 1, JIT_RSI, base2, disp2);
+    jit_mem(0x8B, 1, JIT_RDI, base2, disp2 + 8);
+    jit_mem(0x89, 1, JIT_RSI, base1, disp1);
+    jit_mem(0x89, 1, JIT_RDI, base1, disp1 + 8);
+    jit_mem(0x89, 1, JIT_RAX, base2, disp2);
+    jit_mem(0x89, 1, JIT_RCX, base2, disp2 + 8);
+}
+
+
+
+/* jumps and sections *********************************************************/
+static unsigned int jit_pos(void)
+{
+    return jit_sections[jit_current].len
+        | (jit_current == JIT_COLD ? JIT_COLD_POS : 0);
+}
+
+/* RETURN: offset of pos within the linked code */
+static unsigned int jit_resolve(unsigned int pos)
+{
+    if(pos & JIT_COLD_POS)
+        return jit_sections[JIT_HOT].len + (pos & ~JIT_COLD_POS);
+
+    return pos;
+}
+
+/* emit a jump (a jcc, unless cc is JIT_JMP) with its target unknown yet
+ *
+ * RETURN: the fixup to bind the target to
+ */
+static unsigned int jit_jump(int cc)
+{
+    jit_fix_t *f;
+
+    if(cc == JIT_JMP)
+        jit_byte(0xE9);
+    else {
+        jit_byte(0x0F);
+        jit_byte(0x80 + cc);
+    }
+
+    if(jit_fixes_len == jit_fixes_alloc) {
+        jit_fixes_alloc = jit_fixes_alloc ? jit_fixes_alloc << 1 : 256;
+        jit_fixes = realloc(jit_fixes, jit_fixes_alloc * sizeof(*jit_fixes));
+        assert(jit_fixes);
+    }
+
+    f = &jit_fixes[jit_fixes_len];
+    f->at = jit_pos();
+    f->to = 0;
+    f->insn = 0;
+    jit_imm32(0);
+
+    return jit_fixes_len ++;
+}
+
+/* jump to the instruction at index pos */
+static void jit_jump_insn(int cc, unsigned int pos)
+{
+    unsigned int fix = jit_jump(cc);
+
+    jit_fixes[fix].to = pos;
+    jit_fixes[fix].insn = 1;
+}
+
+/* let fix jump to the current position */
+static void jit_bind(unsigned int fix)
+{
+    jit_fixes[fix].to = jit_pos();
+}
+
+/* continue in the cold section, where fix jumps to */
+static void jit_cold(unsigned int fix)
+{
+    jit_current = JIT_COLD;
+    jit_bind(fix);
+}
+
+/* jump back to the hot section, and continue there */
+static void jit_resume(void)
+{
+    unsigned int fix = jit_jump(JIT_JMP);
+
+    jit_current = JIT_HOT;
+    jit_bind(fix);
+}
+
+/* leave the compiled code, returning pos (if cc is met) */
+static void jit_bail(int cc, unsigned int pos)
+{
+    unsigned int fix = jit_jump(cc), current = jit_current;
+
+    jit_cold(fix);
+    jit_movi(JIT_RAX, pos);
+
+    /* jit_jump may move jit_fixes */
+    fix = jit_jump(JIT_JMP);
+    jit_fixes[fix].to = jit_epilogue;
+    jit_current = current;
+}
+
+
+
+/* runtime ********************************************************************/
+static hybrid_t *jit_do_require(hybrid_t *top, unsigned int n)
+{
+    exec_stack_len = top - jit_stack.base;
+    exec_stack_require(n);
+
+    jit_stack.base = exec_stack;
+    jit_stack.limit = exec_stack + exec_stack_alloc;
+    return exec_stack + exec_stack_len;
+}
+
+static void jit_do_assign(hybrid_t *dest, const hybrid_t *src)
+{
+    WSVAR_ASSIGN(*dest, *src);
+}
+
+static void jit_do_store(hybrid_t *top)
+{
+    long address = WSVAR_GET_SI(top[-2]);
+    exec_heap_move(address, top[-1]);
+}
+
+static void jit_do_retrieve(hybrid_t *top)
+{
+    long address = WSVAR_GET_SI(top[-1]);
+    exec_heap_read(address, top[-1]);
+}
+
+static void jit_do_input(const hybrid_t *item, int read_number)
+{
+    long address = WSVAR_GET_SI(*item);
+    interprt_input(exec_heap_cell(address), read_number);
+}
+
+static void jit_do_printc(const hybrid_t *item)
+{
+    putchar((int)WSVAR_GET_UI(*item) & 0xff);
+}
+
+static void jit_do_printn(const hybrid_t *item)
+{
+    WSVAR_PRINTF(*item);
+}
+
+static void jit_do_call(unsigned int next)
+{
+    exec_bt_push(next);
+}
+
+static void jit_do_tail_call(unsigned int next)
+{
+    if(! exec_bt_len) exec_bt_push(next);
+}
+
+static unsigned int jit_do_ret(void)
+{
+    return exec_bt_len ? exec_bt_pop() : UINT_MAX;
+}
+
+static int jit_do_cmp(const hybrid_t *a, const hybrid_t *b)
+{
+    return WSVAR_CMP(*a, *b);
+}
+
+#endif /* JIT_AVAILABLE */
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
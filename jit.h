@@ -0,0 +1,54 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * jit.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * compiling the decoded program to x86-64 machine code
+ */
+
+#ifndef _JIT_H
+#define _JIT_H
+
+#include "engine.h"
+
+/* we emit x86-64 code working on hybrid numbers, and need to make it
+ * executable
+ */
+#if defined(__x86_64__) && defined(WSVAR_HYBRID) && defined(HAVE_SYS_MMAN_H)
+#  define JIT_AVAILABLE 1
+#endif
+
+
+
+/* prototypes *****************************************************************/
+interprt_do_stat jit_run(void);
+
+/* jit_run compiles the decoded program to machine code (once) and runs
+ * it, just like engine_run would do. The code calls back into the
+ * interpreter's functions for input and output, for heap pages not
+ * accessed last and for numbers, that don't fit into a long.
+ *
+ * Whenever it comes across an error, an exit or a stack underflow, the
+ * compiled code leaves the instruction to engine_run, which reports it
+ * just like without jit_run. Without JIT_AVAILABLE, jit_run is
+ * engine_run, and so it is when engine_counts or engine_memoize is set,
+ * as the compiled code neither counts nor memoizes.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,382 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * memo.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * memoizing the results of pure subroutines
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memo.h"
+
+/* values of memo_t.state */
+#define MEMO_NONE    0  /* not a subroutine */
+#define MEMO_CALLED  1  /* a subroutine, we don't know about yet */
+#define MEMO_GUESS   2  /* need and out found, not proven yet */
+#define MEMO_PURE    3  /* proven to be pure, need and out are right */
+#define MEMO_IMPURE  4
+
+/* maximum number of instructions followed per subroutine, and of passes
+ * to find their needs
+ */
+#define MEMO_MAX_LEN    4096
+#define MEMO_MAX_PASSES 64
+
+#define MEMO_UNSEEN INT_MIN
+
+typedef struct {
+    unsigned int entry;     /* entry + 1 of the subroutine, 0 if unused */
+    long key[MEMO_MAX_NEED];
+    long result[MEMO_MAX_OUT];
+} memo_slot_t;
+
+memo_t *memo_table = NULL;
+unsigned int memo_return = 0;
+
+STACK_DEF(memo_frame_t, memo_frames, memo_frames_len, memo_frames_alloc)
+
+static memo_slot_t *memo_slots = NULL;
+
+/* stack depth at each instruction, relative to the subroutine's entry */
+static int *memo_depth = NULL;
+static unsigned int *memo_todo = NULL, *memo_seen = NULL;
+static unsigned int memo_todo_len, memo_seen_len;
+
+static int memo_follow(unsigned int entry, int strict,
+                       unsigned int *need, int *delta);
+static int memo_reach(unsigned int pos, int depth);
+static unsigned int memo_hash(unsigned int entry, const long *key,
+                              unsigned int need);
+
+
+
+/* void memo_program(void)
+ *
+ * find the pure subroutines
+ */
+void memo_program(void)
+{
+    unsigned int pos, pass, need;
+    int changed = 1, delta, found;
+
+    /* the instruction, pure subroutines called from the engine return
+     * to, it goes back to the caller then
+     */
+    if(! insn_len || insn[insn_len - 1].op != OP_MEMO_RET) {
+        insn_require(1);
+        memset(&insn[insn_len], 0, sizeof(*insn));
+        insn[insn_len].op = OP_MEMO_RET;
+        insn[insn_len].next = insn_len;
+        insn[insn_len].ws_ptr = insn_len ? insn[insn_len - 1].ws_ptr : 0;
+        memo_return = insn_len ++;
+    }
+
+    memo_table = realloc(memo_table, insn_len * sizeof(*memo_table));
+    memo_depth = realloc(memo_depth, insn_len * sizeof(*memo_depth));
+    memo_todo = realloc(memo_todo, insn_len * sizeof(*memo_todo));
+    memo_seen = realloc(memo_seen, insn_len * sizeof(*memo_seen));
+    assert(memo_table && memo_depth && memo_todo && memo_seen);
+
+    memset(memo_table, 0, insn_len * sizeof(*memo_table));
+    for(pos = 0; pos < insn_len; pos ++)
+        memo_depth[pos] = MEMO_UNSEEN;
+
+    /* first guess what each subroutine needs, skipping the calls of
+     * subroutines we don't know about yet
+     */
+    for(pos = 0; pos < insn_len; pos ++)
+        if(insn_is_call(insn[pos].op) && insn[pos].arg < insn_len)
+            memo_table[insn[pos].arg].state = MEMO_CALLED;
+
+    for(pass = 0; changed && pass < MEMO_MAX_PASSES; pass ++) {
+        changed = 0;
+
+        for(pos = 0; pos < insn_len; pos ++) {
+            memo_t *m = &memo_table[pos];
+
+            if(m->state != MEMO_CALLED && m->state != MEMO_GUESS) continue;
+            found = memo_follow(pos, 0, &need, &delta);
+
+            if(found < 0) {
+                m->state = MEMO_IMPURE;
+                changed = 1;
+            }
+            else if(found && (m->state != MEMO_GUESS || m->need != need
+                              || m->out != need + delta)) {
+                m->state = MEMO_GUESS;
+                m->need = need;
+                m->out = need + delta;
+                changed = 1;
+            }
+        }
+    }
+
+    /* now prove the guesses right, assuming those of the subroutines
+     * called are. Any wrong one might spoil others.
+     */
+    do {
+        changed = 0;
+
+        for(pos = 0; pos < insn_len; pos ++) {
+            memo_t *m = &memo_table[pos];
+
+            if(m->state != MEMO_GUESS) continue;
+
+            if(memo_follow(pos, 1, &need, &delta) <= 0
+               || m->need != need || m->out != need + delta) {
+                m->state = MEMO_IMPURE;
+                changed = 1;
+            }
+        }
+    } while(changed);
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        memo_t *m = &memo_table[pos];
+
+        if(m->state != MEMO_GUESS) continue;
+        m->state = MEMO_PURE;
+
+        if(insn[pos].block == BLOCK_CHECKED
+           || insn[pos].block == BLOCK_LEADER) {
+            m->leader = insn[pos].block == BLOCK_LEADER;
+            insn[pos].block = BLOCK_MEMO;
+        }
+    }
+}
+
+
+
+/* int memo_follow(unsigned int entry, int strict,
+ *                 unsigned int *need, int *delta)
+ *
+ * follow all the ways through the subroutine at entry, storing the
+ * number of items it needs to need and the change of the stack depth to
+ * delta. Calls of subroutines, we don't have a guess for, fail if strict
+ * is set, and aren't followed otherwise.
+ *
+ * RETURN: 1 if need and delta are right (for all the ways that return),
+ *         0 if no way returns, -1 if the subroutine isn't pure
+ */
+static int memo_follow(unsigned int entry, int strict,
+                       unsigned int *need, int *delta)
+{
+    unsigned int len = 0, n = 0;
+    int result = 1, returns = 0, ret = 0;
+
+    memo_todo_len = memo_seen_len = 0;
+    memo_reach(entry, 0);
+
+    while(memo_todo_len) {
+        const insn_t *in = &insn[memo_todo[-- memo_todo_len]];
+        int depth = memo_depth[in - insn], access = 0, change = 0;
+        const memo_t *callee;
+
+        if(++ len > MEMO_MAX_LEN) {
+            result = -1;
+            break;
+        }
+
+        switch(in->op) {
+            case OP_PUSH:
+                change = 1;
+                break;
+
+            case OP_DUP:
+                access = change = 1;
+                break;
+
+            case OP_COPY:
+            case OP_COPY_PUSH_SUB:
+            case OP_SLIDE:
+                if(in->arg >= MEMO_MAX_NEED + MEMO_MAX_LEN) {
+                    result = -1;
+                    break;
+                }
+
+                access = in->arg + 1;
+                change = in->op == OP_SLIDE ? -(int) in->arg : 1;
+                break;
+
+            case OP_SWAP:
+                access = 2;
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                access = 2;
+                change = -1;
+                break;
+
+            case OP_DISCARD:
+                access = 1;
+                change = -1;
+                break;
+
+            case OP_PUSH_ADD:
+            case OP_PUSH_SUB:
+            case OP_SHL:
+            case OP_DIV_POW2:
+            case OP_MOD_POW2:
+                access = 1;
+                break;
+
+            case OP_LABEL:
+            case OP_NOP:
+                break;
+
+            case OP_JZ:
+            case OP_JN:
+            case OP_PUSH_SUB_JZ:
+            case OP_DUP_JZ:
+            case OP_DUP_JN:
+                access = 1;
+                change = in->op == OP_DUP_JZ || in->op == OP_DUP_JN ? 0 : -1;
+                if(! memo_reach(in->arg, depth + change)) result = -1;
+                break;
+
+            case OP_JUMP:
+                if(! memo_reach(in->arg, depth)) result = -1;
+                continue;
+
+            case OP_CALL:
+            case OP_TAIL_CALL:
+                callee = &memo_table[in->arg];
+
+                if(callee->state == MEMO_IMPURE
+                   || (callee->state != MEMO_GUESS && strict)) {
+                    result = -1;
+                    break;
+                }
+
+                /* the way goes on, once we know about the callee */
+                if(callee->state != MEMO_GUESS) continue;
+
+                access = callee->need;
+                change = callee->out - callee->need;
+
+                if(in->op == OP_CALL) break;
+                /* fall through, the callee returns for us */
+            case OP_RET:
+            case OP_JUMP_RET:
+                if(access - depth > (int) n) n = access - depth;
+
+                if(returns ++ && ret != depth + change) result = -1;
+                ret = depth + change;
+                continue;
+
+            default: /* heap access, i/o, anything that stops */
+                result = -1;
+                break;
+        }
+
+        if(result < 0) break;
+
+        if(access - depth > (int) n) n = access - depth;
+        if(n > MEMO_MAX_NEED || ! memo_reach(in->next, depth + change)) {
+            result = -1;
+            break;
+        }
+    }
+
+    /* clean up for the next subroutine */
+    while(memo_seen_len)
+        memo_depth[memo_seen[-- memo_seen_len]] = MEMO_UNSEEN;
+
+    if(result < 0 || n > MEMO_MAX_NEED) return -1;
+    if(! returns) return 0;
+    if((int) n + ret < 0 || (int) n + ret > MEMO_MAX_OUT) return -1;
+
+    *need = n;
+    *delta = ret;
+    return 1;
+}
+
+
+
+/* int memo_reach(unsigned int pos, int depth)
+ *
+ * queue instruction pos, which we get to with the stack at depth
+ *
+ * RETURN: 1 on success, 0 if we've got there at another depth before
+ */
+static int memo_reach(unsigned int pos, int depth)
+{
+    if(pos >= insn_len) return 0;
+
+    if(memo_depth[pos] == MEMO_UNSEEN) {
+        memo_depth[pos] = depth;
+        memo_todo[memo_todo_len ++] = pos;
+        memo_seen[memo_seen_len ++] = pos;
+        return 1;
+    }
+
+    return memo_depth[pos] == depth;
+}
+
+
+
+/* results ********************************************************************/
+static unsigned int memo_hash(unsigned int entry, const long *key,
+                              unsigned int need)
+{
+    unsigned long h = entry;
+    unsigned int i;
+
+    for(i = 0; i < need; i ++)
+        h = (h ^ (unsigned long) key[i]) * 0x9E3779B1UL;
+
+    return (unsigned int) (h ^ (h >> 16)) & (MEMO_SLOTS - 1);
+}
+
+const long *memo_lookup(unsigned int entry, const long *key)
+{
+    unsigned int need = memo_table[entry].need;
+    const memo_slot_t *s;
+
+    if(! memo_slots) return NULL;
+
+    s = &memo_slots[memo_hash(entry, key, need)];
+    if(s->entry != entry + 1 || memcmp(s->key, key, need * sizeof(*key)))
+        return NULL;
+
+    return s->result;
+}
+
+void memo_store(unsigned int entry, const long *key, const long *result)
+{
+    const memo_t *m = &memo_table[entry];
+    memo_slot_t *s;
+
+    if(! memo_slots) {
+        memo_slots = calloc(MEMO_SLOTS, sizeof(*memo_slots));
+        assert(memo_slots);
+    }
+
+    s = &memo_slots[memo_hash(entry, key, m->need)];
+    s->entry = entry + 1;
+    memcpy(s->key, key, m->need * sizeof(*key));
+    memcpy(s->result, result, m->out * sizeof(*result));
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,86 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * memo.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * memoizing the results of pure subroutines
+ */
+
+#ifndef _MEMO_H
+#define _MEMO_H
+
+#include "decode.h"
+
+/* a pure subroutine takes at most MEMO_MAX_NEED items from the stack
+ * and leaves at most MEMO_MAX_OUT there
+ */
+#define MEMO_MAX_NEED 4
+#define MEMO_MAX_OUT  4
+
+/* number of results kept, older ones are replaced */
+#define MEMO_SLOTS    (1U << 16)
+
+/* per subroutine information, indexed by the subroutine's entry */
+typedef struct {
+    unsigned char state;    /* one of MEMO_*, see memo.c */
+    unsigned char leader;   /* it's been a BLOCK_LEADER before */
+    unsigned char need;     /* items the subroutine takes */
+    unsigned char out;      /* items it leaves in their place */
+} memo_t;
+
+extern memo_t *memo_table;
+
+/* index of the OP_MEMO_RET instruction */
+extern unsigned int memo_return;
+
+
+
+/* memo_frames stack **********************************************************/
+typedef struct {
+    unsigned int entry;     /* the subroutine called */
+    unsigned int ret;       /* the instruction to return to */
+    unsigned int depth;     /* exec_stack_len on entry */
+    long key[MEMO_MAX_NEED];
+} memo_frame_t;
+
+STACK_DEF_EXT(memo_frame_t, memo_frames, memo_frames_len, memo_frames_alloc)
+
+/* the calls of pure subroutines, that haven't returned yet. Their return
+ * address on exec_bt has been replaced by memo_return.
+ */
+
+
+
+/* prototypes *****************************************************************/
+void memo_program(void);
+const long *memo_lookup(unsigned int entry, const long *key);
+void memo_store(unsigned int entry, const long *key, const long *result);
+
+/* memo_program looks for subroutines, that work on the topmost items of
+ * the stack only (and always on the same number of them), neither touch
+ * the heap nor do any i/o and call nothing but such subroutines. Their
+ * entries are marked BLOCK_MEMO. The first time it's called,
+ * memo_program appends the OP_MEMO_RET instruction to the program.
+ *
+ * memo_lookup returns the items (item 0 being the top) a call of the
+ * subroutine at entry left, given the items it's been called with are
+ * key (NULL if we don't know). memo_store remembers them.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,567 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * native.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * running blocks of GNU MP builds on native integers
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "native.h"
+
+#ifdef NATIVE_REGIONS
+
+/* maximum number of stack items a native block may take from the stack,
+ * as well as push onto it
+ */
+#define NATIVE_MAX_DEPTH 32
+
+/* values within a native block have less than NATIVE_MAX_BITS bits
+ * (plus sign), i.e. they fit into a long
+ */
+#define NATIVE_MAX_BITS 63
+
+/* does mpz_t v have less than bits bits (bits < 64)? */
+#define NATIVE_FITS(v,bits) \
+    (mpz_size(v) == 0 \
+     || (mpz_size(v) == 1 && ! (mpz_getlimbn((v), 0) >> (bits))))
+
+/* what WSVAR_GET_UI would return for the native value v */
+#define NATIVE_GET_UI(v) \
+    ((v) < 0 ? 0UL - (unsigned long) (v) : (unsigned long) (v))
+
+/* per block information, indexed by the block's first instruction */
+typedef struct {
+    unsigned char inputs;  /* number of stack items the block starts with */
+    unsigned char bits;    /* they (and retrieved values) must be below
+                            * 2^bits */
+} native_info_t;
+
+static native_info_t *native_info = NULL;
+
+static int native_analyze(unsigned int pos, unsigned int bits);
+static unsigned int native_bits(const WSVAR_TYPE v);
+static void native_flush(const long *st, unsigned int sp, unsigned int keep,
+                         unsigned int base);
+
+
+
+/* void native_program(void)
+ *
+ * find the blocks, that can be run on native integers
+ */
+void native_program(void)
+{
+    unsigned int pos, bits;
+
+    native_info = realloc(native_info, insn_len * sizeof(*native_info));
+    assert(native_info);
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        if(insn[pos].block != BLOCK_LEADER) continue;
+
+        /* the larger the bound of the inputs, the more often we'll stay
+         * native at runtime, try the largest one that works
+         */
+        for(bits = NATIVE_MAX_BITS - 1; bits; bits --)
+            if(native_analyze(pos, bits)) break;
+
+        if(! bits) continue;
+
+        native_info[pos].bits = bits;
+        insn[pos].block = BLOCK_NATIVE;
+    }
+}
+
+
+
+/* int native_analyze(unsigned int pos, unsigned int bits)
+ *
+ * follow the block starting at pos, and keep track of how many bits the
+ * values on the stack have at most (assuming, that the items the block
+ * starts with and retrieved values have less than bits bits).
+ *
+ * RETURN: 1 if all values fit into a long and the block does some
+ *         arithmetic at all (otherwise it's not worth it), 0 if not
+ */
+static int native_analyze(unsigned int pos, unsigned int bits)
+{
+    /* the block's entry is at NATIVE_MAX_DEPTH, below are its inputs */
+    unsigned int st[2 * NATIVE_MAX_DEPTH];
+    unsigned int sp = NATIVE_MAX_DEPTH, low = sp, i, arith = 0;
+    const insn_t *in = &insn[pos];
+
+#define NEED(n)     if(sp < (n)) return 0; \
+                    if(sp - (n) < low) low = sp - (n)
+#define PUSH(b)     if(sp == 2 * NATIVE_MAX_DEPTH) return 0; \
+                    i = (b); \
+                    st[sp ++] = i
+#define LIT(n)      native_bits(insn_lit[n])
+#define MAX(a,b)    ((a) > (b) ? (a) : (b))
+#define MIN(a,b)    ((a) < (b) ? (a) : (b))
+
+    for(i = 0; i < sp; i ++)
+        st[i] = bits;
+
+    for(;;) {
+        switch(in->op) {
+            case OP_PUSH:
+                PUSH(LIT(in->arg));
+                break;
+
+            case OP_DUP:
+                NEED(1);
+                PUSH(st[sp - 1]);
+                break;
+
+            case OP_COPY:
+                if(in->arg >= NATIVE_MAX_DEPTH) return 0;
+                NEED(in->arg + 1);
+                PUSH(st[sp - 1 - in->arg]);
+                break;
+
+            case OP_SWAP:
+                NEED(2);
+                i = st[sp - 1];
+                st[sp - 1] = st[sp - 2];
+                st[sp - 2] = i;
+                break;
+
+            case OP_SLIDE:
+                if(in->arg >= NATIVE_MAX_DEPTH) return 0;
+                NEED(in->arg + 1);
+                st[sp - 1 - in->arg] = st[sp - 1];
+                sp -= in->arg;
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+                NEED(2);
+                sp --;
+                st[sp - 1] = MAX(st[sp - 1], st[sp]) + 1;
+                arith ++;
+                break;
+
+            case OP_MUL:
+                NEED(2);
+                sp --;
+                st[sp - 1] += st[sp];
+                arith ++;
+                break;
+
+            case OP_DIV: /* |a / b| <= |a| */
+                NEED(2);
+                sp --;
+                arith ++;
+                break;
+
+            case OP_MOD: /* |a % b| < |b| and <= |a| */
+                NEED(2);
+                sp --;
+                st[sp - 1] = MIN(st[sp - 1], st[sp]);
+                arith ++;
+                break;
+
+            case OP_STORE:
+                NEED(2);
+                sp -= 2;
+                break;
+
+            case OP_RETRIEVE:
+                NEED(1);
+                st[sp - 1] = bits;
+                break;
+
+            case OP_DISCARD:
+            case OP_JZ:
+            case OP_JN:
+            case OP_PRINTC:
+            case OP_PRINTN:
+            case OP_READC:
+            case OP_READN:
+            case OP_PUSH_SWAP_STORE:
+                NEED(1);
+                sp --;
+                break;
+
+            case OP_LABEL:
+            case OP_CALL:
+            case OP_JUMP:
+            case OP_RET:
+            case OP_EXIT:
+            case OP_TAIL_CALL:
+            case OP_JUMP_RET:
+                break;
+
+            case OP_PUSH_ADD:
+            case OP_PUSH_SUB:
+                NEED(1);
+                st[sp - 1] = MAX(st[sp - 1], LIT(in->arg)) + 1;
+                arith ++;
+                break;
+
+            case OP_PUSH_RETRIEVE:
+                PUSH(bits);
+                break;
+
+            case OP_DUP_JZ:
+            case OP_DUP_JN:
+                NEED(1);
+                break;
+
+            case OP_COPY_PUSH_SUB:
+                if(in->arg >= NATIVE_MAX_DEPTH) return 0;
+                NEED(in->arg + 1);
+                PUSH(MAX(st[sp - 1 - in->arg], LIT(in->arg2)) + 1);
+                arith ++;
+                break;
+
+            case OP_PUSH_SUB_JZ:
+                NEED(1);
+                if(LIT(in->arg2) >= NATIVE_MAX_BITS) return 0;
+                sp --;
+                arith ++;
+                break;
+
+            case OP_SHL:
+                NEED(1);
+                st[sp - 1] += in->arg2;
+                arith ++;
+                break;
+
+            case OP_DIV_POW2:
+                NEED(1);
+                arith ++;
+                break;
+
+            case OP_MOD_POW2:
+                NEED(1);
+                st[sp - 1] = MIN(st[sp - 1], in->arg2);
+                arith ++;
+                break;
+
+            default: /* pseudo instructions */
+                return 0;
+        }
+
+        if(sp && st[sp - 1] >= NATIVE_MAX_BITS)
+            return 0;
+
+        if(in->next >= insn_len || insn[in->next].block != BLOCK_BODY
+           || in->op == OP_CALL || in->op == OP_JUMP || in->op == OP_RET
+           || in->op == OP_EXIT || in->op == OP_TAIL_CALL
+           || in->op == OP_JUMP_RET)
+            break;
+
+        in = &insn[in->next];
+    }
+
+#undef NEED
+#undef PUSH
+#undef LIT
+#undef MAX
+#undef MIN
+
+    native_info[pos].inputs = NATIVE_MAX_DEPTH - low;
+    return arith != 0;
+}
+
+
+
+/* unsigned int native_bits(const WSVAR_TYPE v)
+ *
+ * RETURN: number of bits of |v|
+ */
+static unsigned int native_bits(const WSVAR_TYPE v)
+{
+    return mpz_sgn(v) ? mpz_sizeinbase(v, 2) : 0;
+}
+
+
+
+/* const insn_t *native_run(const insn_t *ip, int *deopt)
+ *
+ * run the native block starting at ip
+ *
+ * RETURN: instruction to continue with
+ */
+const insn_t *native_run(const insn_t *ip, int *deopt)
+{
+    const native_info_t *info = &native_info[ip - insn];
+    long st[2 * NATIVE_MAX_DEPTH];
+    unsigned int sp, keep, base;
+    mpz_ptr cell;
+
+    *deopt = 1;
+
+    if(exec_stack_len < info->inputs)
+        return ip;
+
+    base = exec_stack_len - info->inputs;
+
+    for(sp = 0; sp < info->inputs; sp ++) {
+        if(! NATIVE_FITS(exec_stack[base + sp], info->bits))
+            return ip;
+
+        st[sp] = mpz_get_si(exec_stack[base + sp]);
+    }
+
+    /* the items below keep haven't been touched, no need to write them
+     * back to exec_stack
+     */
+    keep = sp;
+
+#define POP(n)      { sp -= (n); if(sp < keep) keep = sp; }
+#define LIT(n)      mpz_get_si(insn_lit[n])
+#define LEAVE(t)    { *deopt = 0; native_flush(st, sp, keep, base); return (t); }
+#define DEOPT()     { native_flush(st, sp, keep, base); return ip; }
+
+    do {
+        switch(ip->op) {
+            case OP_PUSH:
+                st[sp ++] = LIT(ip->arg);
+                break;
+
+            case OP_DUP:
+                st[sp] = st[sp - 1];
+                sp ++;
+                break;
+
+            case OP_COPY:
+                st[sp] = st[sp - 1 - ip->arg];
+                sp ++;
+                break;
+
+            case OP_SWAP: {
+                long swap = st[sp - 1];
+
+                st[sp - 1] = st[sp - 2];
+                st[sp - 2] = swap;
+                POP(2);
+                sp += 2;
+                break;
+            }
+
+            case OP_SLIDE: {
+                long top = st[sp - 1];
+
+                POP(ip->arg + 1);
+                st[sp ++] = top;
+                break;
+            }
+
+            case OP_ADD:
+                POP(2);
+                st[sp] += st[sp + 1];
+                sp ++;
+                break;
+
+            case OP_SUB:
+                POP(2);
+                st[sp] -= st[sp + 1];
+                sp ++;
+                break;
+
+            case OP_MUL:
+                POP(2);
+                st[sp] *= st[sp + 1];
+                sp ++;
+                break;
+
+            case OP_DIV:
+                if(! st[sp - 1]) DEOPT();
+                POP(2);
+                st[sp] /= st[sp + 1];
+                sp ++;
+                break;
+
+            case OP_MOD:
+                if(! st[sp - 1]) DEOPT();
+                POP(2);
+                st[sp] %= st[sp + 1];
+                sp ++;
+                break;
+
+            case OP_STORE:
+                mpz_set_si(*exec_heap_cell(st[sp - 2]), st[sp - 1]);
+                POP(2);
+                break;
+
+            case OP_RETRIEVE:
+                cell = *exec_heap_cell(st[sp - 1]);
+                if(! NATIVE_FITS(cell, info->bits)) DEOPT();
+
+                POP(1);
+                st[sp ++] = mpz_get_si(cell);
+                break;
+
+            case OP_DISCARD:
+                POP(1);
+                break;
+
+            case OP_LABEL:
+                break;
+
+            case OP_CALL:
+                exec_bt_push(ip->next);
+                LEAVE(&insn[ip->arg]);
+
+            case OP_JUMP:
+                LEAVE(&insn[ip->arg]);
+
+            case OP_JZ:
+                POP(1);
+                if(! st[sp]) LEAVE(&insn[ip->arg]);
+                break;
+
+            case OP_JN:
+                POP(1);
+                if(st[sp] < 0) LEAVE(&insn[ip->arg]);
+                break;
+
+            case OP_RET:
+                if(! exec_bt_len) DEOPT();
+                LEAVE(&insn[exec_bt_pop()]);
+
+            case OP_TAIL_CALL:
+                if(! exec_bt_len) exec_bt_push(ip->next);
+                LEAVE(&insn[ip->arg]);
+
+            case OP_JUMP_RET:
+                if(! exec_bt_len) LEAVE(&insn[ip->arg]);
+                LEAVE(&insn[exec_bt_pop()]);
+
+            case OP_PRINTC:
+                POP(1);
+                putchar((int) NATIVE_GET_UI(st[sp]) & 0xff);
+                break;
+
+            case OP_PRINTN:
+                POP(1);
+                printf("%ld", st[sp]);
+                break;
+
+            case OP_READC:
+            case OP_READN:
+                interprt_input(exec_heap_cell(st[sp - 1]), ip->op == OP_READN);
+                POP(1);
+                break;
+
+            case OP_PUSH_ADD:
+                POP(1);
+                st[sp] += LIT(ip->arg);
+                sp ++;
+                break;
+
+            case OP_PUSH_SUB:
+                POP(1);
+                st[sp] -= LIT(ip->arg);
+                sp ++;
+                break;
+
+            case OP_PUSH_RETRIEVE:
+                cell = *exec_heap_cell((int) ip->arg2);
+                if(! NATIVE_FITS(cell, info->bits)) DEOPT();
+
+                st[sp ++] = mpz_get_si(cell);
+                break;
+
+            case OP_PUSH_SWAP_STORE:
+                mpz_set_si(*exec_heap_cell((int) ip->arg2), st[sp - 1]);
+                POP(1);
+                break;
+
+            case OP_DUP_JZ:
+                if(! st[sp - 1]) LEAVE(&insn[ip->arg]);
+                break;
+
+            case OP_DUP_JN:
+                if(st[sp - 1] < 0) LEAVE(&insn[ip->arg]);
+                break;
+
+            case OP_COPY_PUSH_SUB:
+                st[sp] = st[sp - 1 - ip->arg] - LIT(ip->arg2);
+                sp ++;
+                break;
+
+            case OP_PUSH_SUB_JZ:
+                POP(1);
+                if(st[sp] == LIT(ip->arg2)) LEAVE(&insn[ip->arg]);
+                break;
+
+            case OP_SHL:
+                POP(1);
+                st[sp] *= 1L << ip->arg2;
+                sp ++;
+                break;
+
+            case OP_DIV_POW2:
+                POP(1);
+                st[sp] /= 1L << ip->arg2;
+                sp ++;
+                break;
+
+            case OP_MOD_POW2:
+                POP(1);
+                st[sp] %= 1L << ip->arg2;
+                sp ++;
+                break;
+
+            default: /* OP_EXIT, let the engine stop */
+                DEOPT();
+        }
+
+        ip = &insn[ip->next];
+    } while(ip->block == BLOCK_BODY);
+
+#undef POP
+#undef LIT
+#undef LEAVE
+#undef DEOPT
+
+    /* fell through to the next block */
+    *deopt = 0;
+    native_flush(st, sp, keep, base);
+    return ip;
+}
+
+
+
+/* void native_flush(const long *st, unsigned int sp, unsigned int keep,
+ *                   unsigned int base)
+ *
+ * write the native stack items keep to sp back to exec_stack, which
+ * holds the block's inputs from base on
+ */
+static void native_flush(const long *st, unsigned int sp, unsigned int keep,
+                         unsigned int base)
+{
+    exec_stack_len = base + keep;
+    exec_stack_require(sp - keep);
+
+    for(; keep < sp; keep ++)
+        mpz_set_si(exec_stack[base + keep], st[keep]);
+
+    exec_stack_len = base + sp;
+}
+
+#endif /* NATIVE_REGIONS */
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
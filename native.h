@@ -0,0 +1,59 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * native.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * running blocks of GNU MP builds on native integers
+ */
+
+#ifndef _NATIVE_H
+#define _NATIVE_H
+
+#include <limits.h>
+#include "decode.h"
+
+/* only GNU MP builds need this (hybrid ones already keep small numbers in
+ * a long), and we need a long, that holds 63 bits (plus sign) as well as
+ * limbs of at least 64 bits.
+ */
+#if defined(HAVE_LIBGMP) && ! defined(WSVAR_HYBRID) && LONG_MAX > 2147483647L && GMP_NUMB_BITS >= 64
+#  define NATIVE_REGIONS 1
+#endif
+
+
+
+/* prototypes *****************************************************************/
+#ifdef NATIVE_REGIONS
+void native_program(void);
+const insn_t *native_run(const insn_t *ip, int *deopt);
+#endif
+
+/* native_program looks at the blocks verify_program found. If it can
+ * prove, that all values within a block fit into a long (given that the
+ * stack items the block starts with and the heap cells it retrieves are
+ * below some bound), the block is marked BLOCK_NATIVE.
+ *
+ * native_run runs such a block on native integers, starting at its first
+ * instruction ip, and converts the values back to GNU MP when leaving
+ * it. It returns the instruction to go on with. If deopt is set, some
+ * value didn't fit (or an error is about to happen), the instruction
+ * returned has to be run by the ordinary, checked handler then.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
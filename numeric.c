@@ -0,0 +1,193 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * numeric.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * numeric backends of the execution engine
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include "numeric.h"
+
+static const char *const numeric_names[NUMERIC_LAST] = {
+#ifdef HAVE_LIBGMP
+    /* NUMERIC_BUILTIN */ "gmp",
+#else
+    /* NUMERIC_BUILTIN */ "int",
+#endif
+    /* NUMERIC_INT32   */ "int32",
+    /* NUMERIC_INT64   */ "int64",
+    /* NUMERIC_INT128  */ "int128"
+};
+
+/* bits of the numbers, the heap's been loaded with before running */
+unsigned int numeric_heap_bits = 0;
+
+#ifdef HAVE_LIBGMP
+static unsigned int numeric_bits(WSVAR_TYPE *v);
+
+/* literals of more bits don't fit into any native backend */
+#define NUMERIC_MAX_BITS 128
+#endif
+
+
+
+/* numeric_backend numeric_lookup(const char *name)
+ *
+ * RETURN: the backend called name, NUMERIC_LAST if there's none
+ */
+numeric_backend numeric_lookup(const char *name)
+{
+    numeric_backend backend;
+
+    for(backend = NUMERIC_BUILTIN; backend < NUMERIC_LAST; backend ++)
+        if(! strcmp(name, numeric_names[backend]))
+            break;
+
+#ifndef __SIZEOF_INT128__
+    if(backend == NUMERIC_INT128)
+        return NUMERIC_LAST;
+#endif
+
+    return backend;
+}
+
+
+
+/* const char *numeric_name(numeric_backend backend)
+ *
+ * RETURN: the name of backend, as understood by numeric_lookup
+ */
+const char *numeric_name(numeric_backend backend)
+{
+    assert(backend < NUMERIC_LAST);
+    return numeric_names[backend];
+}
+
+
+
+/* numeric_backend numeric_choose(void)
+ *
+ * pick the backend to run the decoded program with
+ */
+numeric_backend numeric_choose(void)
+{
+#ifdef HAVE_LIBGMP
+    /* readc gives -1 ... 255, the heap's cells are loaded with numbers
+     * of numeric_heap_bits, anything else comes from the literals.
+     * Without add, sub, mul and readn, none of the instructions yields
+     * a number of more bits than its operands have (div and mod round
+     * towards zero), so the biggest literal tells the size.
+     */
+    unsigned int i, bits = 9;
+
+    if(numeric_heap_bits > bits) bits = numeric_heap_bits;
+
+    for(i = 0; i < insn_len; i ++)
+        switch(insn[i].op) {
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_READN:
+            case OP_PUSH_ADD:
+            case OP_PUSH_SUB:
+            case OP_COPY_PUSH_SUB:
+            case OP_SHL:
+                return NUMERIC_BUILTIN;
+        }
+
+    for(i = 0; i < insn_lit_len && bits < NUMERIC_MAX_BITS; i ++) {
+        unsigned int lit_bits = numeric_bits(&insn_lit[i]);
+        if(lit_bits > bits) bits = lit_bits;
+    }
+
+    /* the sign takes a bit as well */
+    if(bits < 32)
+        return NUMERIC_INT32;
+
+    if(bits < 64)
+        return NUMERIC_INT64;
+
+#ifdef __SIZEOF_INT128__
+    if(bits < 128)
+        return NUMERIC_INT128;
+#endif
+#endif /* HAVE_LIBGMP */
+
+    return NUMERIC_BUILTIN;
+}
+
+
+
+/* interprt_do_stat numeric_run(numeric_backend backend)
+ *
+ * run the decoded program with the engine of backend
+ */
+interprt_do_stat numeric_run(numeric_backend backend)
+{
+    switch(backend) {
+        case NUMERIC_INT32:
+            return engine_int32_run();
+
+        case NUMERIC_INT64:
+            return engine_int64_run();
+
+#ifdef __SIZEOF_INT128__
+        case NUMERIC_INT128:
+            return engine_int128_run();
+#endif
+
+        default:
+            return engine_run();
+    }
+}
+
+
+
+#ifdef HAVE_LIBGMP
+/* unsigned int numeric_bits(WSVAR_TYPE *v)
+ *
+ * RETURN: number of bits of the absolute value of v, at most
+ *         NUMERIC_MAX_BITS
+ */
+static unsigned int numeric_bits(WSVAR_TYPE *v)
+{
+    unsigned int bits = 0;
+    WSVAR_TYPE rest;
+
+    WSVAR_INIT(rest);
+
+    if(WSVAR_CMP_ZERO(*v) < 0)
+        WSVAR_NEG(rest, *v);
+    else
+        WSVAR_ASSIGN(rest, *v);
+
+    for(; WSVAR_CMP_ZERO(rest) && bits < NUMERIC_MAX_BITS; bits ++)
+        WSVAR_DIV_2EXP(rest, rest, 1);
+
+    WSVAR_CLEAR(rest);
+    return bits;
+}
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,65 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * numeric.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * numeric backends of the execution engine
+ */
+
+#ifndef _NUMERIC_H
+#define _NUMERIC_H
+
+#include "engine.h"
+
+
+
+/* numeric backends ***********************************************************/
+typedef enum {
+    NUMERIC_BUILTIN,    /* WSVAR_TYPE, i.e. GNU MP (if available) or int */
+    NUMERIC_INT32,
+    NUMERIC_INT64,
+    NUMERIC_INT128,     /* only if the compiler supports __int128 */
+
+    NUMERIC_LAST
+} numeric_backend;
+
+
+
+/* prototypes *****************************************************************/
+numeric_backend numeric_lookup(const char *name);
+const char *numeric_name(numeric_backend backend);
+numeric_backend numeric_choose(void);
+interprt_do_stat numeric_run(numeric_backend backend);
+
+extern unsigned int numeric_heap_bits;
+
+/* numeric_lookup returns the backend called name (one of gmp or int,
+ * int32, int64 and int128), NUMERIC_LAST if there is no such backend.
+ *
+ * numeric_choose picks the backend to use, if the user didn't tell. It's
+ * a native one only, if the decoded program provably never calculates
+ * anything, that doesn't fit (i.e. results always stay exact), otherwise
+ * it's the builtin one. If the heap's cells are set up before running
+ * (see load_heap), numeric_heap_bits has to tell the size of the numbers.
+ *
+ * numeric_run runs the decoded program with the backend's engine, see
+ * engine_run.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,357 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * optimize.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * optimizer of the decoded instruction stream
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "optimize.h"
+
+/* largest power of two, we replace multiplication etc. by, must fit
+ * into a signed int (for the non-GMP WSVAR_MUL_2EXP etc.)
+ */
+#define OPTIMIZE_MAX_SHIFT 30
+
+/* what optimize_program did */
+static unsigned int optimize_unreachable;
+static unsigned int optimize_labels;
+static unsigned int optimize_folded;
+static unsigned int optimize_reduced;
+
+static void optimize_reachable(void);
+static void optimize_constants(void);
+static void optimize_strength(void);
+static unsigned int optimize_live(unsigned int pos);
+static void optimize_remove(unsigned int pos, unsigned char *entry);
+static int optimize_fold(unsigned int first, unsigned int second,
+                         insn_op op);
+static int optimize_log2(unsigned int lit);
+
+
+
+/* void optimize_program(int wrapping)
+ *
+ * run all the optimization passes on the decoded program
+ */
+void optimize_program(int wrapping)
+{
+    optimize_unreachable = optimize_labels = 0;
+    optimize_folded = optimize_reduced = 0;
+
+    optimize_reachable();
+
+    /* we calculate with the builtin numbers, they'd give other results
+     * than a backend wrapping around (or cutting the literals)
+     */
+    if(! wrapping)
+        optimize_constants();
+
+    decode_compact();
+
+    if(wrapping)
+        return;
+
+    /* needs the compacted program, the replaced push must be right in
+     * front of the arithmetic instruction (for the engine to fall back)
+     */
+    optimize_strength();
+}
+
+
+
+/* void optimize_reachable(void)
+ *
+ * remove all instructions, that cannot be reached from the start of
+ * the program, as well as all the labels. The labels are no-ops anyway,
+ * since decode_program resolved the jumps to the instruction behind them.
+ */
+static void optimize_reachable(void)
+{
+    unsigned int pos, todo_len = 0, end = 0;
+    unsigned int *todo = malloc((2 * insn_len + 1) * sizeof(*todo));
+    unsigned char *reached = calloc(insn_len, 1);
+    assert(todo && reached);
+
+    todo[todo_len ++] = 0;
+
+    while(todo_len) {
+        insn_t *in = &insn[pos = todo[-- todo_len]];
+
+        if(reached[pos]) continue;
+        reached[pos] = 1;
+
+        switch(in->op) {
+            case OP_JUMP:
+                todo[todo_len ++] = in->arg;
+                break;
+
+            case OP_CALL: /* the subroutine might return */
+            case OP_JZ:
+            case OP_JN:
+                todo[todo_len ++] = in->arg;
+                todo[todo_len ++] = in->next;
+                break;
+
+            case OP_RET:
+            case OP_EXIT:
+            case OP_END:
+            case OP_NO_LABEL:
+            case OP_SYNTAX_ERROR:
+                break;
+
+            default:
+                todo[todo_len ++] = in->next;
+                break;
+        }
+    }
+
+    while(insn[end].op != OP_END) end ++;
+
+    /* OP_END and the traps behind it stay in any case */
+    for(pos = 0; pos < end; pos ++)
+        if(insn[pos].op == OP_LABEL) {
+            insn[pos].op = OP_NOP;
+            optimize_labels ++;
+        }
+        else if(! reached[pos]) {
+            insn[pos].op = OP_NOP;
+            optimize_unreachable ++;
+        }
+
+    free(todo);
+    free(reached);
+}
+
+
+
+/* void optimize_constants(void)
+ *
+ * fold sequences like push a; push b; add to a single push and remove
+ * push a; discard completely. Neither of them can fail, therefore we
+ * needn't keep the original instructions.
+ */
+static void optimize_constants(void)
+{
+    unsigned int pos, changed;
+    unsigned char *entry = decode_entries();
+
+    do {
+        changed = 0;
+
+        for(pos = 0; insn[pos].op != OP_END; pos ++) {
+            unsigned int second, third;
+
+            if(insn[pos].op != OP_PUSH) continue;
+
+            second = optimize_live(pos + 1);
+            if(entry[second]) continue;
+
+            if(insn[second].op == OP_DISCARD) {
+                optimize_remove(second, entry);
+                optimize_remove(pos, entry);
+                optimize_folded ++;
+                changed = 1;
+                continue;
+            }
+
+            if(insn[second].op != OP_PUSH) continue;
+
+            third = optimize_live(second + 1);
+            if(entry[third]) continue;
+
+            if(! optimize_fold(pos, second, insn[third].op)) continue;
+
+            optimize_remove(third, entry);
+            optimize_remove(second, entry);
+            optimize_folded ++;
+            changed = 1;
+
+            /* try again, there might be another push; arith behind */
+            pos --;
+        }
+    } while(changed);
+
+    free(entry);
+}
+
+
+
+/* void optimize_strength(void)
+ *
+ * replace push 2^k; mul (div, mod) by the corresponding shift (mask)
+ * operation. The arithmetic instruction is kept behind the new one,
+ * like fuse_program does, in case the stack underflows.
+ */
+static void optimize_strength(void)
+{
+    unsigned int pos;
+    unsigned char *entry = decode_entries();
+
+    for(pos = 0; pos + 1 < insn_len; pos ++) {
+        insn_t *in = &insn[pos];
+        insn_op op;
+        int k;
+
+        if(in->op != OP_PUSH || entry[pos + 1]) continue;
+
+        switch(in[1].op) {
+            case OP_MUL: op = OP_SHL; break;
+            case OP_DIV: op = OP_DIV_POW2; break;
+            case OP_MOD: op = OP_MOD_POW2; break;
+            default: continue;
+        }
+
+        if((k = optimize_log2(in->arg)) < 0) continue;
+
+        in->op = op;
+        in->arg2 = k;
+        in->next = in[1].next;
+
+        optimize_reduced ++;
+        pos ++;
+    }
+
+    free(entry);
+}
+
+
+
+/* unsigned int optimize_live(unsigned int pos)
+ *
+ * RETURN: index of the first instruction at or behind pos, that
+ *         hasn't been removed
+ */
+static unsigned int optimize_live(unsigned int pos)
+{
+    /* OP_END is never removed, we'll stop there at last */
+    while(insn[pos].op == OP_NOP) pos ++;
+    return pos;
+}
+
+
+
+/* void optimize_remove(unsigned int pos, unsigned char *entry)
+ *
+ * remove the instruction at pos. Jumps to it will end up at the next
+ * instruction, therefore that one becomes an entry as well.
+ */
+static void optimize_remove(unsigned int pos, unsigned char *entry)
+{
+    insn[pos].op = OP_NOP;
+
+    if(entry[pos])
+        entry[optimize_live(pos)] = 1;
+}
+
+
+
+/* int optimize_fold(unsigned int first, unsigned int second, insn_op op)
+ *
+ * replace the literal of the push at first by the result of applying op
+ * to the literals of the pushes first and second.
+ *
+ * RETURN: 1 if folded, 0 if op is no arithmetic instruction or
+ *         would fail (or differ) at runtime
+ */
+static int optimize_fold(unsigned int first, unsigned int second,
+                         insn_op op)
+{
+    unsigned int a = insn[first].arg, b = insn[second].arg, n;
+
+    switch(op) {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+            break;
+
+        case OP_DIV:
+        case OP_MOD:
+            /* leave division by zero to the engine, as well as negative
+             * divisors (INT_MIN / -1 traps without GNU MP)
+             */
+            if(WSVAR_CMP_ZERO(insn_lit[b]) <= 0) return 0;
+            break;
+
+        default:
+            return 0;
+    }
+
+    insn_lit_require(1);
+    n = insn_lit_len ++;
+
+    switch(op) {
+        case OP_ADD: WSVAR_ADD(insn_lit[n], insn_lit[a], insn_lit[b]); break;
+        case OP_SUB: WSVAR_SUB(insn_lit[n], insn_lit[a], insn_lit[b]); break;
+        case OP_MUL: WSVAR_MUL(insn_lit[n], insn_lit[a], insn_lit[b]); break;
+        case OP_DIV: WSVAR_DIV(insn_lit[n], insn_lit[a], insn_lit[b]); break;
+        default:     WSVAR_MOD(insn_lit[n], insn_lit[a], insn_lit[b]); break;
+    }
+
+    insn[first].arg = n;
+    return 1;
+}
+
+
+
+/* int optimize_log2(unsigned int lit)
+ *
+ * check whether literal lit is 2^k, 0 < k <= OPTIMIZE_MAX_SHIFT
+ *
+ * RETURN: k if so, -1 otherwise
+ */
+static int optimize_log2(unsigned int lit)
+{
+    int k, result = -1;
+    WSVAR_TYPE power;
+
+    WSVAR_INIT(power);
+    WSVAR_SET_SI(power, 2);
+
+    for(k = 1; k <= OPTIMIZE_MAX_SHIFT; k ++) {
+        if(! WSVAR_CMP(power, insn_lit[lit])) {
+            result = k;
+            break;
+        }
+
+        if(k < OPTIMIZE_MAX_SHIFT)
+            WSVAR_MUL_UI(power, power, 2);
+    }
+
+    WSVAR_CLEAR(power);
+    return result;
+}
+
+
+
+/* void optimize_stats(FILE *target)
+ *
+ * write out, what optimize_program did
+ */
+void optimize_stats(FILE *target)
+{
+    fprintf(target, "optimizer: %u unreachable instructions and %u labels "
+            "removed, %u constants folded, %u strength reductions.\n",
+            optimize_unreachable, optimize_labels, optimize_folded,
+            optimize_reduced);
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
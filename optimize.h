@@ -0,0 +1,50 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * optimize.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * optimizer of the decoded instruction stream
+ */
+
+#ifndef _OPTIMIZE_H
+#define _OPTIMIZE_H
+
+#include <stdio.h>
+#include "decode.h"
+
+
+
+/* prototypes *****************************************************************/
+void optimize_program(int wrapping);
+void optimize_stats(FILE *target);
+
+/* optimize_program rewrites the decoded program, it must be called after
+ * decode_program and before fuse_program. It removes unreachable code
+ * and labels, folds pushes of constants followed by arithmetic and
+ * replaces multiplication, division and modulo by powers of two.
+ * If the program is going to run with numbers wrapping around (i.e. a
+ * native backend the user asked for), only the unreachable code and
+ * the labels are removed, the constants are left to the engine.
+ * The program is compacted afterwards, therefore the instruction indices
+ * change (but not the ws_ptr's, errors are still reported right).
+ *
+ * optimize_stats writes out, what optimize_program did.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
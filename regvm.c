@@ -0,0 +1,714 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * regvm.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * running blocks on a register machine, translated from the stack code
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "regvm.h"
+
+/* maximum number of stack items a block may take from the stack, as
+ * well as push onto it
+ */
+#define REGVM_MAX_DEPTH 64
+
+/* dispatching the operations, like engine_run.h does */
+#if defined(__GNUC__) && !defined(ENGINE_NO_THREADING)
+#  define REGVM_THREADED 1
+#endif
+
+/* number of registers, a block may use at most */
+#define REGVM_MAX_REGS 64
+
+/* where an operand lives, the banks are indexed by it at runtime */
+#define REGVM_SLOT 0   /* exec_stack, relative to the top at the entry */
+#define REGVM_REG  1   /* regvm_regs */
+#define REGVM_LIT  2   /* insn_lit */
+
+typedef struct {
+    unsigned char bank;
+    int n;
+} regvm_opnd_t;
+
+/* the operations of the register machine */
+typedef enum {
+    REGVM_ENTER,        /* a: stack items needed, b: items pushed at most */
+    REGVM_ASSIGN,       /* dest = a */
+    REGVM_MOVE,         /* dest = a, leaving anything in a */
+    REGVM_ADD,          /* dest = a + b, ... */
+    REGVM_SUB,
+    REGVM_MUL,
+    REGVM_DIV,
+    REGVM_MOD,
+    REGVM_MUL_2EXP,     /* dest = a * 2^target, ... */
+    REGVM_DIV_2EXP,
+    REGVM_MOD_2EXP,
+    REGVM_STORE,        /* heap[a] = b */
+    REGVM_RETRIEVE,     /* dest = heap[a] */
+    REGVM_PRINTC,       /* print a */
+    REGVM_PRINTN,
+    REGVM_READC,        /* read to heap[a] */
+    REGVM_READN,
+
+    /* leaving the block, with dest items more on the stack than on entry */
+    REGVM_EXIT,         /* go on with target */
+    REGVM_DEOPT,        /* run target by the checked handler */
+    REGVM_CALL,         /* call target, returning to next */
+    REGVM_TAIL_CALL,    /* jump to target, call it if there's no caller */
+    REGVM_RET,          /* return, the ret instruction is target */
+    REGVM_JZ,           /* target if a is zero, next otherwise */
+    REGVM_JN,           /* target if a is negative, next otherwise */
+    REGVM_JEQ           /* target if a equals b, next otherwise */
+} regvm_op;
+
+typedef struct {
+    unsigned char op;   /* one of regvm_op */
+    unsigned char dest_bank, a_bank, b_bank;
+    int dest, a, b;
+    unsigned int target;
+    unsigned int next;
+} regvm_insn_t;
+
+/* the register code of all the blocks, regvm_entry tells where each
+ * block's code starts (indexed by the block's first instruction)
+ */
+static regvm_insn_t *regvm_code = NULL;
+static unsigned int regvm_code_len = 0;
+static unsigned int regvm_code_alloc = 0;
+static unsigned int *regvm_entry = NULL;
+
+/* the registers, shared by all blocks (they're dead outside of them) */
+static WSVAR_TYPE regvm_regs[REGVM_MAX_REGS];
+static int regvm_regs_ready = 0;
+
+/* state of the block being translated. The stack items are kept track of
+ * in regvm_vs, the block's entry is at REGVM_MAX_DEPTH, below are its
+ * inputs.
+ */
+static regvm_opnd_t regvm_vs[2 * REGVM_MAX_DEPTH];
+static int regvm_sp;            /* stack depth */
+static int regvm_low;           /* lowest depth reached */
+static int regvm_high;          /* highest depth reached */
+static int regvm_used;          /* registers used */
+static unsigned int regvm_enter; /* index of the block's REGVM_ENTER */
+
+static const regvm_opnd_t regvm_none = { REGVM_LIT, 0 };
+
+static int regvm_translate(unsigned int pos);
+static int regvm_result(int i, regvm_opnd_t *dest);
+static int regvm_leave(unsigned char op, regvm_opnd_t a, regvm_opnd_t b,
+                       unsigned int target, unsigned int next);
+static int regvm_refers(regvm_opnd_t o, unsigned char bank, int n);
+static regvm_insn_t *regvm_emit(unsigned char op, regvm_opnd_t dest,
+                                regvm_opnd_t a, regvm_opnd_t b,
+                                unsigned int target);
+
+
+
+/* void regvm_program(void)
+ *
+ * translate the verified blocks to register code
+ */
+void regvm_program(void)
+{
+    unsigned int pos;
+
+    if(! regvm_regs_ready) {
+        for(pos = 0; pos < REGVM_MAX_REGS; pos ++)
+            WSVAR_INIT(regvm_regs[pos]);
+
+        regvm_regs_ready = 1;
+    }
+
+    regvm_entry = realloc(regvm_entry, insn_len * sizeof(*regvm_entry));
+    assert(regvm_entry);
+    regvm_code_len = 0;
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        if(insn[pos].block != BLOCK_LEADER) continue;
+
+        regvm_entry[pos] = regvm_code_len;
+
+        if(regvm_translate(pos))
+            insn[pos].block = BLOCK_REGVM;
+        else
+            regvm_code_len = regvm_entry[pos];
+    }
+}
+
+
+
+/* int regvm_translate(unsigned int pos)
+ *
+ * translate the block starting at pos
+ *
+ * RETURN: 1 on success, 0 if the block is too deep or needs too many
+ *         registers
+ */
+static int regvm_translate(unsigned int pos)
+{
+    regvm_opnd_t *vs = regvm_vs, o;
+    const insn_t *in = &insn[pos];
+    int i;
+
+#define sp          regvm_sp
+#define SLOT(i)     ((regvm_opnd_t) { REGVM_SLOT, (i) - REGVM_MAX_DEPTH })
+#define LIT(n)      ((regvm_opnd_t) { REGVM_LIT, (int) (n) })
+#define NEED(n)     if(sp < (int) (n)) return 0; \
+                    if(sp - (int) (n) < regvm_low) regvm_low = sp - (int) (n)
+#define PUSH(v)     if(sp == 2 * REGVM_MAX_DEPTH) return 0; \
+                    o = (v); \
+                    vs[sp ++] = o; \
+                    if(sp > regvm_high) regvm_high = sp
+#define RESULT(i)   if(! regvm_result((i), &o)) return 0
+#define EMIT(op,d,a,b,t) \
+                    regvm_emit((op), (d), (a), (b), (t))
+#define LEAVE(op,a,b,t,n) \
+                    return regvm_leave((op), (a), (b), (t), (n))
+
+    sp = regvm_low = regvm_high = REGVM_MAX_DEPTH;
+    regvm_used = 0;
+
+    for(i = 0; i < sp; i ++)
+        vs[i] = SLOT(i);
+
+    /* filled in by regvm_leave, as soon as we know the block's needs */
+    regvm_enter = regvm_code_len;
+    EMIT(REGVM_ENTER, regvm_none, regvm_none, regvm_none, 0);
+
+    for(;;) {
+        switch(in->op) {
+            case OP_PUSH:
+                PUSH(LIT(in->arg));
+                break;
+
+            case OP_DUP:
+                NEED(1);
+                PUSH(vs[sp - 1]);
+                break;
+
+            case OP_COPY:
+                if(in->arg >= REGVM_MAX_DEPTH) return 0;
+                NEED(in->arg + 1);
+                PUSH(vs[sp - 1 - in->arg]);
+                break;
+
+            case OP_SWAP:
+                NEED(2);
+                o = vs[sp - 1];
+                vs[sp - 1] = vs[sp - 2];
+                vs[sp - 2] = o;
+                break;
+
+            case OP_DISCARD:
+                NEED(1);
+                sp --;
+                break;
+
+            case OP_SLIDE:
+                if(in->arg >= REGVM_MAX_DEPTH) return 0;
+                NEED(in->arg + 1);
+                vs[sp - 1 - in->arg] = vs[sp - 1];
+                sp -= in->arg;
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                NEED(2);
+                sp --;
+                RESULT(sp - 1);
+                EMIT(REGVM_ADD + (in->op - OP_ADD), o, vs[sp - 1], vs[sp], 0);
+                vs[sp - 1] = o;
+                break;
+
+            case OP_STORE:
+                NEED(2);
+                sp -= 2;
+                EMIT(REGVM_STORE, regvm_none, vs[sp], vs[sp + 1], 0);
+                break;
+
+            case OP_RETRIEVE:
+                NEED(1);
+                RESULT(sp - 1);
+                EMIT(REGVM_RETRIEVE, o, vs[sp - 1], regvm_none, 0);
+                vs[sp - 1] = o;
+                break;
+
+            case OP_LABEL:
+                break;
+
+            case OP_CALL:
+                LEAVE(REGVM_CALL, regvm_none, regvm_none, in->arg, in->next);
+
+            case OP_JUMP:
+                LEAVE(REGVM_EXIT, regvm_none, regvm_none, in->arg, 0);
+
+            case OP_JZ:
+            case OP_JN:
+                NEED(1);
+                sp --;
+                LEAVE(in->op == OP_JZ ? REGVM_JZ : REGVM_JN, vs[sp],
+                      regvm_none, in->arg, in->next);
+
+            case OP_RET:
+                LEAVE(REGVM_RET, regvm_none, regvm_none, in - insn, 0);
+
+            case OP_TAIL_CALL:
+                LEAVE(REGVM_TAIL_CALL, regvm_none, regvm_none, in->arg,
+                      in->next);
+
+            case OP_JUMP_RET:
+                LEAVE(REGVM_RET, regvm_none, regvm_none, in->arg, 0);
+
+            case OP_PRINTC:
+            case OP_PRINTN:
+                NEED(1);
+                sp --;
+                EMIT(in->op == OP_PRINTC ? REGVM_PRINTC : REGVM_PRINTN,
+                     regvm_none, vs[sp], regvm_none, 0);
+                break;
+
+            case OP_READC:
+            case OP_READN:
+                NEED(1);
+                sp --;
+                EMIT(in->op == OP_READC ? REGVM_READC : REGVM_READN,
+                     regvm_none, vs[sp], regvm_none, 0);
+                break;
+
+            case OP_PUSH_ADD:
+            case OP_PUSH_SUB:
+                NEED(1);
+                RESULT(sp - 1);
+                EMIT(in->op == OP_PUSH_ADD ? REGVM_ADD : REGVM_SUB, o,
+                     vs[sp - 1], LIT(in->arg), 0);
+                vs[sp - 1] = o;
+                break;
+
+            case OP_PUSH_RETRIEVE:
+                PUSH(LIT(in->arg));
+                RESULT(sp - 1);
+                EMIT(REGVM_RETRIEVE, o, vs[sp - 1], regvm_none, 0);
+                vs[sp - 1] = o;
+                break;
+
+            case OP_PUSH_SWAP_STORE:
+                NEED(1);
+                sp --;
+                EMIT(REGVM_STORE, regvm_none, LIT(in->arg), vs[sp], 0);
+                break;
+
+            case OP_DUP_JZ:
+            case OP_DUP_JN:
+                NEED(1);
+                LEAVE(in->op == OP_DUP_JZ ? REGVM_JZ : REGVM_JN, vs[sp - 1],
+                      regvm_none, in->arg, in->next);
+
+            case OP_COPY_PUSH_SUB:
+                if(in->arg >= REGVM_MAX_DEPTH) return 0;
+                NEED(in->arg + 1);
+                PUSH(vs[sp - 1 - in->arg]);
+                RESULT(sp - 1);
+                EMIT(REGVM_SUB, o, vs[sp - 1], LIT(in->arg2), 0);
+                vs[sp - 1] = o;
+                break;
+
+            case OP_PUSH_SUB_JZ:
+                NEED(1);
+                sp --;
+                LEAVE(REGVM_JEQ, vs[sp], LIT(in->arg2), in->arg, in->next);
+
+            case OP_SHL:
+            case OP_DIV_POW2:
+            case OP_MOD_POW2:
+                NEED(1);
+                RESULT(sp - 1);
+                EMIT(REGVM_MUL_2EXP + (in->op - OP_SHL), o, vs[sp - 1],
+                     regvm_none, in->arg2);
+                vs[sp - 1] = o;
+                break;
+
+            default: /* OP_EXIT and pseudo instructions, the engine does it */
+                LEAVE(REGVM_DEOPT, regvm_none, regvm_none, in - insn, 0);
+        }
+
+        if(in->next >= insn_len || insn[in->next].block != BLOCK_BODY)
+            LEAVE(REGVM_EXIT, regvm_none, regvm_none, in->next, 0);
+
+        in = &insn[in->next];
+    }
+
+#undef sp
+#undef SLOT
+#undef LIT
+#undef NEED
+#undef PUSH
+#undef RESULT
+#undef EMIT
+#undef LEAVE
+}
+
+
+
+/* int regvm_result(int i, regvm_opnd_t *dest)
+ *
+ * figure out where to put the result of an operation, that replaces
+ * the stack item at i. That's its slot on the stack, unless some other
+ * item still refers to the slot's (current) value, or a new register.
+ *
+ * RETURN: 1 on success, 0 if we're out of registers
+ */
+static int regvm_result(int i, regvm_opnd_t *dest)
+{
+    int j, n = i - REGVM_MAX_DEPTH;
+
+    for(j = 0; j < regvm_sp; j ++)
+        if(j != i && regvm_refers(regvm_vs[j], REGVM_SLOT, n))
+            break;
+
+    if(j == regvm_sp) {
+        dest->bank = REGVM_SLOT;
+        dest->n = n;
+        return 1;
+    }
+
+    if(regvm_used == REGVM_MAX_REGS)
+        return 0;
+
+    dest->bank = REGVM_REG;
+    dest->n = regvm_used ++;
+    return 1;
+}
+
+
+
+/* int regvm_leave(unsigned char op, regvm_opnd_t a, regvm_opnd_t b,
+ *                 unsigned int target, unsigned int next)
+ *
+ * finish the block: write the stack items, that changed, back to their
+ * slots and leave the block by op (which may look at a and b)
+ *
+ * RETURN: 1 on success, 0 if we're out of registers
+ */
+static int regvm_leave(unsigned char op, regvm_opnd_t a, regvm_opnd_t b,
+                       unsigned int target, unsigned int next)
+{
+    regvm_opnd_t *vs = regvm_vs, save[2 * REGVM_MAX_DEPTH];
+    unsigned char written[2 * REGVM_MAX_DEPTH];
+    int i, j, q;
+    regvm_insn_t *r;
+
+#define SLOT_OF(o)  ((o).bank == REGVM_SLOT ? (o).n + REGVM_MAX_DEPTH : -1)
+
+    for(i = regvm_low; i < regvm_sp; i ++) {
+        written[i] = ! regvm_refers(vs[i], REGVM_SLOT, i - REGVM_MAX_DEPTH);
+        save[i] = regvm_none;
+    }
+
+    /* the slots are written in ascending order, items referring to a
+     * slot below their own have to be saved first (as do the operands
+     * of the jump, that are looked at after writing)
+     */
+    for(i = regvm_low; i <= regvm_sp + 1; i ++) {
+        regvm_opnd_t *o = i < regvm_sp ? &vs[i] : i == regvm_sp ? &a : &b;
+
+        if(i < regvm_sp && ! written[i]) continue;
+
+        q = SLOT_OF(*o);
+        if(q < regvm_low || q >= regvm_sp || ! written[q] || q > i)
+            continue;
+
+        if(save[q].bank != REGVM_REG) {
+            if(regvm_used == REGVM_MAX_REGS) return 0;
+
+            save[q].bank = REGVM_REG;
+            save[q].n = regvm_used ++;
+            regvm_emit(REGVM_ASSIGN, save[q], *o, regvm_none, 0);
+        }
+
+        *o = save[q];
+    }
+
+    /* values, that aren't needed any more, are moved instead of copied */
+    for(i = regvm_low; i < regvm_sp; i ++) {
+        unsigned char move;
+
+        if(! written[i]) continue;
+
+        q = SLOT_OF(vs[i]);
+        move = vs[i].bank == REGVM_REG
+            || (q >= regvm_sp || (q >= regvm_low && written[q]));
+
+        for(j = i + 1; move && j < regvm_sp; j ++)
+            if(written[j] && regvm_refers(vs[j], vs[i].bank, vs[i].n))
+                move = 0;
+
+        if(regvm_refers(a, vs[i].bank, vs[i].n)
+           || regvm_refers(b, vs[i].bank, vs[i].n))
+            move = 0;
+
+        regvm_emit(move ? REGVM_MOVE : REGVM_ASSIGN,
+                   (regvm_opnd_t) { REGVM_SLOT, i - REGVM_MAX_DEPTH },
+                   vs[i], regvm_none, 0);
+    }
+
+#undef SLOT_OF
+
+    r = regvm_emit(op, (regvm_opnd_t) { REGVM_SLOT,
+                                        regvm_sp - REGVM_MAX_DEPTH },
+                   a, b, target);
+    r->next = next;
+
+    regvm_code[regvm_enter].a = REGVM_MAX_DEPTH - regvm_low;
+    regvm_code[regvm_enter].b = regvm_high - REGVM_MAX_DEPTH;
+    return 1;
+}
+
+
+
+/* int regvm_refers(regvm_opnd_t o, unsigned char bank, int n)
+ *
+ * RETURN: 1 if operand o is n of bank, 0 otherwise
+ */
+static int regvm_refers(regvm_opnd_t o, unsigned char bank, int n)
+{
+    return o.bank == bank && o.n == n;
+}
+
+
+
+/* regvm_insn_t *regvm_emit(unsigned char op, regvm_opnd_t dest,
+ *                          regvm_opnd_t a, regvm_opnd_t b,
+ *                          unsigned int target)
+ *
+ * append an operation to regvm_code
+ *
+ * RETURN: the operation
+ */
+static regvm_insn_t *regvm_emit(unsigned char op, regvm_opnd_t dest,
+                                regvm_opnd_t a, regvm_opnd_t b,
+                                unsigned int target)
+{
+    regvm_insn_t *r;
+
+    STACK_REQUIRE(regvm_code, regvm_code_len, regvm_code_alloc, 1);
+    r = &regvm_code[regvm_code_len ++];
+
+    r->op = op;
+    r->dest_bank = dest.bank;
+    r->dest = dest.n;
+    r->a_bank = a.bank;
+    r->a = a.n;
+    r->b_bank = b.bank;
+    r->b = b.n;
+    r->target = target;
+    r->next = 0;
+
+    return r;
+}
+
+
+
+/* const insn_t *regvm_run(const insn_t *ip, int *deopt)
+ *
+ * run the register code of the block starting at ip
+ *
+ * RETURN: instruction to continue with
+ */
+const insn_t *regvm_run(const insn_t *ip, int *deopt)
+{
+    const regvm_insn_t *r = &regvm_code[regvm_entry[ip - insn]];
+    unsigned int len = exec_stack_len;
+    WSVAR_TYPE *bank[3];
+    long address;
+
+    *deopt = 1;
+
+    if(len < (unsigned int) r->a)
+        return ip;
+
+    exec_stack_require(r->b);
+
+    bank[REGVM_SLOT] = exec_stack + len;
+    bank[REGVM_REG] = regvm_regs;
+    bank[REGVM_LIT] = insn_lit;
+
+#define D           bank[r->dest_bank][r->dest]
+#define A           bank[r->a_bank][r->a]
+#define B           bank[r->b_bank][r->b]
+#define LEAVE(t)    { exec_stack_len = len + r->dest; return (t); }
+
+#ifdef REGVM_THREADED
+    static const void *const handlers[] = {
+        [REGVM_ASSIGN] = &&R_REGVM_ASSIGN,
+        [REGVM_MOVE] = &&R_REGVM_MOVE,
+        [REGVM_ADD] = &&R_REGVM_ADD,
+        [REGVM_SUB] = &&R_REGVM_SUB,
+        [REGVM_MUL] = &&R_REGVM_MUL,
+        [REGVM_DIV] = &&R_REGVM_DIV,
+        [REGVM_MOD] = &&R_REGVM_MOD,
+        [REGVM_MUL_2EXP] = &&R_REGVM_MUL_2EXP,
+        [REGVM_DIV_2EXP] = &&R_REGVM_DIV_2EXP,
+        [REGVM_MOD_2EXP] = &&R_REGVM_MOD_2EXP,
+        [REGVM_STORE] = &&R_REGVM_STORE,
+        [REGVM_RETRIEVE] = &&R_REGVM_RETRIEVE,
+        [REGVM_PRINTC] = &&R_REGVM_PRINTC,
+        [REGVM_PRINTN] = &&R_REGVM_PRINTN,
+        [REGVM_READC] = &&R_REGVM_READC,
+        [REGVM_READN] = &&R_REGVM_READN,
+        [REGVM_EXIT] = &&R_REGVM_EXIT,
+        [REGVM_DEOPT] = &&R_REGVM_DEOPT,
+        [REGVM_CALL] = &&R_REGVM_CALL,
+        [REGVM_TAIL_CALL] = &&R_REGVM_TAIL_CALL,
+        [REGVM_RET] = &&R_REGVM_RET,
+        [REGVM_JZ] = &&R_REGVM_JZ,
+        [REGVM_JN] = &&R_REGVM_JN,
+        [REGVM_JEQ] = &&R_REGVM_JEQ
+    };
+
+#  define CASE(op)          R_##op
+#  define NEXT()            goto *handlers[(++ r)->op]
+
+    NEXT();
+    {
+#else
+#  define CASE(op)          case op
+#  define NEXT()            break
+
+    for(;;) {
+        switch((++ r)->op) {
+#endif
+
+    CASE(REGVM_ASSIGN):
+        WSVAR_ASSIGN(D, A);
+        NEXT();
+
+    CASE(REGVM_MOVE):
+        WSVAR_MOVE(D, A);
+        NEXT();
+
+    CASE(REGVM_ADD):
+        WSVAR_ADD(D, A, B);
+        NEXT();
+
+    CASE(REGVM_SUB):
+        WSVAR_SUB(D, A, B);
+        NEXT();
+
+    CASE(REGVM_MUL):
+        WSVAR_MUL(D, A, B);
+        NEXT();
+
+    CASE(REGVM_DIV):
+        WSVAR_DIV(D, A, B);
+        NEXT();
+
+    CASE(REGVM_MOD):
+        WSVAR_MOD(D, A, B);
+        NEXT();
+
+    CASE(REGVM_MUL_2EXP):
+        WSVAR_MUL_2EXP(D, A, r->target);
+        NEXT();
+
+    CASE(REGVM_DIV_2EXP):
+        WSVAR_DIV_2EXP(D, A, r->target);
+        NEXT();
+
+    CASE(REGVM_MOD_2EXP):
+        WSVAR_MOD_2EXP(D, A, r->target);
+        NEXT();
+
+    CASE(REGVM_STORE):
+        address = WSVAR_GET_SI(A);
+        exec_heap_write(address, B);
+        NEXT();
+
+    CASE(REGVM_RETRIEVE):
+        address = WSVAR_GET_SI(A);
+        exec_heap_read(address, D);
+        NEXT();
+
+    CASE(REGVM_PRINTC):
+        putchar((int)WSVAR_GET_UI(A) & 0xff);
+        NEXT();
+
+    CASE(REGVM_PRINTN):
+        WSVAR_PRINTF(A);
+        NEXT();
+
+    CASE(REGVM_READC):
+    CASE(REGVM_READN):
+        address = WSVAR_GET_SI(A);
+        interprt_input(exec_heap_cell(address), r->op == REGVM_READN);
+        NEXT();
+
+    CASE(REGVM_EXIT):
+        *deopt = 0;
+        LEAVE(&insn[r->target]);
+
+    CASE(REGVM_CALL):
+        *deopt = 0;
+        exec_bt_push(r->next);
+        LEAVE(&insn[r->target]);
+
+    CASE(REGVM_TAIL_CALL):
+        *deopt = 0;
+        if(! exec_bt_len) exec_bt_push(r->next);
+        LEAVE(&insn[r->target]);
+
+    CASE(REGVM_RET):
+        if(! exec_bt_len) LEAVE(&insn[r->target]);
+        *deopt = 0;
+        LEAVE(&insn[exec_bt_pop()]);
+
+    CASE(REGVM_JZ):
+        *deopt = 0;
+        LEAVE(&insn[WSVAR_CMP_ZERO(A) ? r->next : r->target]);
+
+    CASE(REGVM_JN):
+        *deopt = 0;
+        LEAVE(&insn[WSVAR_CMP_ZERO(A) < 0 ? r->target : r->next]);
+
+    CASE(REGVM_JEQ):
+        *deopt = 0;
+        LEAVE(&insn[WSVAR_CMP(A, B) ? r->next : r->target]);
+
+    CASE(REGVM_DEOPT):
+        LEAVE(&insn[r->target]);
+    }
+#ifndef REGVM_THREADED
+    }
+#endif
+
+#undef CASE
+#undef NEXT
+#undef D
+#undef A
+#undef B
+#undef LEAVE
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
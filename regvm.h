@@ -0,0 +1,55 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * regvm.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * running blocks on a register machine, translated from the stack code
+ */
+
+#ifndef _REGVM_H
+#define _REGVM_H
+
+#include "decode.h"
+
+/* tells engine_run.h, that the engine including us runs on WSVAR_TYPE,
+ * which the register machine does as well
+ */
+#define REGVM_BLOCKS 1
+
+
+
+/* prototypes *****************************************************************/
+void regvm_program(void);
+const insn_t *regvm_run(const insn_t *ip, int *deopt);
+
+/* regvm_program translates the blocks verify_program found to register
+ * code and marks them BLOCK_REGVM. Within a block, stack items are kept
+ * track of at translation time: pushes, dups, copies, swaps and slides
+ * just rename them, the instructions left operate on the block's input
+ * items, literals and registers directly. The stack is written back
+ * only when leaving the block.
+ *
+ * regvm_run runs such a block, starting at its first instruction ip,
+ * and returns the instruction to go on with. If deopt is set, the
+ * instruction returned has to be run by the ordinary, checked handler
+ * (the stack holding too few items on entry, or an error is about to
+ * happen).
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -12,6 +12,7 @@
  * wsdebug data storage (in memory representation)
  */
 
+#include <string.h>
 #include "storage.h"
 
 #ifndef NULL
@@ -19,12 +20,151 @@
 #endif
 
 /* this file will probably stay rather empty, since it's only necessary
- * to define the wsdata and compose stack somewhere.
+ * to define the wsdata and compose stack somewhere (as well as the page
+ * directory functions).
  */
 
 STACK_DEF(unsigned char, wsdata, wsdata_len, wsdata_alloc)
 STACK_DEF(unsigned char, compose, compose_len, compose_alloc)
 
+static unsigned int pagedir_slot(const pagedir_t *dir, unsigned long number);
+static void pagedir_grow(pagedir_t *dir);
+
+
+
+/* unsigned int pagedir_slot(const pagedir_t *dir, unsigned long number)
+ *
+ * RETURN: the slot of page number, or the empty one it belongs into
+ */
+static unsigned int pagedir_slot(const pagedir_t *dir, unsigned long number)
+{
+    unsigned int slot = (unsigned int) (number * 2654435761UL);
+
+    for(;; slot ++) {
+        slot &= dir->size - 1;
+
+        if(! dir->pages[slot] || dir->numbers[slot] == number)
+            return slot;
+    }
+}
+
+
+
+/* void pagedir_grow(pagedir_t *dir)
+ *
+ * double the number of slots of dir
+ */
+static void pagedir_grow(pagedir_t *dir)
+{
+    unsigned long *numbers = dir->numbers;
+    void **pages = dir->pages;
+    unsigned int i, size = dir->size;
+
+    dir->size = size ? size << 1 : 16;
+    dir->numbers = malloc(dir->size * sizeof(*dir->numbers));
+    dir->pages = calloc(dir->size, sizeof(*dir->pages));
+    assert(dir->numbers && dir->pages);
+
+    for(i = 0; i < size; i ++)
+        if(pages[i]) {
+            unsigned int slot = pagedir_slot(dir, numbers[i]);
+            dir->numbers[slot] = numbers[i];
+            dir->pages[slot] = pages[i];
+        }
+
+    free(numbers);
+    free(pages);
+}
+
+
+
+/* void *pagedir_fault(pagedir_t *dir, unsigned long number)
+ *
+ * look up page number (allocating it, if necessary), the page accessed
+ * last is cached by PAGEDIR_CELL already
+ *
+ * RETURN: the page (the scratch page, if alloc fails)
+ */
+void *pagedir_fault(pagedir_t *dir, unsigned long number)
+{
+    unsigned int slot;
+
+    /* keep the hash table at most half full */
+    if(dir->len >= dir->size / 2)
+        pagedir_grow(dir);
+
+    slot = pagedir_slot(dir, number);
+
+    if(! dir->pages[slot]) {
+        dir->pages[slot] = dir->alloc ? dir->alloc(number)
+                                      : calloc(1, dir->page_size);
+
+        /* alloc's out of space, the caller has to check failed */
+        if(! dir->pages[slot] && dir->alloc) {
+            if(! dir->scratch) dir->scratch = malloc(dir->page_size);
+            assert(dir->scratch);
+
+            memset(dir->scratch, 0, dir->page_size);
+            dir->failed = 1;
+            return dir->scratch;
+        }
+
+        assert(dir->pages[slot]);
+
+        if(dir->init) dir->init(dir->pages[slot]);
+
+        dir->numbers[slot] = number;
+        dir->len ++;
+    }
+
+    dir->last_number = number;
+    return dir->last_page = dir->pages[slot];
+}
+
+
+
+/* void pagedir_insert(pagedir_t *dir, unsigned long number, void *page)
+ *
+ * add page number to dir, that mustn't have it yet
+ */
+void pagedir_insert(pagedir_t *dir, unsigned long number, void *page)
+{
+    unsigned int slot;
+
+    if(dir->len >= dir->size / 2)
+        pagedir_grow(dir);
+
+    slot = pagedir_slot(dir, number);
+    assert(! dir->pages[slot]);
+
+    dir->pages[slot] = page;
+    dir->numbers[slot] = number;
+    dir->len ++;
+}
+
+
+
+/* void pagedir_reset(pagedir_t *dir)
+ *
+ * release all the pages of dir
+ */
+void pagedir_reset(pagedir_t *dir)
+{
+    unsigned int i;
+
+    for(i = 0; i < dir->size; i ++)
+        if(dir->pages[i]) {
+            if(dir->fini) dir->fini(dir->pages[i]);
+
+            if(! dir->alloc) free(dir->pages[i]);
+            dir->pages[i] = NULL;
+        }
+
+    dir->len = 0;
+    dir->last_number = ~0UL;
+    dir->last_page = NULL;
+    dir->failed = 0;
+}
 
 
 
@@ -60,6 +60,64 @@
     } while(0)
 
 
+
+/* paged storage **************************************************************/
+#define PAGE_BITS   10
+#define PAGE_CELLS  (1UL << PAGE_BITS)
+
+typedef struct {
+    unsigned long *numbers;     /* page number (address >> PAGE_BITS) */
+    void **pages;               /* the pages, NULL if the slot is empty */
+    unsigned int size;          /* number of slots, a power of two */
+    unsigned int len;           /* number of pages */
+    unsigned long last_number;  /* the page accessed last */
+    void *last_page;
+    size_t page_size;           /* bytes per page */
+    void (*init)(void *page);   /* set up a new page, may be NULL */
+    void (*fini)(void *page);   /* clean up a page, may be NULL */
+    void *(*alloc)(unsigned long number); /* get a new page, may be NULL */
+    void *scratch;              /* handed out, if alloc fails */
+    int failed;                 /* whether alloc has failed */
+} pagedir_t;
+
+#define PAGEDIR_DEF_EXT(dir) \
+    extern pagedir_t dir;
+
+#define PAGEDIR_DEF(elm,dir,init,fini) \
+    pagedir_t dir = { NULL, NULL, 0, 0, ~0UL, NULL, \
+                      sizeof(elm) << PAGE_BITS, (init), (fini), NULL, \
+                      NULL, 0 };
+
+#define PAGEDIR_CELL(elm,dir,address) \
+    (&((elm *) (((unsigned long) (address) >> PAGE_BITS) == (dir).last_number \
+                ? (dir).last_page \
+                : pagedir_fault(&(dir), (unsigned long) (address) >> PAGE_BITS))) \
+        [(unsigned long) (address) & (PAGE_CELLS - 1)])
+
+void *pagedir_fault(pagedir_t *dir, unsigned long number);
+void pagedir_insert(pagedir_t *dir, unsigned long number, void *page);
+void pagedir_reset(pagedir_t *dir);
+
+/* a sparse array of elm, indexed by any long (negative ones as well).
+ * The cells are kept in pages of PAGE_CELLS cells, that are allocated
+ * (zeroed and passed to init) once any of their cells is accessed first.
+ * Therefore memory scales with the addresses actually used.
+ *
+ * PAGEDIR_CELL(elm,dir,address) returns a pointer to the cell at address,
+ * it evaluates address more than once. The page accessed last is cached,
+ * all others are looked up in a hash table (see pagedir_fault).
+ *
+ * pagedir_reset releases all the pages, passing each to fini first.
+ * To walk through the pages, look for the non-NULL slots of pages.
+ *
+ * If alloc is set, new pages are taken from there (zeroed already)
+ * instead of calloc, and pagedir_reset leaves them to their owner.
+ * pagedir_insert adds such a page, that's been there before. If alloc
+ * returns NULL, failed is set (till pagedir_reset) and the cell is one of
+ * a scratch page of zeroes, that isn't kept, i.e. the caller has to check
+ * failed and stop using dir.
+ */
+
 
 
 /* wsdata stack ***************************************************************/
@@ -95,7 +153,6 @@ STACK_DEF_EXT(unsigned char, wsdata, wsdata_len, wsdata_alloc)
  */
 
 
-
 
 /* compose stack **************************************************************/
 STACK_DEF_EXT(unsigned char, compose, compose_len, compose_alloc)
@@ -129,7 +186,6 @@ STACK_DEF_EXT(unsigned char, compose, compose_len, compose_alloc)
 #endif
 
 
-
 
 /***** -*- emacs is great -*-
 Local Variables:
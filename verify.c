@@ -0,0 +1,351 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * verify.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * static stack depth verification of the decoded program
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#include "verify.h"
+
+/* limits of insn_t.need and insn_t.grow, blocks exceeding them are run
+ * with all the checks
+ */
+#define VERIFY_MAX_NEED UCHAR_MAX
+#define VERIFY_MAX_GROW USHRT_MAX
+
+/* the stack depth at a block's entry isn't known (yet) */
+#define VERIFY_UNKNOWN UINT_MAX
+
+/* after lowering a block's entry depth that often, give up and assume
+ * it's zero (otherwise a loop, that pops an item each time, keeps us
+ * busy for quite a while)
+ */
+#define VERIFY_WIDEN 16
+
+/* what we know about a basic block, indexed by its leader */
+typedef struct {
+    unsigned int need;     /* items needed on entry, VERIFY_UNKNOWN if the
+                            * block contains an unverifiable instruction */
+    unsigned int grow;     /* items pushed at most, relative to the entry */
+    int delta;             /* stack depth change of the whole block */
+    unsigned int last;     /* index of the block's last instruction */
+    unsigned int lower;    /* lower bound of the stack depth at entry */
+    unsigned char drops;   /* number of times, lower was decreased */
+    unsigned char queued;  /* on the todo list */
+} verify_block_t;
+
+static verify_block_t *verify_blocks;
+static unsigned int *verify_todo;
+static unsigned int verify_todo_len;
+
+static int verify_ends_block(insn_op op);
+static int verify_effect(const insn_t *in, unsigned int *need, int *delta);
+static unsigned int verify_block(unsigned int pos,
+                                 const unsigned char *leader);
+static void verify_reach(unsigned int pos, unsigned int depth);
+
+
+
+/* void verify_program(void)
+ *
+ * split the program into basic blocks and figure out their stack needs
+ */
+void verify_program(void)
+{
+    unsigned int pos;
+    unsigned char *leader = decode_entries();
+
+    verify_blocks = malloc(insn_len * sizeof(*verify_blocks));
+    verify_todo = malloc(insn_len * sizeof(*verify_todo));
+    assert(verify_blocks && verify_todo);
+
+    /* a block starts at each instruction, that is jumped to (or returned
+     * to) and behind each instruction, that doesn't simply go on
+     */
+    leader[0] = 1;
+
+    for(pos = 0; pos < insn_len; pos ++) {
+        insn[pos].block = BLOCK_CHECKED;
+
+        if(verify_ends_block(insn[pos].op))
+            leader[insn[pos].next] = 1;
+    }
+
+    for(pos = 0; pos < insn_len; pos ++)
+        if(leader[pos] && verify_block(pos, leader) > 1) {
+            /* single instructions aren't worth it, checking the block's
+             * needs costs as much as checking the instruction's.
+             */
+            unsigned int i;
+            verify_block_t *b = &verify_blocks[pos];
+
+            if(b->need > VERIFY_MAX_NEED || b->grow > VERIFY_MAX_GROW)
+                continue;
+
+            for(i = pos; i != b->last; i = insn[i].next)
+                insn[i].block = BLOCK_BODY;
+
+            insn[b->last].block = BLOCK_BODY;
+            insn[pos].block = BLOCK_LEADER;
+            insn[pos].need = b->need;
+            insn[pos].grow = b->grow;
+        }
+
+    /* now propagate lower bounds of the stack depth from the start of the
+     * program along the jumps. We don't know what subroutines leave on
+     * the stack, therefore the instructions behind calls start at zero.
+     */
+    verify_todo_len = 0;
+    verify_reach(0, 0);
+
+    for(pos = 0; pos < insn_len; pos ++)
+        if(insn_is_call(insn[pos].op))
+            verify_reach(insn[pos].next, 0);
+
+    while(verify_todo_len) {
+        verify_block_t *b = &verify_blocks[verify_todo[-- verify_todo_len]];
+        const insn_t *last = &insn[b->last];
+        unsigned int out = 0;
+
+        b->queued = 0;
+
+        /* the block either fails (and we don't go on), or there were
+         * enough items on the stack
+         */
+        if(b->need != VERIFY_UNKNOWN)
+            out = (b->lower > b->need ? b->lower : b->need) + b->delta;
+
+        if(insn_has_target(last->op))
+            verify_reach(last->arg, out);
+
+        switch(last->op) {
+            case OP_JUMP:
+            case OP_JUMP_RET:
+            case OP_CALL: /* the continuation has been taken care of */
+            case OP_TAIL_CALL:
+            case OP_RET:
+            case OP_EXIT:
+            case OP_SYNTAX_ERROR:
+            case OP_NO_LABEL:
+            case OP_END:
+            case OP_MEMO_RET:
+                break;
+
+            default:
+                verify_reach(last->next, out);
+                break;
+        }
+    }
+
+    /* blocks, that are proven to get enough items, needn't check */
+    for(pos = 0; pos < insn_len; pos ++)
+        if(insn[pos].block == BLOCK_LEADER
+           && verify_blocks[pos].lower != VERIFY_UNKNOWN
+           && verify_blocks[pos].lower >= verify_blocks[pos].need)
+            insn[pos].need = 0;
+
+    free(leader);
+    free(verify_blocks);
+    free(verify_todo);
+}
+
+
+
+/* int verify_ends_block(insn_op op)
+ *
+ * RETURN: 1 if op doesn't (necessarily) continue with the next
+ *         instruction, 0 otherwise
+ */
+static int verify_ends_block(insn_op op)
+{
+    switch(op) {
+        case OP_RET:
+        case OP_EXIT:
+        case OP_SYNTAX_ERROR:
+        case OP_NO_LABEL:
+        case OP_END:
+        case OP_MEMO_RET:
+            return 1;
+
+        default:
+            return insn_has_target(op);
+    }
+}
+
+
+
+/* int verify_effect(const insn_t *in, unsigned int *need, int *delta)
+ *
+ * store the number of items instruction in needs on the stack to need
+ * and how it changes the stack depth to delta.
+ *
+ * RETURN: 1 on success, 0 if the instruction's needs are too large
+ */
+static int verify_effect(const insn_t *in, unsigned int *need, int *delta)
+{
+    *need = 0;
+    *delta = 0;
+
+    switch(in->op) {
+        case OP_PUSH:
+        case OP_PUSH_RETRIEVE:
+            *delta = 1;
+            break;
+
+        case OP_DUP:
+            *need = 1;
+            *delta = 1;
+            break;
+
+        case OP_COPY:
+        case OP_COPY_PUSH_SUB:
+            if(in->arg >= VERIFY_MAX_NEED) return 0;
+            *need = in->arg + 1;
+            *delta = 1;
+            break;
+
+        case OP_SLIDE:
+            if(in->arg >= VERIFY_MAX_NEED) return 0;
+            *need = in->arg + 1;
+            *delta = -(int) in->arg;
+            break;
+
+        case OP_SWAP:
+            *need = 2;
+            break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            *need = 2;
+            *delta = -1;
+            break;
+
+        case OP_STORE:
+            *need = 2;
+            *delta = -2;
+            break;
+
+        case OP_DISCARD:
+        case OP_JZ:
+        case OP_JN:
+        case OP_PRINTC:
+        case OP_PRINTN:
+        case OP_READC:
+        case OP_READN:
+        case OP_PUSH_SWAP_STORE:
+        case OP_PUSH_SUB_JZ:
+            *need = 1;
+            *delta = -1;
+            break;
+
+        case OP_RETRIEVE:
+        case OP_PUSH_ADD:
+        case OP_PUSH_SUB:
+        case OP_DUP_JZ:
+        case OP_DUP_JN:
+        case OP_SHL:
+        case OP_DIV_POW2:
+        case OP_MOD_POW2:
+            *need = 1;
+            break;
+
+        default: /* flow control and pseudo instructions */
+            break;
+    }
+
+    return 1;
+}
+
+
+
+/* unsigned int verify_block(unsigned int pos, const unsigned char *leader)
+ *
+ * follow the block starting at pos, filling in verify_blocks[pos]
+ *
+ * RETURN: number of instructions in the block
+ */
+static unsigned int verify_block(unsigned int pos,
+                                 const unsigned char *leader)
+{
+    verify_block_t *b = &verify_blocks[pos];
+    unsigned int len = 0;
+    int depth = 0; /* relative to the block's entry */
+
+    b->need = b->grow = 0;
+    b->lower = VERIFY_UNKNOWN;
+    b->drops = b->queued = 0;
+
+    for(;;) {
+        unsigned int need;
+        int delta;
+
+        len ++;
+
+        if(! verify_effect(&insn[pos], &need, &delta))
+            b->need = VERIFY_UNKNOWN;
+
+        else if(b->need != VERIFY_UNKNOWN) {
+            if((int) need - depth > (int) b->need)
+                b->need = need - depth;
+
+            depth += delta;
+
+            if(depth > (int) b->grow)
+                b->grow = depth;
+        }
+
+        if(verify_ends_block(insn[pos].op) || leader[insn[pos].next])
+            break;
+
+        pos = insn[pos].next;
+    }
+
+    b->delta = depth;
+    b->last = pos;
+    return len;
+}
+
+
+
+/* void verify_reach(unsigned int pos, unsigned int depth)
+ *
+ * the block at pos is entered with at least depth items on the stack,
+ * lower its bound accordingly
+ */
+static void verify_reach(unsigned int pos, unsigned int depth)
+{
+    verify_block_t *b = &verify_blocks[pos];
+
+    if(depth >= b->lower) return;
+
+    b->lower = ++ b->drops > VERIFY_WIDEN ? 0 : depth;
+
+    if(! b->queued) {
+        b->queued = 1;
+        verify_todo[verify_todo_len ++] = pos;
+    }
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
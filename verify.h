@@ -0,0 +1,47 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * verify.h
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * static stack depth verification of the decoded program
+ */
+
+#ifndef _VERIFY_H
+#define _VERIFY_H
+
+#include "decode.h"
+
+
+
+/* prototypes *****************************************************************/
+void verify_program(void);
+
+/* verify_program splits the decoded program into basic blocks and
+ * figures out how many stack items each of them needs (and pushes at
+ * most), storing it into the block, need and grow fields of the
+ * instructions. Blocks, that are proven to always find enough items on
+ * the stack, get a need of zero.
+ *
+ * The engine checks need and reserves grow once, when entering a block,
+ * and runs the block's instructions without any further checks then. If
+ * the check fails, the block is run with all checks, so errors are still
+ * reported at the very instruction, that failed.
+ */
+
+#endif
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
@@ -0,0 +1,742 @@
+/* vim: expandtab sw=4 sts=4 ts=8
+ **********************************************************
+ * ws2c.c
+ *
+ * Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Publice License,
+ * version 2 or any later. The license is contained in the COPYING
+ * file that comes with the wsdebug distribution.
+ *
+ * whitespace to C translator
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "fileio.h"
+#include "interprt.h"
+#include "decode.h"
+#include "verify.h"
+#include "optimize.h"
+#include "numeric.h"
+
+/* the C compiler to use, unless $CC tells otherwise */
+#define WS2C_CC "cc"
+
+/* the number type of the generated program, if it doesn't need GNU MP.
+ * Native numbers wrap around on overflow (just like wsi's int build),
+ * hence -fwrapv.
+ */
+#ifdef HAVE_LIBGMP
+#  define WS2C_NATIVE_DEFS \
+    "#define WSVAR_TYPE long\n" \
+    "#define WSVAR_FMT \"%ld\"\n" \
+    "#define WSVAR_GET_UI(v) ((unsigned long) ((v) < 0 ? -(v) : (v)))\n"
+#  define WS2C_LIT_SUFFIX "L"
+#  define WS2C_LIT_MIN LONG_MIN
+#else
+#  define WS2C_NATIVE_DEFS \
+    "#define WSVAR_TYPE signed int\n" \
+    "#define WSVAR_FMT \"%d\"\n" \
+    "#define WSVAR_GET_UI(v) ((unsigned int) (v))\n"
+#  define WS2C_LIT_SUFFIX ""
+#  define WS2C_LIT_MIN INT_MIN
+#endif
+
+#define WS2C_NATIVE_CFLAGS "-fwrapv"
+#define WS2C_GMP_LIBS "-lgmp"
+
+/* numbers of the generated program */
+#define WS2C_NATIVE 0
+#define WS2C_HYBRID 1   /* hybrid.c's, i.e. wsi's */
+#define WS2C_GMP    2
+
+/* the WSVAR_ macros of the generated program, see interprt.h */
+static const char *const ws2c_native[] = {
+    "#define WSVAR_INIT(v) ((v) = 0)",
+    "#define WSVAR_GET_SI(v) ((long) (v))",
+    "#define WSVAR_PRINTF(v) printf(WSVAR_FMT, (v))",
+    "#define WSVAR_SET_SI(dest,v) ((dest) = (v))",
+    "#define WSVAR_INPUT(dest) (void) scanf(WSVAR_FMT, &(dest))",
+    "#define WSVAR_CMP_ZERO(v) (((v) > 0) - ((v) < 0))",
+    "#define WSVAR_ASSIGN(dest,src) ((dest) = (src))",
+    "#define WSVAR_MOVE(dest,src) ((dest) = (src))",
+    "#define WSVAR_SWAP(a,b) \\",
+    "    do { WSVAR_TYPE swap_tmp = (a); (a) = (b); (b) = swap_tmp; } while(0)",
+    "#define WSVAR_ADD(dest,s1,s2) ((dest) = (s1) + (s2))",
+    "#define WSVAR_SUB(dest,s1,s2) ((dest) = (s1) - (s2))",
+    "#define WSVAR_MUL(dest,s1,s2) ((dest) = (s1) * (s2))",
+    "#define WSVAR_DIV(dest,s1,s2) ((dest) = (s1) / (s2))",
+    "#define WSVAR_MOD(dest,s1,s2) ((dest) = (s1) % (s2))",
+    "#define WSVAR_MUL_2EXP(dest,src,k) ((dest) = (src) * ((WSVAR_TYPE) 1 << (k)))",
+    "#define WSVAR_DIV_2EXP(dest,src,k) ((dest) = (src) / ((WSVAR_TYPE) 1 << (k)))",
+    "#define WSVAR_MOD_2EXP(dest,src,k) ((dest) = (src) % ((WSVAR_TYPE) 1 << (k)))",
+    NULL
+};
+
+#if defined(HAVE_LIBGMP) && defined(WSVAR_HYBRID)
+/* hybrid.h and hybrid.c, see Makefile.am */
+static const char ws2c_hybrid_source[] =
+#include "ws2c_hybrid.h"
+    ;
+
+static const char *const ws2c_hybrid[] = {
+    "#define WSVAR_TYPE hybrid_t",
+    "#define WSVAR_INIT(v) ((v).small = 0, (v).big = NULL)",
+    "#define WSVAR_GET_UI(v) hybrid_get_ui(&(v))",
+    "#define WSVAR_GET_SI(v) hybrid_get_si(&(v))",
+    "#define WSVAR_PRINTF(v) hybrid_print(&(v))",
+    "#define WSVAR_SET_SI(dest,v) hybrid_set_si(&(dest), (v))",
+    "#define WSVAR_INPUT(dest) hybrid_input(&(dest))",
+    "#define WSVAR_CMP_ZERO(v) hybrid_sgn(&(v))",
+    "#define WSVAR_ASSIGN(dest,src) hybrid_assign(&(dest), &(src))",
+    "#define WSVAR_MOVE(dest,src) hybrid_swap(&(dest), &(src))",
+    "#define WSVAR_SWAP(a,b) hybrid_swap(&(a), &(b))",
+    "#define WSVAR_ADD(dest,s1,s2) hybrid_add(&(dest), &(s1), &(s2))",
+    "#define WSVAR_SUB(dest,s1,s2) hybrid_sub(&(dest), &(s1), &(s2))",
+    "#define WSVAR_MUL(dest,s1,s2) hybrid_mul(&(dest), &(s1), &(s2))",
+    "#define WSVAR_DIV(dest,s1,s2) hybrid_div(&(dest), &(s1), &(s2))",
+    "#define WSVAR_MOD(dest,s1,s2) hybrid_mod(&(dest), &(s1), &(s2))",
+    "#define WSVAR_MUL_2EXP(dest,src,k) hybrid_mul_2exp(&(dest), &(src), (k))",
+    "#define WSVAR_DIV_2EXP(dest,src,k) hybrid_div_2exp(&(dest), &(src), (k))",
+    "#define WSVAR_MOD_2EXP(dest,src,k) hybrid_mod_2exp(&(dest), &(src), (k))",
+    "",
+    "static hybrid_big_t *lit_big(const char *digits)",
+    "{",
+    "    hybrid_big_t *big = malloc(sizeof(*big));",
+    "    mpz_init_set_str(big->value, digits, 10);",
+    "    big->refs = 1;",
+    "    return big;",
+    "}",
+    NULL
+};
+#endif
+
+static const char *const ws2c_gmp[] = {
+    "#include <gmp.h>",
+    "#define WSVAR_TYPE mpz_t",
+    "#define WSVAR_INIT(v) mpz_init(v)",
+    "#define WSVAR_GET_UI(v) mpz_get_ui(v)",
+    "#define WSVAR_GET_SI(v) mpz_get_si(v)",
+    "#define WSVAR_PRINTF(v) gmp_printf(\"%Zd\", (v))",
+    "#define WSVAR_SET_SI(dest,v) mpz_set_si((dest), (v))",
+    "#define WSVAR_INPUT(dest) mpz_inp_str((dest), stdin, 0)",
+    "#define WSVAR_CMP_ZERO(v) mpz_sgn(v)",
+    "#define WSVAR_ASSIGN(dest,src) mpz_set((dest), (src))",
+    "#define WSVAR_MOVE(dest,src) mpz_swap((dest), (src))",
+    "#define WSVAR_SWAP(a,b) mpz_swap((a), (b))",
+    "#define WSVAR_ADD(dest,s1,s2) mpz_add((dest), (s1), (s2))",
+    "#define WSVAR_SUB(dest,s1,s2) mpz_sub((dest), (s1), (s2))",
+    "#define WSVAR_MUL(dest,s1,s2) mpz_mul((dest), (s1), (s2))",
+    "#define WSVAR_DIV(dest,s1,s2) mpz_tdiv_q((dest), (s1), (s2))",
+    "#define WSVAR_MOD(dest,s1,s2) mpz_tdiv_r((dest), (s1), (s2))",
+    "#define WSVAR_MUL_2EXP(dest,src,k) mpz_mul_2exp((dest), (src), (k))",
+    "#define WSVAR_DIV_2EXP(dest,src,k) mpz_tdiv_q_2exp((dest), (src), (k))",
+    "#define WSVAR_MOD_2EXP(dest,src,k) mpz_tdiv_r_2exp((dest), (src), (k))",
+    NULL
+};
+
+/* the runtime of the generated program: the stack, the return stack and
+ * a sparse heap (pages of cells in a hash table, like storage.c's page
+ * directory), plus a macro per instruction
+ */
+static const char *const ws2c_runtime[] = {
+    "static WSVAR_TYPE *stack = NULL;",
+    "static unsigned long sp = 0, stack_alloc = 0;",
+    "static unsigned int *rs = NULL;",
+    "static unsigned long rsp = 0, rs_alloc = 0;",
+    "",
+    "#define PAGE_BITS 10",
+    "#define PAGE_CELLS (1UL << PAGE_BITS)",
+    "static WSVAR_TYPE **pages = NULL;",
+    "static unsigned long *page_numbers = NULL, page_slots = 0, page_count = 0;",
+    "static unsigned long last_number = ~0UL;",
+    "static WSVAR_TYPE *last_page = NULL;",
+    "",
+    "static void fail(const char *msg, unsigned int at)",
+    "{",
+    "    fflush(stdout);",
+    "    fprintf(stderr, \"%s\\n(at 0x%04x)\\n\", msg, at);",
+    "    exit(1);",
+    "}",
+    "",
+    "static void *xrealloc(void *p, size_t size)",
+    "{",
+    "    if(! (p = realloc(p, size))) {",
+    "        fprintf(stderr, \"out of memory.\\n\");",
+    "        exit(2);",
+    "    }",
+    "    return p;",
+    "}",
+    "",
+    "static void grow(unsigned long n)",
+    "{",
+    "    unsigned long i = stack_alloc;",
+    "    while(sp + n > stack_alloc)",
+    "        stack_alloc = stack_alloc ? stack_alloc << 1 : 512;",
+    "    stack = xrealloc(stack, stack_alloc * sizeof(*stack));",
+    "    for(; i < stack_alloc; i ++) WSVAR_INIT(stack[i]);",
+    "}",
+    "",
+    "static void rpush(unsigned int k)",
+    "{",
+    "    if(rsp == rs_alloc) {",
+    "        rs_alloc = rs_alloc ? rs_alloc << 1 : 256;",
+    "        rs = xrealloc(rs, rs_alloc * sizeof(*rs));",
+    "    }",
+    "    rs[rsp ++] = k;",
+    "}",
+    "",
+    "static unsigned long page_slot(unsigned long number)",
+    "{",
+    "    unsigned long slot = number * 2654435761UL;",
+    "    for(;; slot ++) {",
+    "        slot &= page_slots - 1;",
+    "        if(! pages[slot] || page_numbers[slot] == number) return slot;",
+    "    }",
+    "}",
+    "",
+    "static WSVAR_TYPE *page_fault(unsigned long number)",
+    "{",
+    "    unsigned long slot, i;",
+    "    if(! page_slots || ! pages[slot = page_slot(number)]) {",
+    "        if(2 * (page_count + 1) > page_slots) {",
+    "            WSVAR_TYPE **old = pages;",
+    "            unsigned long *old_numbers = page_numbers, old_slots = page_slots;",
+    "            page_slots = page_slots ? page_slots << 1 : 16;",
+    "            pages = xrealloc(NULL, page_slots * sizeof(*pages));",
+    "            page_numbers = xrealloc(NULL, page_slots * sizeof(*page_numbers));",
+    "            memset(pages, 0, page_slots * sizeof(*pages));",
+    "            for(i = 0; i < old_slots; i ++)",
+    "                if(old[i]) {",
+    "                    slot = page_slot(old_numbers[i]);",
+    "                    pages[slot] = old[i];",
+    "                    page_numbers[slot] = old_numbers[i];",
+    "                }",
+    "            free(old);",
+    "            free(old_numbers);",
+    "        }",
+    "        slot = page_slot(number);",
+    "        pages[slot] = xrealloc(NULL, PAGE_CELLS * sizeof(**pages));",
+    "        for(i = 0; i < PAGE_CELLS; i ++) WSVAR_INIT(pages[slot][i]);",
+    "        page_numbers[slot] = number;",
+    "        page_count ++;",
+    "    }",
+    "    last_number = number;",
+    "    return last_page = pages[slot];",
+    "}",
+    "",
+    "static WSVAR_TYPE *cell(long address)",
+    "{",
+    "    unsigned long number = (unsigned long) address >> PAGE_BITS;",
+    "    WSVAR_TYPE *page = number == last_number ? last_page : page_fault(number);",
+    "    return &page[(unsigned long) address & (PAGE_CELLS - 1)];",
+    "}",
+    "",
+    "static void input(long address, int read_number)",
+    "{",
+    "    WSVAR_TYPE *dest = cell(address);",
+    "    fflush(stdout);",
+    "    if(read_number)",
+    "        WSVAR_INPUT(*dest);",
+    "    else",
+    "        WSVAR_SET_SI(*dest, getchar());",
+    "}",
+    "",
+    "#define UNDERFLOW \"Stack Underflown, unable to continue.\"",
+    "#define TOP(n) stack[sp - 1 - (n)]",
+    "#define NEED(n,at) if(sp < (n)) fail(UNDERFLOW, (at))",
+    "#define RESERVE(n) if(sp + (n) > stack_alloc) grow(n)",
+    "#define PUSH(k) { WSVAR_ASSIGN(stack[sp], lit[k]); sp ++; }",
+    "#define COPY(n) { WSVAR_ASSIGN(stack[sp], TOP(n)); sp ++; }",
+    "#define SLIDE(n) { WSVAR_SWAP(TOP(0), TOP(n)); sp -= (n); }",
+    "#define ARITH(op) { op(TOP(1), TOP(1), TOP(0)); sp --; }",
+    "#define ARITH_2EXP(op,k) op(TOP(0), TOP(0), (k))",
+    "#define STORE() { long a = WSVAR_GET_SI(TOP(1)); WSVAR_MOVE(*cell(a), TOP(0)); sp -= 2; }",
+    "#define RETRIEVE() { long a = WSVAR_GET_SI(TOP(0)); WSVAR_ASSIGN(TOP(0), *cell(a)); }",
+    "#define JZ(t) { sp --; if(! WSVAR_CMP_ZERO(stack[sp])) goto t; }",
+    "#define JN(t) { sp --; if(WSVAR_CMP_ZERO(stack[sp]) < 0) goto t; }",
+    "#define CALL(k,t) { rpush(k); goto t; }",
+    "#define RET(at) { if(! rsp) fail(UNDERFLOW, (at)); goto *ret_table[rs[-- rsp]]; }",
+    "#define PRINTC() { sp --; printf(\"%c\", (int) WSVAR_GET_UI(stack[sp]) & 0xff); }",
+    "#define PRINTN() { sp --; WSVAR_PRINTF(stack[sp]); }",
+    "#define READ(n) { sp --; input(WSVAR_GET_SI(stack[sp]), (n)); }",
+    NULL
+};
+
+static int ws2c_write(FILE *out, const char *source, int numbers);
+static void ws2c_insn(FILE *out, unsigned int pos,
+                      const unsigned int *labels, int checked);
+static void ws2c_literal(FILE *out, unsigned int k);
+static void ws2c_constant(FILE *out, long value, long min, const char *suffix);
+static void ws2c_lines(FILE *out, const char *const *lines);
+static void usage(const char *argv0);
+
+
+
+int main(int argc, char **argv)
+{
+    const char *fname = NULL, *output = NULL, *cc;
+    char *cfile, *command;
+    int i, numbers = WS2C_NATIVE, do_optimize = 0, c_only = 0;
+    FILE *out;
+    size_t len;
+
+    for(i = 1; i < argc; i ++) {
+        if(! strcmp(argv[i], "-O"))
+            do_optimize = 1;
+        else if(! strcmp(argv[i], "-C"))
+            c_only = 1;
+        else if(! strcmp(argv[i], "-o") && i + 1 < argc)
+            output = argv[++ i];
+        else if(argv[i][0] == '-' || fname) {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+            fname = argv[i];
+    }
+
+    if(! fname) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if(load_file(fname)) {
+        fprintf(stderr, "%s: unable to load file.\n", fname);
+        return 2;
+    }
+
+    /* report broken labels up front, the program fails once it gets
+     * there (just like wsi's)
+     */
+    decode_program(stderr);
+
+    /* the numbers are chosen below, such that they never wrap around */
+    if(do_optimize)
+        optimize_program(0);
+
+    verify_program();
+
+#ifdef HAVE_LIBGMP
+    /* use native numbers, if they're known to be enough */
+    switch(numeric_choose()) {
+        case NUMERIC_INT32:
+        case NUMERIC_INT64:
+            break;
+
+        default:
+#ifdef WSVAR_HYBRID
+            numbers = WS2C_HYBRID;
+#else
+            numbers = WS2C_GMP;
+#endif
+    }
+#endif
+
+    /* the executable is named like the program, without .ws */
+    len = strlen(fname);
+    if(! output) {
+        char *name = strdup(fname);
+        assert(name);
+
+        if(len > 3 && ! strcmp(name + len - 3, ".ws"))
+            name[len - 3] = 0;
+        else
+            strcat(name = realloc(name, len + 5), ".out");
+
+        output = name;
+    }
+
+    cfile = malloc(strlen(output) + 3);
+    assert(cfile);
+    sprintf(cfile, "%s.c", output);
+
+    if(! (out = fopen(cfile, "w"))) {
+        fprintf(stderr, "%s: unable to write file.\n", cfile);
+        return 2;
+    }
+
+    if(ws2c_write(out, fname, numbers) | fclose(out)) {
+        fprintf(stderr, "%s: unable to write file.\n", cfile);
+        return 2;
+    }
+
+    if(c_only)
+        return 0;
+
+    if(! (cc = getenv("CC")))
+        cc = WS2C_CC;
+
+    command = malloc(strlen(cc) + 2 * strlen(output) + 64);
+    assert(command);
+    sprintf(command, "%s -O2 %s -o '%s' '%s' %s", cc,
+            numbers == WS2C_NATIVE ? WS2C_NATIVE_CFLAGS : "", output, cfile,
+            numbers == WS2C_NATIVE ? "" : WS2C_GMP_LIBS);
+
+    if(system(command)) {
+        fprintf(stderr, "%s: unable to compile.\n", cfile);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+/* int ws2c_write(FILE *out, const char *source, int numbers)
+ *
+ * write the decoded program to out, as a C program calculating with
+ * numbers (one of WS2C_NATIVE, WS2C_HYBRID and WS2C_GMP)
+ *
+ * RETURN: non-zero on error
+ */
+static int ws2c_write(FILE *out, const char *source, int numbers)
+{
+    unsigned int i, k, calls = 0;
+    unsigned int *labels = malloc((insn_len + 1) * sizeof(*labels));
+    assert(labels);
+
+    fprintf(out, "/* generated by ws2c " VERSION " from %s */\n"
+                 "#include <stdio.h>\n"
+                 "#include <stdlib.h>\n"
+                 "#include <string.h>\n\n", source);
+
+    switch(numbers) {
+#if defined(HAVE_LIBGMP) && defined(WSVAR_HYBRID)
+        case WS2C_HYBRID:
+            fputs("#define WSVAR_HYBRID 1\n", out);
+            fputs(ws2c_hybrid_source, out);
+            ws2c_lines(out, ws2c_hybrid);
+            break;
+#endif
+
+        case WS2C_GMP:
+            ws2c_lines(out, ws2c_gmp);
+            break;
+
+        default:
+            fputs(WS2C_NATIVE_DEFS, out);
+            ws2c_lines(out, ws2c_native);
+            break;
+    }
+
+    fputs("\n", out);
+    ws2c_lines(out, ws2c_runtime);
+
+    /* the literals, GNU MP numbers are set up in main */
+    if(numbers == WS2C_GMP)
+        fprintf(out, "\nstatic WSVAR_TYPE lit[%u];\n", insn_lit_len + 1);
+    else {
+        fprintf(out, "\nstatic %sWSVAR_TYPE lit[%u] = {",
+                numbers == WS2C_NATIVE ? "const " : "", insn_lit_len + 1);
+
+        for(k = 0; k < insn_lit_len; k ++) {
+            fputs(k % 8 ? " " : "\n    ", out);
+
+            if(numbers == WS2C_NATIVE) {
+                ws2c_constant(out, WSVAR_GET_SI(insn_lit[k]), WS2C_LIT_MIN,
+                              WS2C_LIT_SUFFIX);
+                fputc(',', out);
+            }
+#if defined(HAVE_LIBGMP) && defined(WSVAR_HYBRID)
+            else if(insn_lit[k].big)
+                fputs("{ 0, NULL },", out);
+            else {
+                fputs("{ ", out);
+                ws2c_constant(out, insn_lit[k].small, LONG_MIN, "L");
+                fputs(", NULL },", out);
+            }
+#endif
+        }
+
+        fputs("\n};\n", out);
+    }
+
+    /* which instructions are jumped (or returned) to. Bit 0 of labels
+     * tells, whether an instruction needs a label, the others hold its
+     * index into the return table plus one (if it's behind a call).
+     */
+    for(i = 0; i <= insn_len; i ++)
+        labels[i] = 0;
+
+    for(i = 0; i < insn_len; i ++) {
+        const insn_t *in = &insn[i];
+
+        if(insn_has_target(in->op))
+            labels[in->arg] |= 1;
+
+        if(in->next != i + 1 && in->next < insn_len)
+            labels[in->next] |= 1;
+
+        /* the checked copies of the blocks continue with the next block */
+        if(in->block != BLOCK_CHECKED && in->next < insn_len
+           && insn[in->next].block != BLOCK_BODY)
+            labels[in->next] |= 1;
+    }
+
+    fputs("\nint main(void)\n{\n    static void *const ret_table[] = {", out);
+    for(i = 0; i < insn_len; i ++)
+        if(insn[i].op == OP_CALL && insn[i].next < insn_len) {
+            fprintf(out, "%s&&L%u,", calls % 8 ? " " : "\n        ",
+                    insn[i].next);
+            labels[insn[i].next] = 1 | ++ calls << 1;
+        }
+    fputs(calls ? "\n    };\n\n" : " NULL };\n\n", out);
+    fputs("    (void) ret_table;\n", out);
+
+    for(k = 0; k < insn_lit_len; k ++) {
+        if(numbers == WS2C_GMP)
+            fprintf(out, "    mpz_init_set_str(lit[%u], \"", k);
+#if defined(HAVE_LIBGMP) && defined(WSVAR_HYBRID)
+        else if(numbers == WS2C_HYBRID && insn_lit[k].big)
+            fprintf(out, "    lit[%u].big = lit_big(\"", k);
+#endif
+        else
+            continue;
+
+        ws2c_literal(out, k);
+        fputs(numbers == WS2C_GMP ? "\", 10);\n" : "\");\n", out);
+    }
+
+    for(i = 0; i < insn_len; i ++) {
+        if(labels[i]) fprintf(out, "L%u:\n", i);
+        ws2c_insn(out, i, labels, 0);
+    }
+
+    /* the verified blocks once more, with all the checks. They're run if
+     * the block's check fails, so errors (and what happens before) are
+     * just like in wsi.
+     */
+    for(i = 0; i < insn_len; i ++)
+        if(insn[i].block != BLOCK_CHECKED) {
+            fprintf(out, "C%u:\n", i);
+            ws2c_insn(out, i, labels, 1);
+        }
+
+    fputs("    return 1;\n}\n", out);
+    free(labels);
+
+    return ferror(out);
+}
+
+
+
+/* void ws2c_insn(FILE *out, unsigned int pos, const unsigned int *labels,
+ *                int checked)
+ *
+ * write the instruction at pos, labels tells the labels and the return
+ * table indices (see ws2c_write). Instructions of verified blocks are
+ * checked by their block (at the leader), unless checked is set.
+ */
+static void ws2c_insn(FILE *out, unsigned int pos,
+                      const unsigned int *labels, int checked)
+{
+    const insn_t *in = &insn[pos];
+    unsigned long need = 0, push = 0;
+
+    /* the stack checks, once per block (if verified) */
+    switch(in->op) {
+        case OP_PUSH:
+            push = 1;
+            break;
+
+        case OP_DUP:
+            need = push = 1;
+            break;
+
+        case OP_COPY:
+            need = in->arg + 1UL;
+            push = 1;
+            break;
+
+        case OP_SLIDE:
+            need = in->arg + 1UL;
+            break;
+
+        case OP_SWAP: case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_MOD: case OP_STORE:
+            need = 2;
+            break;
+
+        case OP_DISCARD: case OP_RETRIEVE: case OP_JZ: case OP_JN:
+        case OP_PRINTC: case OP_PRINTN: case OP_READC: case OP_READN:
+        case OP_SHL: case OP_DIV_POW2: case OP_MOD_POW2:
+            need = 1;
+            break;
+    }
+
+    if(checked || in->block == BLOCK_CHECKED)
+        ;
+    else if(in->block == BLOCK_LEADER) {
+        if(in->need)
+            fprintf(out, "    if(sp < %u) goto C%u;\n", in->need, pos);
+        need = 0;
+        push = in->grow;
+    }
+    else
+        need = push = 0;
+
+    if(need)
+        fprintf(out, "    NEED(%luUL, 0x%04x);\n", need, in->ws_ptr);
+    if(push)
+        fprintf(out, "    RESERVE(%lu);\n", push);
+
+    fputs("    ", out);
+
+    switch(in->op) {
+        case OP_PUSH: fprintf(out, "PUSH(%u);", in->arg); break;
+        case OP_DUP: fputs("COPY(0);", out); break;
+        case OP_COPY: fprintf(out, "COPY(%uUL);", in->arg); break;
+        case OP_SWAP: fputs("WSVAR_SWAP(TOP(0), TOP(1));", out); break;
+        case OP_DISCARD: fputs("sp --;", out); break;
+        case OP_SLIDE: fprintf(out, "SLIDE(%uUL);", in->arg); break;
+        case OP_ADD: fputs("ARITH(WSVAR_ADD);", out); break;
+        case OP_SUB: fputs("ARITH(WSVAR_SUB);", out); break;
+        case OP_MUL: fputs("ARITH(WSVAR_MUL);", out); break;
+        case OP_DIV: fputs("ARITH(WSVAR_DIV);", out); break;
+        case OP_MOD: fputs("ARITH(WSVAR_MOD);", out); break;
+        case OP_STORE: fputs("STORE();", out); break;
+        case OP_RETRIEVE: fputs("RETRIEVE();", out); break;
+        case OP_LABEL: case OP_NOP: break;
+        case OP_JUMP: fprintf(out, "goto L%u;", in->arg); break;
+        case OP_JZ: fprintf(out, "JZ(L%u);", in->arg); break;
+        case OP_JN: fprintf(out, "JN(L%u);", in->arg); break;
+        case OP_RET: fprintf(out, "RET(0x%04x);", in->ws_ptr); break;
+        case OP_EXIT: fputs("return 0;", out); break;
+        case OP_PRINTC: fputs("PRINTC();", out); break;
+        case OP_PRINTN: fputs("PRINTN();", out); break;
+        case OP_READC: fputs("READ(0);", out); break;
+        case OP_READN: fputs("READ(1);", out); break;
+
+        case OP_CALL:
+            fprintf(out, "CALL(%u, L%u);", (labels[in->next] >> 1) - 1, in->arg);
+            break;
+
+        case OP_SHL:
+            fprintf(out, "ARITH_2EXP(WSVAR_MUL_2EXP, %u);", in->arg2);
+            break;
+
+        case OP_DIV_POW2:
+            fprintf(out, "ARITH_2EXP(WSVAR_DIV_2EXP, %u);", in->arg2);
+            break;
+
+        case OP_MOD_POW2:
+            fprintf(out, "ARITH_2EXP(WSVAR_MOD_2EXP, %u);", in->arg2);
+            break;
+
+        case OP_NO_LABEL:
+            fprintf(out, "fail(\"Requested label couldn't be found, "
+                         "cannot continue.\", 0x%04x);", in->ws_ptr);
+            break;
+
+        case OP_END:
+            fprintf(out, "fail(\"Program didn't end on \\\\n\\\\n\\\\n, "
+                         "but no more bits to execute, stop.\", 0x%04x);",
+                    in->ws_ptr);
+            break;
+
+        default: /* OP_SYNTAX_ERROR, superinstructions aren't used */
+            fprintf(out, "fail(\"Syntax Error, cannot continue.\", 0x%04x);",
+                    in->ws_ptr);
+            break;
+    }
+
+    fputs("\n", out);
+
+    if(in->next >= insn_len || in->op == OP_JUMP)
+        ;
+    else if(checked)
+        fprintf(out, "    goto %c%u;\n",
+                insn[in->next].block == BLOCK_BODY ? 'C' : 'L', in->next);
+    else if(in->next != pos + 1)
+        fprintf(out, "    goto L%u;\n", in->next);
+}
+
+
+
+/* void ws2c_literal(FILE *out, unsigned int k)
+ *
+ * write insn_lit[k] in decimal
+ */
+static void ws2c_literal(FILE *out, unsigned int k)
+{
+#if defined(HAVE_LIBGMP) && defined(WSVAR_HYBRID)
+    if(insn_lit[k].big)
+        gmp_fprintf(out, "%Zd", insn_lit[k].big->value);
+    else
+        fprintf(out, "%ld", insn_lit[k].small);
+#elif defined(HAVE_LIBGMP)
+    gmp_fprintf(out, "%Zd", insn_lit[k]);
+#else
+    fprintf(out, "%d", insn_lit[k]);
+#endif
+}
+
+
+
+/* void ws2c_constant(FILE *out, long value, long min, const char *suffix)
+ *
+ * write value as a C constant, of the type suffix tells. The smallest
+ * one, min, is written as (-max - 1), since there's no such literal
+ * (it's the negated max + 1, which doesn't fit).
+ */
+static void ws2c_constant(FILE *out, long value, long min, const char *suffix)
+{
+    if(value == min)
+        fprintf(out, "(%ld%s - 1)", value + 1, suffix);
+    else
+        fprintf(out, "%ld%s", value, suffix);
+}
+
+
+
+static void ws2c_lines(FILE *out, const char *const *lines)
+{
+    for(; *lines; lines ++)
+        fprintf(out, "%s\n", *lines);
+}
+
+
+
+static void usage(const char *argv0)
+{
+    printf("WhiteSpace to C translator " VERSION "\n"
+           "Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany\n"
+           "WS2C is free software, covered by the GNU General Public License, any you are\n"
+           "welcome to change it and/or distribute copies of it under certain conditions.\n"
+           "There is absolutely no warranty for WS2C. See COPYING file for more info.\n"
+           "\n"
+           "Usage:\n"
+           "    %s [options] [whitespace-file]\n"
+           "    %s --help\n"
+           "\n"
+           "Translates the program to C and compiles it with $CC (or " WS2C_CC ").\n"
+           "\n"
+           "Options:\n"
+           "    -C              Write the C source only, don't compile it.\n"
+           "    -O              Optimize the program before translating it.\n"
+           "    -o FILE         Name of the executable (the C source is FILE.c),\n"
+           "                    defaults to the whitespace file without .ws.\n"
+           "    --help          Print this message.\n"
+           "\n", argv0, argv0);
+}
+
+
+
+/***** -*- emacs is great -*-
+Local Variables:
+mode: C
+c-basic-offset: 4
+indent-tabs-mode: nil
+end: 
+****************************/
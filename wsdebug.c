@@ -23,6 +23,7 @@
 
 #include "fileio.h"
 #include "interprt.h"
+#include "decode.h"
 #include "debug.h"
 
 
@@ -50,8 +51,10 @@ int main(int argc, char **argv)
 
         if(load_file(argv[1]))
             printf("%s: unable to open file\n", argv[1]);
-        else
+        else {
             printf("%s: file successfully loaded.\n", argv[1]);
+            decode_program(stdout);
+        }
     }
     
     debug_launch(); 
@@ -20,42 +20,349 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "fileio.h"
 #include "interprt.h"
+#include "engine.h"
+#include "fuse.h"
+#include "optimize.h"
+#include "numeric.h"
+#include "jit.h"
+#include "iothread.h"
+#include "heapfile.h"
 
 
 
 
+static void usage(const char *argv0);
+static int load_heap_spec(char *spec, int width);
+static int write_heap_spec(const char *range, const char *fname, int width);
+static int heap_range(const char *range, long *address, unsigned long *count);
+
+
+
 int main(int argc, char **argv) 
 {
-    if(argc != 2) {
-        printf("WhiteSpace Interpreter " VERSION "\n"
-               "Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany\n"
-               "WSI is free software, covered by the GNU General Public License, any you are\n"
-               "welcome to change it and/or distribute copies of it under certain conditions.\n"
-               "There is absolutely no warranty for WSDBG. See COPYING file for more info.\n"
-               "\n"
-               "Usage:\n"
-               "    %s [executable-file]\n"
-               "    %s --help\n"
-               "\n"
-               "Options:\n"
-               "    --help          Print this message.\n"
-               "\n", argv[0], argv[0]);
+    const char *fname = NULL, *heap_file = NULL;
+    int i, status, do_fuse = 1, do_stats = 0, do_optimize = 0, do_jit = 0;
+    int do_lazy = 0, do_iothreads = 0, heap_width = 1, heap_init = 0;
+    int do_tails = 1;
+    unsigned long dump_count;
+    long dump_address;
+    numeric_backend backend = NUMERIC_LAST;
+    interprt_do_stat stat;
+
+    /* fills, copies, prints and sums over the heap are run in bulk */
+    engine_idioms = 1;
+
+    for(i = 1; i < argc; i ++) {
+        if(! strcmp(argv[i], "--stats"))
+            do_stats = 1;
+        else if(! strcmp(argv[i], "--no-fuse"))
+            do_fuse = 0;
+        else if(! strcmp(argv[i], "--no-idioms"))
+            engine_idioms = 0;
+        else if(! strcmp(argv[i], "--no-tail-calls"))
+            do_tails = 0;
+        else if(! strcmp(argv[i], "--memoize"))
+            engine_memoize = 1;
+        else if(! strcmp(argv[i], "-O"))
+            do_optimize = 1;
+        else if(! strcmp(argv[i], "--regvm"))
+            engine_registers = 1;
+        else if(! strcmp(argv[i], "--jit"))
+            do_jit = 1;
+        else if(! strcmp(argv[i], "--lazy"))
+            do_lazy = 1;
+        else if(! strcmp(argv[i], "--io-threads"))
+            do_iothreads = 1;
+        else if(! strcmp(argv[i], "--heap-init") && i + 1 < argc) {
+            heap_init = 1;
+            i ++; /* loaded below, once the heap's set up */
+        }
+        else if(! strcmp(argv[i], "--heap-dump") && i + 2 < argc) {
+            /* written at exit, but a broken range is told right away */
+            if(heap_range(argv[i + 1], &dump_address, &dump_count))
+                return 2;
+            i += 2;
+        }
+        else if(! strcmp(argv[i], "--heap-file") && i + 1 < argc) {
+#ifndef HEAPFILE_AVAILABLE
+            fprintf(stderr, "--heap-file: not available with GNU MP "
+                    "numbers.\n");
+            return 2;
+#endif
+            heap_file = argv[++ i];
+        }
+        else if(! strncmp(argv[i], "--heap-cell=", 12)) {
+            heap_width = atoi(argv[i] + 12);
+            if(heap_width != 1 && heap_width != 2 && heap_width != 4
+               && heap_width != 8) {
+                fprintf(stderr, "%s: bytes per heap cell must be 1, 2, 4 "
+                        "or 8.\n", argv[i] + 12);
+                return 2;
+            }
+        }
+        else if(! strncmp(argv[i], "--num=", 6)) {
+            if((backend = numeric_lookup(argv[i] + 6)) == NUMERIC_LAST) {
+                fprintf(stderr, "%s: unknown numeric backend.\n", argv[i] + 6);
+                return 2;
+            }
+        }
+        else if(argv[i][0] == '-' || fname) {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+            fname = argv[i];
+    }
+
+    if(! fname) {
+        usage(argv[0]);
         return 2;
     }
 
-    if(load_file(argv[1])) {
-        fprintf(stderr, "%s: unable to load file.\n", argv[1]); 
+    if(do_lazy ? load_file_lazy(fname) : load_file(fname)) {
+        fprintf(stderr, "%s: unable to load file.\n", fname); 
         return 2;
     }
 
+    /* decode the blocks as we get there, without looking at the whole
+     * program first, i.e. there's nothing to optimize, fuse, compile or
+     * count (and nothing to choose the numbers by)
+     */
+    if(do_lazy) {
+        decode_program_lazy(load_file_more);
+        do_optimize = do_fuse = do_tails = do_jit = 0;
+
+        if(backend == NUMERIC_LAST)
+            backend = NUMERIC_BUILTIN;
+    }
+    else
+        /* report broken labels up front, but try to run the program anyway */
+        decode_program(stderr);
+
+    /* the backends, the user asks for, may wrap around */
+    if(do_optimize)
+        optimize_program(backend != NUMERIC_LAST
+                         && backend != NUMERIC_BUILTIN);
+
+    /* tail calls run in constant space, fused or not */
+    if(do_tails)
+        fuse_tails();
+
+    if(do_fuse)
+        fuse_program();
+
+    /* the numbers loaded to the heap count, just like the literals */
+    if(heap_init)
+        numeric_heap_bits = 8 * heap_width;
+
+    /* the register machine and the compiler calculate with the builtin
+     * numbers only
+     */
+    if(backend == NUMERIC_LAST)
+        backend = engine_registers || do_jit ? NUMERIC_BUILTIN
+                                             : numeric_choose();
+
+    /* with room for the OP_MEMO_RET, memo_program may append */
+    if(do_stats && ! do_lazy)
+        engine_counts = calloc(insn_len + 1, sizeof(*engine_counts));
+
+    /* stdin is the program's alone, it may be read ahead */
+    interprt_buffer_input = 1;
+
     interprt_init();
-    return interprt_err_handler(stderr, interprt_cont()) != DO_EXIT;
+
+    /* the heap's pages, from the last run and the new ones, are in there */
+    if(heap_file && heapfile_open(heap_file)) {
+        fprintf(stderr, "%s: unable to map the heap to the file (or it's "
+                "used by another run).\n", heap_file);
+        return 2;
+    }
+
+    for(i = 1; i < argc; i ++)
+        if(! strcmp(argv[i], "--heap-dump"))
+            i += 2;
+        else if(! strcmp(argv[i], "--heap-init")
+                && load_heap_spec(argv[++ i], heap_width))
+            return 2;
+
+    /* if there are no threads, the input and output is done right here */
+    if(do_iothreads)
+        iothread_start();
+
+    if(do_jit && backend == NUMERIC_BUILTIN)
+        stat = jit_run();
+    else
+        stat = numeric_run(backend);
+
+    /* the output has to be out, before reporting how the program ended */
+    if(do_iothreads)
+        iothread_stop();
+
+    status = interprt_err_handler(stderr, stat) != DO_EXIT;
+
+    for(i = 1; i < argc; i ++)
+        if(! strcmp(argv[i], "--heap-dump")) {
+            if(write_heap_spec(argv[i + 1], argv[i + 2], heap_width))
+                status = 2;
+            i += 2;
+        }
+        else if(! strcmp(argv[i], "--heap-init"))
+            i ++;
+
+    heapfile_close();
+
+    if(do_stats)
+        fprintf(stderr, "numeric backend: %s\n", numeric_name(backend));
+
+    if(do_stats && do_optimize)
+        optimize_stats(stderr);
+
+    if(do_stats)
+        fuse_stats(stderr);
+
+    return status;
+}
+
+
+
+/* int load_heap_spec(char *spec, int width)
+ *
+ * load the file, FILE[@ADDR] spec tells, to the heap (at address 0, if
+ * there's no ADDR)
+ *
+ * RETURN: 0 on success, -1 after telling the user what's wrong
+ */
+static int load_heap_spec(char *spec, int width)
+{
+    char *at = strrchr(spec, '@'), *end;
+    long address = 0;
+
+    if(at) {
+        address = strtol(at + 1, &end, 0);
+        if(at[1] && ! *end)
+            *at = 0;    /* cut off the address */
+        else
+            address = 0;/* the @ belongs to the file's name */
+    }
+
+    if(load_heap(spec, address, width)) {
+        fprintf(stderr, "%s: unable to load file to the heap.\n", spec);
+        return -1;
+    }
+
+    return 0;
 }
 
 
+
+/* int write_heap_spec(const char *range, const char *fname, int width)
+ *
+ * write the heap cells, ADDR:COUNT range tells, to the file
+ *
+ * RETURN: 0 on success, -1 after telling the user what's wrong
+ */
+static int write_heap_spec(const char *range, const char *fname, int width)
+{
+    unsigned long count;
+    long address;
+
+    if(heap_range(range, &address, &count))
+        return -1;
+
+    if(write_heap(fname, address, count, width)) {
+        fprintf(stderr, "%s: unable to write the heap to file.\n", fname);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+/* int heap_range(const char *range, long *address, unsigned long *count)
+ *
+ * split the ADDR:COUNT range of --heap-dump
+ *
+ * RETURN: 0 on success, -1 after telling the user what's wrong
+ */
+static int heap_range(const char *range, long *address, unsigned long *count)
+{
+    char *end;
+
+    *address = strtol(range, &end, 0);
+    if(end == range || *end != ':' || ! end[1]
+       || (*count = strtoul(end + 1, &end, 0), *end)) {
+        fprintf(stderr, "%s: heap range must be ADDR:COUNT.\n", range);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+static void usage(const char *argv0)
+{
+    printf("WhiteSpace Interpreter " VERSION "\n"
+           "Copyright 2004, Stefan Siegl <ssiegl@gmx.de>, Germany\n"
+           "WSI is free software, covered by the GNU General Public License, any you are\n"
+           "welcome to change it and/or distribute copies of it under certain conditions.\n"
+           "There is absolutely no warranty for WSDBG. See COPYING file for more info.\n"
+           "\n"
+           "Usage:\n"
+           "    %s [options] [executable-file]\n"
+           "    %s --help\n"
+           "\n"
+           "Options:\n"
+           "    -O              Optimize the program before running it (constants\n"
+           "                    aren't folded with the wrapping --num backends).\n"
+           "    --help          Print this message.\n"
+           "    --jit           Compile the program to machine code before running it\n"
+           "                    (x86-64 with hybrid numbers only, interpreted otherwise;\n"
+           "                    --memoize and --stats take precedence).\n"
+           "    --heap-cell=N   Bytes per heap cell in the files of --heap-init and\n"
+           "                    --heap-dump: 1 (unsigned) or 2, 4, 8 (signed little\n"
+           "                    endian integers). 1, if not given.\n"
+           "    --heap-dump ADDR:COUNT FILE\n"
+           "                    Write COUNT heap cells, from ADDR on, to FILE at exit.\n"
+           "    --heap-file FILE\n"
+           "                    Keep the heap in FILE, mapped to memory, so it may be\n"
+           "                    bigger than memory and is still there for the next run\n"
+           "                    (without GNU MP only).\n"
+           "    --heap-init FILE[@ADDR]\n"
+           "                    Load FILE to the heap cells from ADDR (or 0) on, before\n"
+           "                    running the program.\n"
+           "    --io-threads    Read the input ahead and write the output behind on\n"
+           "                    threads of their own, the program doesn't have to\n"
+           "                    wait for either then (with POSIX threads only).\n"
+           "    --lazy          Decode the program piece by piece, as it's run, to start\n"
+           "                    big ones right away. It's neither optimized, fused,\n"
+           "                    compiled nor analyzed then, and missing labels are\n"
+           "                    reported when jumped to only.\n"
+           "    --memoize       Remember the results of subroutines, that depend on the\n"
+           "                    topmost stack items only, and don't call them again.\n"
+           "    --no-fuse       Don't fuse instruction sequences to superinstructions.\n"
+           "                    Tail calls still don't grow the return stack.\n"
+           "    --no-idioms     Don't run loops, that fill, copy, print or sum up heap\n"
+           "                    cells, in bulk.\n"
+           "    --no-tail-calls Run calls and jumps, that end up at a ret, as they are,\n"
+           "                    i.e. tail recursion grows the return stack.\n"
+           "    --num=NAME      Calculate with int32, int64, int128 (wrapping around on\n"
+           "                    overflow) or %s numbers. Picked by looking at the\n"
+           "                    program, if not given.\n"
+           "    --regvm         Run the program's blocks on a register machine, with\n"
+           "                    %s numbers (unless --num tells otherwise).\n"
+           "    --stats         Print superinstruction statistics at exit.\n"
+           "\n", argv0, argv0, numeric_name(NUMERIC_BUILTIN),
+           numeric_name(NUMERIC_BUILTIN));
+}
+
+
+
 
 /***** -*- emacs is great -*-
 Local Variables: